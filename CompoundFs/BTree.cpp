@@ -153,12 +153,57 @@ std::optional<ByteString> BTree::remove(ByteStringView key)
         return std::nullopt;
 
     ByteString beforeValue = leafDef.m_page->getValue(it);
-    auto leaf = m_cacheManager.makePageWritable(leafDef).m_page;
-    leaf->remove(key);
-    if (leaf->nofItems() > 0)
-        return beforeValue;
+    auto leaf = m_cacheManager.makePageWritable(leafDef);
+    leaf.m_page->remove(key);
+    if (leaf.m_page->nofItems() == 0)
+        removeEmptyLeaf(leaf, key, stack);
 
-    unlinkLeaveNode(leaf);
+    return beforeValue;
+}
+
+/// Removes all keys k with lowKey <= k < highKey. Each affected leaf is visited once and cleared in one go; only leaves
+/// that run empty are unlinked from the tree. Returns the number of removed entries.
+size_t BTree::removeRange(ByteStringView lowKey, ByteStringView highKey)
+{
+    size_t nofRemoved = 0;
+    ByteString key = lowKey;
+    while (ByteStringView(key) < highKey)
+    {
+        InnerNodeStack stack;
+        auto leafDef = findLeaf(key, stack);
+        auto first = leafDef.m_page->lowerBound(key);
+        auto last = leafDef.m_page->lowerBound(highKey);
+
+        // the range continues in the next leaf if this one is exhausted
+        std::optional<ByteString> nextKey;
+        if (last == leafDef.m_page->endTable() && leafDef.m_page->getNext() != PageIdx::INVALID)
+            nextKey = m_cacheManager.loadPage<Leaf>(leafDef.m_page->getNext()).m_page->getLowestKey();
+
+        if (first != last)
+        {
+            auto firstIndex = first - leafDef.m_page->beginTable();
+            auto lastIndex = last - leafDef.m_page->beginTable();
+            nofRemoved += lastIndex - firstIndex;
+
+            auto leaf = m_cacheManager.makePageWritable(leafDef);
+            leaf.m_page->remove(leaf.m_page->beginTable() + firstIndex, leaf.m_page->beginTable() + lastIndex);
+            if (leaf.m_page->nofItems() == 0)
+                removeEmptyLeaf(leaf, key, stack);
+        }
+
+        if (!nextKey)
+            break;
+        key = *nextKey;
+    }
+
+    return nofRemoved;
+}
+
+/// Unlinks an empty leaf and removes its entry from the parent nodes, merging or redistributing inner nodes that
+/// underflow. The key must lead to the leaf and the stack must hold the path to it.
+void BTree::removeEmptyLeaf(const PageDef<Leaf>& leafDef, ByteStringView key, InnerNodeStack& stack)
+{
+    unlinkLeaveNode(leafDef.m_page);
     m_freePages.push_back(leafDef.m_index);
     while (!stack.empty())
     {
@@ -167,7 +212,7 @@ std::optional<ByteString> BTree::remove(ByteStringView key)
         innerPage->remove(key);
 
         if (innerPage->nofItems() > 1)
-            return beforeValue;
+            return;
         else if (innerPage->nofItems() == 0)
         {
             // must be the root page
@@ -176,20 +221,18 @@ std::optional<ByteString> BTree::remove(ByteStringView key)
             auto xleaf = m_cacheManager.loadPage<Leaf>(innerPage->getLeft(innerPage->beginTable()));
             [[maybe_unused]] auto root = new (innerPage.get()) Leaf(*xleaf.m_page);
             m_freePages.push_back(xleaf.m_index);
-            return beforeValue;
+            return;
         }
         else if (stack.size() == 1)
-            return beforeValue;
+            return;
 
         auto freePage = handleUnderflow(inner, key, stack);
         if (!freePage)
-            return beforeValue;
+            return;
 
         key = freePage->getKey(freePage->beginTable());
         stack.pop();
     }
-
-    return beforeValue;
 }
 
 ConstPageDef<Leaf> BTree::findLeaf(ByteStringView key, InnerNodeStack& stack) const
@@ -276,6 +319,109 @@ BTree::Cursor BTree::find(ByteStringView key) const
     return Cursor(leafDef.m_page, it);
 }
 
+/// Remembers the nodes of the last descent together with the upper bound of the key range each node covers. Keys
+/// arriving in ascending order only climb up as far as necessary and reuse the rest of the path.
+struct BTree::DescentPath
+{
+    struct Level
+    {
+        ConstPageDef<InnerNode> m_node;
+        ByteStringView m_upperBound;
+        bool m_bounded;
+    };
+
+    const BTree* m_btree;
+    std::vector<Level> m_levels;
+    ConstPageDef<Leaf> m_leaf;
+    ByteStringView m_leafUpperBound;
+    bool m_leafBounded = false;
+
+    static bool inRange(ByteStringView key, ByteStringView upperBound, bool bounded)
+    {
+        return !bounded || key < upperBound;
+    }
+
+    ConstPageDef<Leaf> findLeaf(ByteStringView key)
+    {
+        if (m_leaf.m_page && inRange(key, m_leafUpperBound, m_leafBounded))
+            return m_leaf;
+
+        while (!m_levels.empty() && !inRange(key, m_levels.back().m_upperBound, m_levels.back().m_bounded))
+            m_levels.pop_back();
+
+        PageIndex id = m_btree->m_rootIndex;
+        ByteStringView upperBound;
+        bool bounded = false;
+        if (!m_levels.empty())
+            id = childPage(m_levels.back(), key, upperBound, bounded);
+
+        while (true)
+        {
+            auto nodeDef = m_btree->m_cacheManager.loadPage<Node>(id);
+            if (nodeDef.m_page->m_type == NodeType::Leaf)
+            {
+                m_leaf = staticPageDefCast<Leaf>(std::move(nodeDef));
+                m_leafUpperBound = upperBound;
+                m_leafBounded = bounded;
+                return m_leaf;
+            }
+            m_levels.push_back({ staticPageDefCast<InnerNode>(std::move(nodeDef)), upperBound, bounded });
+            id = childPage(m_levels.back(), key, upperBound, bounded);
+        }
+    }
+
+    /// Same decision as InnerNode::findPage() but also delivers the upper bound of the child's key range.
+    static PageIndex childPage(const Level& level, ByteStringView key, ByteStringView& upperBound, bool& bounded)
+    {
+        const auto& node = *level.m_node.m_page;
+        upperBound = level.m_upperBound;
+        bounded = level.m_bounded;
+
+        auto it = node.lowerBound(key);
+        if (it == node.endTable())
+            return node.getLeft(it);
+
+        if (node.getKey(it) == key)
+        {
+            if (it + 1 != node.endTable())
+            {
+                upperBound = node.getKey(it + 1);
+                bounded = true;
+            }
+            return node.getRight(it);
+        }
+
+        upperBound = node.getKey(it);
+        bounded = true;
+        return node.getLeft(it);
+    }
+};
+
+/// Looks up many keys in one pass. The keys are visited in sorted order so that neighbouring keys share the descent
+/// path and each leaf is loaded only once. The result holds one Cursor per key in the order of the input.
+std::vector<BTree::Cursor> BTree::findMany(const std::vector<ByteStringView>& keys) const
+{
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    auto keyLess = [&keys](size_t lhs, size_t rhs) { return keys[lhs] < keys[rhs]; };
+    if (!std::is_sorted(order.begin(), order.end(), keyLess))
+        std::sort(order.begin(), order.end(), keyLess);
+
+    std::vector<Cursor> cursors(keys.size());
+    DescentPath path { this };
+    for (auto i: order)
+    {
+        auto leafDef = path.findLeaf(keys[i]);
+        auto it = leafDef.m_page->find(keys[i]);
+        if (it != leafDef.m_page->endTable())
+            cursors[i] = Cursor(leafDef.m_page, it);
+    }
+
+    return cursors;
+}
+
 BTree::Cursor BTree::begin(ByteStringView key) const
 {
     InnerNodeStack stack;
@@ -304,6 +450,31 @@ BTree::Cursor BTree::next(Cursor cursor) const
     return Cursor(nextLeaf, nextLeaf->beginTable());
 }
 
+/// Calls the visitor for all entries with lowKey <= key < highKey in ascending order. The views point directly into
+/// the cached leaves and are only valid during the call. Returns false if the visitor stopped the scan.
+bool BTree::visitRange(ByteStringView lowKey, ByteStringView highKey, const RangeVisitor& visitor) const
+{
+    InnerNodeStack stack;
+    auto leaf = findLeaf(lowKey, stack).m_page;
+    auto it = leaf->lowerBound(lowKey);
+    while (true)
+    {
+        for (; it != leaf->endTable(); ++it)
+        {
+            auto key = leaf->getKey(it);
+            if (!(key < highKey))
+                return true;
+            if (!visitor(key, leaf->getValue(it)))
+                return false;
+        }
+
+        if (leaf->getNext() == PageIdx::INVALID)
+            return true;
+        leaf = m_cacheManager.loadPage<Leaf>(leaf->getNext()).m_page;
+        it = leaf->beginTable();
+    }
+}
+
 struct BTree::NodeVisitor
 {
     TypedCacheManager& m_cacheManager;
@@ -27,6 +27,7 @@ class BTree final
     using InnerNodeStack = SmallBufferStack<ConstPageDef<InnerNode>, 5>;
     struct KeyInserter;
     struct NodeVisitor;
+    struct DescentPath;
 
 public:
     class Cursor;
@@ -39,6 +40,7 @@ public:
     using ReplacePolicy = bool (*)(ByteStringView beforValue);
     using TreeNode = std::variant<ConstPageDef<Leaf>, ConstPageDef<InnerNode>>;
     using TreeNodeVisitor = std::function<bool (const TreeNode&)>;
+    using RangeVisitor = std::function<bool(ByteStringView key, ByteStringView value)>;
 
 public:
     BTree(const std::shared_ptr<CacheManager>& cacheManager, PageIndex rootIndex = PageIdx::INVALID);
@@ -47,10 +49,13 @@ public:
     InsertResult insert(ByteStringView key, ByteStringView value, ReplacePolicy replacePolicy);
     RenameResult rename(ByteStringView oldKey, ByteStringView newKey);
     std::optional<ByteString> remove(ByteStringView key);
+    size_t removeRange(ByteStringView lowKey, ByteStringView highKey);
 
     Cursor find(ByteStringView key) const;
+    std::vector<Cursor> findMany(const std::vector<ByteStringView>& keys) const;
     Cursor begin(ByteStringView key) const;
     Cursor next(Cursor cursor) const;
+    bool visitRange(ByteStringView lowKey, ByteStringView highKey, const RangeVisitor& visitor) const;
 
     bool visitAllNodes(const TreeNodeVisitor&);
     const std::vector<PageIndex>& getFreePages() const noexcept { return m_freePages; }
@@ -61,6 +66,7 @@ private:
     std::shared_ptr<const InnerNode> handleUnderflow(PageDef<InnerNode>& inner, ByteStringView key,
                                                      const InnerNodeStack& stack);
     void unlinkLeaveNode(const std::shared_ptr<Leaf>& leaf);
+    void removeEmptyLeaf(const PageDef<Leaf>& leafDef, ByteStringView key, InnerNodeStack& stack);
     void growTree(ByteStringView keyToInsert, bool leftRightIsLeaf, PageIndex left, PageIndex right);
 
 private:
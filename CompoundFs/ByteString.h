@@ -72,6 +72,8 @@ class ByteStringStream final
 {
 public:
     ByteStringStream() noexcept;
+    ByteStringStream(const ByteStringStream& other) noexcept;
+    ByteStringStream& operator=(const ByteStringStream& other) noexcept;
 
     operator ByteStringView() const noexcept;
 
@@ -199,6 +201,19 @@ inline ByteStringStream::ByteStringStream() noexcept
     : m_pos(m_buffer)
 {}
 
+inline ByteStringStream::ByteStringStream(const ByteStringStream& other) noexcept
+    : ByteStringStream()
+{
+    *this = other;
+}
+
+inline ByteStringStream& ByteStringStream::operator=(const ByteStringStream& other) noexcept
+{
+    ByteStringView bsv = other;
+    m_pos = std::copy(bsv.data(), bsv.end(), m_buffer);
+    return *this;
+}
+
 inline ByteStringStream::operator ByteStringView() const noexcept
 {
     return ByteStringView(m_buffer, static_cast<uint8_t>(m_pos - m_buffer));
@@ -220,7 +235,7 @@ inline void ByteStringStream::push(const T& val) noexcept
 
     auto begin = reinterpret_cast<const uint8_t*>(&val);
     auto end = begin + sizeof(T);
-    assert((m_pos + sizeof(T)) < (m_buffer + sizeof(m_buffer)));
+    assert((m_pos + sizeof(T)) <= (m_buffer + sizeof(m_buffer)));
 
     m_pos = std::copy(begin, end, m_pos);
 }
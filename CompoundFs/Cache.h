@@ -6,13 +6,22 @@
 #include "PageMetaData.h"
 #include "Lock.h"
 #include "FileInterface.h"
+#include "Statistics.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
+#include <thread>
+#include <algorithm>
+#include <vector>
 
 namespace TxFs
 {
 
+/// How a commit protects the pages it overwrites. Undo saves the original contents of the Dirty pages before they
+/// are overwritten, Redo writes their new contents to a log first. Redo needs one flush less and does not read the
+/// originals. Both apply the log and cut it off again before the commit returns.
+enum class CommitProtocol : uint8_t { Undo, Redo };
+
 class Cache final
 {
 public:
@@ -30,8 +39,20 @@ public:
     DivertedPageIds m_divertedPageIds;
     NewPageIds m_newPageIds;
     Lock m_lock;
+    uint32_t m_checksumThreads = std::max(1U, std::thread::hardware_concurrency());
+    CommitProtocol m_commitProtocol = CommitProtocol::Undo;
+    Statistics m_statistics;
+    bool m_trackWrittenPages = false;
+    std::vector<Interval> m_writtenPages;
 };
 
+/// Remembers pages written since the last takeWrittenPages() if the CacheManager tracks them.
+inline void addWrittenPages(Cache& cache, Interval pages)
+{
+    if (cache.m_trackWrittenPages && (cache.m_writtenPages.empty() || cache.m_writtenPages.back() != pages))
+        cache.m_writtenPages.push_back(pages);
+}
+
 inline PageIndex divertPage(const Cache& cache, PageIndex id)
 {
     auto it = cache.m_divertedPageIds.find(id);
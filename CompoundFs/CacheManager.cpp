@@ -6,21 +6,70 @@
 #include "LogPage.h"
 #include "CommitHandler.h"
 #include "RollbackHandler.h"
+#include "WrappedFile.h"
 
 
 #include <assert.h>
 #include <algorithm>
 #include <tuple>
 #include <iterator>
+#include <future>
 
 using namespace TxFs;
 
+/// A transaction frozen by commitAsync(). Its Dirty and New pages are copies, so the next transaction is free to
+/// change the cached ones, and a background thread writes them through m_cache. Until it is done the next
+/// transaction reads the pages the commit overwrites from here.
+struct CacheManager::PendingCommit
+{
+    PageAllocator m_pageMemoryAllocator; // outlives the pages in m_cache
+    Cache m_cache;
+    std::unordered_map<PageIndex, std::shared_ptr<uint8_t>> m_pages;  // new contents by original page index
+    Cache::DivertedPageIds m_divertedPageIds;                         // evicted Dirty pages: where the contents are
+    std::future<void> m_commit;
+};
+
+namespace
+{
+void addCommitStatistics(Statistics& statistics, const Statistics& commit)
+{
+    statistics.m_commits += commit.m_commits;
+    statistics.m_committedPages += commit.m_committedPages;
+    statistics.m_committedDirtyPages += commit.m_committedDirtyPages;
+    statistics.m_flushes += commit.m_flushes;
+    statistics.m_copyTime += commit.m_copyTime;
+    statistics.m_logTime += commit.m_logTime;
+    statistics.m_lockWaitTime += commit.m_lockWaitTime;
+    statistics.m_overwriteTime += commit.m_overwriteTime;
+    statistics.m_truncateTime += commit.m_truncateTime;
+    statistics.m_longestCommit = std::max(statistics.m_longestCommit, commit.m_longestCommit);
+}
+}
+
 CacheManager::CacheManager(std::unique_ptr<FileInterface> fi, uint32_t maxPages)
-    : m_pageMemoryAllocator(maxPages) 
+    : CacheManager(std::move(fi), CacheBudget::fixed(size_t(maxPages) * PageSize))
+{
+}
+
+CacheManager::CacheManager(std::unique_ptr<FileInterface> fi, const CacheBudget& budget)
+    : m_pageMemoryAllocator(std::min(budget.pages(), 256U), budget.m_hugePages)
     , m_cache { std::move(fi) }
-    , m_maxCachedPages(maxPages)
+    , m_maxCachedPages(budget.pages())
+    , m_budget(budget)
 {
     m_cache.m_lock = m_cache.file()->defaultAccess();
+    if (m_budget.m_pool)
+        m_budget.m_pool->join(*m_poolMember);
+}
+
+CacheManager::CacheManager(CacheManager&&) = default;
+
+CacheManager::~CacheManager()
+{
+    if (m_pendingCommit)
+        m_pendingCommit->m_commit.wait();
+    if (m_budget.m_pool)
+        m_budget.m_pool->leave(*m_poolMember);
 }
 
 
@@ -37,7 +86,7 @@ PageDef<uint8_t> CacheManager::asNewPage(PageIndex pageIndex)
 {
     // assert(m_cache.m_pageCache.find(pageIndex) == m_cache.m_pageCache.end());
     auto page = m_pageMemoryAllocator.allocate();
-    m_cache.m_pageCache.emplace(pageIndex, CachedPage(page, PageClass::New));
+    m_cache.m_pageCache.insert_or_assign(pageIndex, CachedPage(page, PageClass::New)); // may replace a prefetched page
     m_cache.m_newPageIds.insert(pageIndex);
     trimCheck();
     return PageDef<uint8_t>(page, pageIndex);
@@ -47,17 +96,22 @@ PageDef<uint8_t> CacheManager::asNewPage(PageIndex pageIndex)
 /// something writable (makePageWritable()) which in turn makes this page subject to the dirty-page protocol.
 ConstPageDef<uint8_t> CacheManager::loadPage(PageIndex origId)
 {
+    if (m_trackPageLoads)
+        m_pageLoads[origId]++;
+
     auto id = TxFs::divertPage(m_cache, origId);
     auto it = m_cache.m_pageCache.find(id);
     if (it == m_cache.m_pageCache.end())
     {
+        m_cache.m_statistics.m_cacheMisses++;
         auto page = m_pageMemoryAllocator.allocate();
-        TxFs::readSignedPage(m_cache.file(), id, page.get());
+        readPage(id, page.get());
         m_cache.m_pageCache.emplace(id, CachedPage(page, PageClass::Read));
         trimCheck();
         return ConstPageDef<uint8_t>(page, origId);
     }
 
+    m_cache.m_statistics.m_cacheHits++;
     it->second.m_usageCount++;                               
     return ConstPageDef<uint8_t>(it->second.m_page, origId);
 }
@@ -84,6 +138,24 @@ PageDef<uint8_t> CacheManager::repurpose(PageIndex origId)
     return PageDef<uint8_t>(it->second.m_page, origId);
 }
 
+/// Reads a page from the file. While a commit of commitAsync() is running, the pages it overwrites are read from the
+/// frozen transaction instead.
+void CacheManager::readPage(PageIndex id, uint8_t* page) const
+{
+    if (m_pendingCommit)
+    {
+        const auto& pending = *m_pendingCommit;
+        if (auto it = pending.m_pages.find(id); it != pending.m_pages.end())
+        {
+            std::copy(it->second.get(), it->second.get() + PageSize, page);
+            return;
+        }
+        if (auto it = pending.m_divertedPageIds.find(id); it != pending.m_divertedPageIds.end())
+            id = it->second;
+    }
+    TxFs::readSignedPage(m_cache.file(), id, page);
+}
+
 /// Marks that a page was changed: Pages previously read-in are marked dirty (which makes them follow the
 /// dirty-page protocoll). All other pages are treated as PageClass::New.
 void CacheManager::setPageDirty(PageIndex id) noexcept
@@ -96,11 +168,91 @@ void CacheManager::setPageDirty(PageIndex id) noexcept
     it->second.setPageClass(pageClass);
 }
 
-/// Finds out if a trim operation needs to be performed and does it if necessary.
+/// Finds out if a trim operation needs to be performed and does it if necessary. If more than an eighth of the
+/// evicted pages had to be diverted the cache is too small for the transactions at hand and grows within its budget.
 void CacheManager::trimCheck()
 {
+    if (m_budget.m_pool)
+        balanceCachePool();
+
+    if (m_cache.m_pageCache.size() <= m_maxCachedPages)
+        return;
+
+    const auto& statistics = m_cache.m_statistics;
+    auto diverted = statistics.m_divertedPages;
+    auto evicted = diverted + statistics.m_evictedNewPages + statistics.m_evictedReadPages;
+    trim(m_maxCachedPages / 4 * 3);
+
+    diverted = statistics.m_divertedPages - diverted;
+    evicted = statistics.m_divertedPages + statistics.m_evictedNewPages + statistics.m_evictedReadPages - evicted;
+    if (diverted * 8 > evicted)
+        m_maxCachedPages = std::min(m_budget.maxPages(), m_maxCachedPages * 2);
+}
+
+/// Reports the cached pages to the CachePool. While the pool is exceeded the other members are asked to give pages
+/// back; if that is not enough and this CacheManager holds more than its fair share it trims itself.
+void CacheManager::balanceCachePool()
+{
+    checkCachePool();
+    auto& pool = *m_budget.m_pool;
+    pool.update(*m_poolMember, m_cache.m_pageCache.size());
+    if (!pool.exceeded())
+        return;
+
+    auto trimTo = pool.rebalance(*m_poolMember);
+    if (trimTo == CachePool::NoTrim)
+        return;
+
+    trim(uint32_t(trimTo / 4 * 3));
+    m_pageMemoryAllocator.trim();
+    pool.update(*m_poolMember, m_cache.m_pageCache.size());
+}
+
+/// Serves a request of the CachePool to trim the cache, handing the freed page memory back to the system so the
+/// other members can use it. Called at safe points, i.e. when no page is in the middle of being handed out.
+void CacheManager::checkCachePool()
+{
+    if (!m_budget.m_pool)
+        return;
+
+    auto trimTo = m_poolMember->m_trimTo.exchange(CachePool::NoTrim);
+    if (trimTo == CachePool::NoTrim)
+        return;
+
+    trim(uint32_t(std::min<size_t>(trimTo, UINT32_MAX) / 4 * 3));
+    m_pageMemoryAllocator.trim();
+    m_budget.m_pool->update(*m_poolMember, m_cache.m_pageCache.size());
+}
+
+/// Changes the budget at runtime. A cache that is larger than the new budget is trimmed right away.
+void CacheManager::setCacheBudget(const CacheBudget& budget)
+{
+    if (budget.m_pool != m_budget.m_pool)
+    {
+        if (m_budget.m_pool)
+            m_budget.m_pool->leave(*m_poolMember);
+        m_poolMember = std::make_unique<CachePool::Member>();
+        if (budget.m_pool)
+            budget.m_pool->join(*m_poolMember);
+    }
+
+    m_budget = budget;
+    m_maxCachedPages = std::clamp(m_maxCachedPages, budget.pages(), budget.maxPages());
     if (m_cache.m_pageCache.size() > m_maxCachedPages)
-        trim(m_maxCachedPages / 4 * 3);
+        trim(m_maxCachedPages);
+    if (m_budget.m_pool)
+        balanceCachePool();
+}
+
+/// Reacts to memory pressure reported by the process: an adaptively grown cache shrinks back to its initial budget
+/// and the page memory no longer in use is returned to the system.
+void CacheManager::releaseMemory()
+{
+    m_maxCachedPages = m_budget.pages();
+    trim(m_maxCachedPages / 4 * 3);
+    m_pageMemoryAllocator.trim();
+    if (m_budget.m_pool)
+        m_budget.m_pool->update(*m_poolMember, m_cache.m_pageCache.size());
 }
 
 // Trims down memory usage by maxPages. If users have a lot of pinned pages this is triggered too often. Make sure that
@@ -120,20 +272,151 @@ size_t CacheManager::trim(uint32_t maxPages)
     evictDirtyPages(beginEvictSet, beginNewPageSet);
     evictNewPages(beginNewPageSet, endNewPageSet);
     removeFromCache(beginEvictSet, prioritizedPages.end());
+
+    auto& statistics = m_cache.m_statistics;
+    statistics.m_divertedPages += beginNewPageSet - beginEvictSet;
+    statistics.m_evictedNewPages += endNewPageSet - beginNewPageSet;
+    statistics.m_evictedReadPages += prioritizedPages.end() - endNewPageSet;
     return m_cache.m_pageCache.size();
 }
 
-/// Use installed allocation function or the rawFileInterface.
+/// Use installed allocation function or the rawFileInterface. While a commit of commitAsync() is running the pages
+/// come from the ones reserved for the next transaction; once they are used up the commit has to be finished first.
 Interval CacheManager::allocatePageInterval(size_t maxPages)
 {
-    if (m_pageIntervalAllocator)
+    if (m_pendingCommit && m_reservedPages.empty())
+        finishCommit();
+
+    if (m_pageIntervalAllocator && !m_pendingCommit)
     {
         auto iv = m_pageIntervalAllocator(maxPages);
         if (iv.begin() != PageIdx::INVALID)
-            return iv;
+        {
+            m_cache.m_statistics.m_pagesFromFreeStore += iv.length();
+            return handOut(iv);
+        }
         m_pageIntervalAllocator = std::function<Interval(size_t)>();
     }
-    return m_cache.m_fileInterface->newInterval(maxPages);
+    if (!m_reservedPages.empty())
+    {
+        auto length = uint32_t(std::min<size_t>(maxPages, m_reservedPages.length()));
+        Interval iv(m_reservedPages.begin(), m_reservedPages.begin() + length);
+        m_reservedPages = Interval(iv.end(), m_reservedPages.end());
+        m_cache.m_statistics.m_pagesFromFileGrowth += iv.length();
+        return handOut(iv);
+    }
+    auto iv = m_cache.m_fileInterface->newInterval(maxPages);
+    m_cache.m_statistics.m_pagesFromFileGrowth += iv.length();
+    return handOut(iv);
+}
+
+/// Pages handed out get new contents, so a copy prefetch() cached before they were freed is dropped.
+Interval CacheManager::handOut(Interval iv)
+{
+    TxFs::addWrittenPages(m_cache, iv);
+    if (m_cache.m_pageCache.empty())
+        return iv;
+
+    for (auto id = iv.begin(); id != iv.end(); id++)
+    {
+        auto it = m_cache.m_pageCache.find(id);
+        if (it != m_cache.m_pageCache.end() && it->second.m_pageClass == PageClass::Read)
+            m_cache.m_pageCache.erase(it);
+    }
+    return iv;
+}
+
+/// Returns the pages written since the last call as sorted, disjoint intervals. Only pages allocated by this
+/// CacheManager, the pages it commits and pages reported with addWrittenPages() are tracked. Pages of transactions
+/// that were rolled back stay in the set.
+std::vector<Interval> CacheManager::takeWrittenPages()
+{
+    auto pages = std::move(m_cache.m_writtenPages);
+    m_cache.m_writtenPages.clear();
+    std::sort(pages.begin(), pages.end(), [](Interval lhs, Interval rhs) { return lhs.begin() < rhs.begin(); });
+
+    std::vector<Interval> merged;
+    for (auto iv: pages)
+    {
+        if (!merged.empty() && iv.begin() <= merged.back().end())
+            merged.back() = Interval(merged.back().begin(), std::max(merged.back().end(), iv.end()));
+        else
+            merged.push_back(iv);
+    }
+    return merged;
+}
+
+/// Returns the maxPages most often loaded pages (see trackPageLoads()) together with the checksums they carry in the
+/// file right now. Pages that are not in the file yet and the excluded ones are left out.
+std::vector<std::pair<PageIndex, uint32_t>> CacheManager::hotPages(size_t maxPages,
+                                                                   std::vector<PageIndex> excluded) const
+{
+    std::sort(excluded.begin(), excluded.end());
+    std::vector<std::pair<PageIndex, uint32_t>> pages;
+    pages.reserve(m_pageLoads.size());
+    for (auto page: m_pageLoads)
+        if (!std::binary_search(excluded.begin(), excluded.end(), page.first))
+            pages.push_back(page);
+    auto end = pages.begin() + std::min(maxPages, pages.size());
+    std::partial_sort(pages.begin(), end, pages.end(), [](auto lhs, auto rhs) { return lhs.second > rhs.second; });
+    pages.erase(end, pages.end());
+
+    auto fileSize = m_cache.m_fileInterface->fileSizeInPages();
+    pages.erase(std::remove_if(pages.begin(), pages.end(), [=](auto page) { return page.first >= fileSize; }),
+                pages.end());
+    for (auto& [index, checkSum]: pages)
+    {
+        auto begin = reinterpret_cast<uint8_t*>(&checkSum);
+        m_cache.m_fileInterface->readPage(index, PageSize - sizeof(checkSum), begin, begin + sizeof(checkSum));
+    }
+    return pages;
+}
+
+/// Loads pages into the cache before they are asked for. The pages are read in sorted batches, small gaps between
+/// them are read along. A page is only cached if it still carries the expected checksum and the cache has room for
+/// it. Prefetching only happens while no transaction has changed pages. Returns the number of cached pages.
+size_t CacheManager::prefetch(std::vector<std::pair<PageIndex, uint32_t>> pages)
+{
+    constexpr PageIndex maxGap = 4;
+    constexpr PageIndex maxBatch = 256;
+    if (!m_cache.m_newPageIds.empty() || !m_cache.m_divertedPageIds.empty() || m_pendingCommit)
+        return 0;
+
+    auto fileSize = m_cache.file()->fileSizeInPages();
+    pages.erase(std::remove_if(pages.begin(), pages.end(), [=](auto page) { return page.first >= fileSize; }),
+                pages.end());
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end(), [](auto lhs, auto rhs) { return lhs.first == rhs.first; }),
+                pages.end());
+
+    std::vector<uint8_t> buffer(maxBatch * PageSize);
+    size_t cached = 0;
+    for (auto begin = pages.begin(); begin != pages.end();)
+    {
+        auto end = begin + 1;
+        while (end != pages.end() && end->first - (end - 1)->first <= maxGap && end->first - begin->first < maxBatch)
+            ++end;
+
+        m_cache.file()->readPages(Interval(begin->first, (end - 1)->first + 1), buffer.data());
+        for (auto it = begin; it != end && m_cache.m_pageCache.size() < m_maxCachedPages; ++it)
+        {
+            auto data = buffer.data() + size_t(it->first - begin->first) * PageSize;
+            auto signedPage = reinterpret_cast<const SignedPage*>(data);
+            if (signedPage->m_checkSum != it->second || !signedPage->validateCheckSum() ||
+                m_cache.m_pageCache.count(it->first))
+                continue;
+
+            auto page = m_pageMemoryAllocator.allocate();
+            std::copy(data, data + PageSize, page.get());
+            m_cache.m_pageCache.emplace(it->first, CachedPage(page, PageClass::Read));
+            cached++;
+        }
+        begin = end;
+    }
+
+    if (m_budget.m_pool)
+        balanceCachePool();
+    return cached;
 }
 
 /// Find all pages that are currently not pinned.
@@ -188,10 +471,114 @@ RollbackHandler CacheManager::getRollbackHandler()
     return RollbackHandler(m_cache);
 }
 
+/// Freezes the transaction and commits it on a background thread, so the next transaction can start right away. The
+/// cached pages stay where they are as Read pages and the commit works on copies. reservedPages pages are added to
+/// the file for the next transaction in front of the pages the commit appends, which keeps the commit's logs at the
+/// end of the file. The next transaction must not use the FreeStore before the commit is finished: the pages it
+/// hands out may still be needed to undo the commit. The caller has to prepare the commit like for commit().
+void CacheManager::commitAsync(size_t reservedPages)
+{
+    assert(!m_pendingCommit);
+    auto pending = std::make_unique<PendingCommit>();
+    auto& frozen = pending->m_cache;
+    frozen.m_fileInterface
+        = std::make_unique<WrappedFile>(std::shared_ptr<FileInterface>(m_cache.file(), [](FileInterface*) {}));
+    frozen.m_checksumThreads = m_cache.m_checksumThreads;
+    frozen.m_commitProtocol = m_cache.m_commitProtocol;
+    frozen.m_divertedPageIds = std::move(m_cache.m_divertedPageIds);
+    frozen.m_newPageIds = std::move(m_cache.m_newPageIds);
+    m_cache.m_divertedPageIds.clear();
+    m_cache.m_newPageIds.clear();
+
+    std::unordered_map<PageIndex, PageIndex> divertedFrom;
+    for (auto [origIdx, divertedIdx]: frozen.m_divertedPageIds)
+    {
+        divertedFrom.emplace(divertedIdx, origIdx);
+        pending->m_divertedPageIds.emplace(origIdx, divertedIdx);
+    }
+
+    for (auto it = m_cache.m_pageCache.begin(); it != m_cache.m_pageCache.end();)
+    {
+        auto diverted = divertedFrom.find(it->first);
+        if (it->second.m_pageClass == PageClass::Read && diverted == divertedFrom.end())
+        {
+            ++it;
+            continue;
+        }
+
+        auto page = pending->m_pageMemoryAllocator.allocate();
+        std::copy(it->second.m_page.get(), it->second.m_page.get() + PageSize, page.get());
+        frozen.m_pageCache.emplace(it->first, CachedPage(page, PageClass(it->second.m_pageClass)));
+        if (diverted == divertedFrom.end())
+        {
+            pending->m_pages.emplace(it->first, page);
+            it->second.setPageClass(PageClass::Read);
+            ++it;
+            continue;
+        }
+        pending->m_divertedPageIds.erase(diverted->second);
+        pending->m_pages.emplace(diverted->second, page);
+        it = m_cache.m_pageCache.erase(it); // the diverted page is free once the commit is done
+    }
+
+    CommitHandler commitHandler(frozen);
+    commitHandler.signCachedPages();
+    m_reservedPages = m_cache.file()->newInterval(reservedPages);
+    commitHandler.reserveAppendedPages();
+
+    frozen.m_lock = std::move(m_cache.m_lock);
+    pending->m_commit = std::async(std::launch::async, [commitHandler]() mutable { commitHandler.commit(); });
+    m_pendingCommit = std::move(pending);
+}
+
+/// Waits for the commit of commitAsync() and takes its lock and statistics back. If the commit failed, the cached
+/// pages of the transaction that followed are dropped as well, as it was built on top of it, and the exception is
+/// rethrown. The caller has to roll back then.
+void CacheManager::finishCommit()
+{
+    if (!m_pendingCommit)
+        return;
+
+    auto pending = std::move(m_pendingCommit);
+    pending->m_commit.wait();
+    m_cache.m_lock = std::move(pending->m_cache.m_lock);
+    addCommitStatistics(m_cache.m_statistics, pending->m_cache.m_statistics);
+    try
+    {
+        pending->m_commit.get();
+    }
+    catch (...)
+    {
+        m_cache.m_pageCache.clear();
+        m_cache.m_newPageIds.clear();
+        m_cache.m_divertedPageIds.clear();
+        m_reservedPages = Interval();
+        throw;
+    }
+}
+
+bool CacheManager::commitFinished() const
+{
+    return m_pendingCommit && m_pendingCommit->m_commit.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/// Cuts the pages reserved by commitAsync() the transaction did not use off the end of the file again.
+void CacheManager::releaseReservedPages()
+{
+    assert(!m_pendingCommit);
+    if (m_reservedPages.empty())
+        return;
+
+    assert(m_reservedPages.end() == m_cache.file()->fileSizeInPages()); // the file only grows once they are used up
+    m_cache.file()->truncate(m_reservedPages.begin());
+    m_reservedPages = Interval();
+}
+
 
 // TODO: Needed for testing. Unclear what we do with this?
 std::unique_ptr<FileInterface> CacheManager::handOverFile()
 {
+    finishCommit();
     m_cache.m_lock.release(); // we have to release that lock
     return std::move(m_cache.m_fileInterface);
 }
@@ -8,7 +8,9 @@
 #include "Interval.h"
 #include "PageMetaData.h"
 #include "Cache.h"
+#include "CachePool.h"
 
+#include <algorithm>
 #include <utility>
 #include <memory>
 #include <unordered_map>
@@ -21,6 +23,36 @@ namespace TxFs
 class CommitHandler;
 class RollbackHandler;
 
+///////////////////////////////////////////////////////////////////////////
+/// Memory the CacheManager may use for cached pages. The cache starts with m_bytes and doubles, up to m_maxBytes,
+/// whenever trimming it had to divert many dirty pages. Keep m_maxBytes at m_bytes for a fixed size. With a
+/// CachePool the CacheManager additionally shares the pool's budget with the other members of the pool. Multi-GB
+/// caches should use huge pages to keep TLB misses down.
+struct CacheBudget
+{
+    size_t m_bytes = 256 * PageSize;
+    size_t m_maxBytes = 256 * PageSize;
+    std::shared_ptr<CachePool> m_pool;
+    HugePages m_hugePages = HugePages::None;
+
+    static CacheBudget fixed(size_t bytes) noexcept { return { bytes, bytes }; }
+    static CacheBudget adaptive(size_t bytes, size_t maxBytes) noexcept { return { bytes, std::max(bytes, maxBytes) }; }
+    static CacheBudget shared(std::shared_ptr<CachePool> pool) noexcept
+    {
+        auto bytes = pool->maxPages() * PageSize;
+        return { bytes, bytes, std::move(pool) };
+    }
+
+    uint32_t pages() const noexcept { return toPages(m_bytes); }
+    uint32_t maxPages() const noexcept { return std::max(pages(), toPages(m_maxBytes)); }
+
+private:
+    static uint32_t toPages(size_t bytes) noexcept
+    {
+        return uint32_t(std::clamp(bytes / PageSize, size_t(1), size_t(UINT32_MAX / 2)));
+    }
+};
+
 ///////////////////////////////////////////////////////////////////////////
 /// All meta-data pages involve the CacheManager. It caches pages implementing
 /// a transparent cache-eviction-strategy to ensure an upper bound memory
@@ -32,7 +64,9 @@ class CacheManager final
 {
 public:
     CacheManager(std::unique_ptr<FileInterface> fi, uint32_t maxPages = 256);
-    CacheManager(CacheManager&&) = default;
+    CacheManager(std::unique_ptr<FileInterface> fi, const CacheBudget& budget);
+    CacheManager(CacheManager&&);
+    ~CacheManager();
 
     template <typename TCallable>
     void setPageIntervalAllocator(TCallable&&);
@@ -46,17 +80,43 @@ public:
     Interval allocatePageInterval(size_t maxPages);
     size_t trim(uint32_t maxPages);
 
+    void setCacheBudget(const CacheBudget& budget);
+    uint32_t maxCachedPages() const noexcept { return m_maxCachedPages; }
+    void releaseMemory();
+    void checkCachePool();
+
+    void setChecksumThreads(uint32_t threads) { m_cache.m_checksumThreads = std::max(1U, threads); }
+    void setCommitProtocol(CommitProtocol protocol) { m_cache.m_commitProtocol = protocol; }
+    void trackWrittenPages(bool enable) { m_cache.m_trackWrittenPages = enable; }
+    void addWrittenPages(Interval pages) { TxFs::addWrittenPages(m_cache, pages); }
+    std::vector<Interval> takeWrittenPages();
+    void trackPageLoads(bool enable) { m_trackPageLoads = enable; }
+    void clearPageLoads() { m_pageLoads.clear(); }
+    std::vector<std::pair<PageIndex, uint32_t>> hotPages(size_t maxPages, std::vector<PageIndex> excluded = {}) const;
+    size_t prefetch(std::vector<std::pair<PageIndex, uint32_t>> pages);
+    const Statistics& statistics() const noexcept { return m_cache.m_statistics; }
+    void resetStatistics() noexcept { m_cache.m_statistics = Statistics(); }
     CommitHandler getCommitHandler();
     RollbackHandler getRollbackHandler();
+    void commitAsync(size_t reservedPages);
+    void finishCommit();
+    bool commitPending() const noexcept { return bool(m_pendingCommit); }
+    bool commitFinished() const;
+    void releaseReservedPages();
     FileInterface* getFileInterface() { return m_cache.file(); }
     std::unique_ptr<FileInterface> handOverFile();
 
 private:
+    struct PendingCommit;
+
     void setPageDirty(PageIndex id) noexcept;
+    void readPage(PageIndex id, uint8_t* page) const;
     PageIndex allocatePageFromFile() { return allocatePageInterval(1).begin(); }
+    Interval handOut(Interval iv);
     std::vector<PrioritizedPage> getUnpinnedPages() const;
 
     void trimCheck();
+    void balanceCachePool();
     void evictDirtyPages(std::vector<PrioritizedPage>::iterator begin, std::vector<PrioritizedPage>::iterator end);
     void evictNewPages(std::vector<PrioritizedPage>::iterator begin, std::vector<PrioritizedPage>::iterator end);
     void removeFromCache(std::vector<PrioritizedPage>::iterator begin, std::vector<PrioritizedPage>::iterator end);
@@ -66,6 +126,12 @@ private:
     Cache m_cache;
     std::function<Interval(size_t)> m_pageIntervalAllocator;
     uint32_t m_maxCachedPages;
+    CacheBudget m_budget;
+    std::unique_ptr<CachePool::Member> m_poolMember = std::make_unique<CachePool::Member>();
+    bool m_trackPageLoads = false;
+    std::unordered_map<PageIndex, uint32_t> m_pageLoads;
+    std::unique_ptr<PendingCommit> m_pendingCommit;
+    Interval m_reservedPages; // at the end of the file for the transaction following commitAsync()
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,118 @@
+
+#pragma once
+
+#include "Node.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+namespace TxFs
+{
+
+///////////////////////////////////////////////////////////////////////////
+/// A memory budget shared by the CacheManagers of several composites, e.g. by all composites a process has open.
+/// Busy composites may cache as many pages as the pool holds while idle ones use nothing. Once the pool is exceeded
+/// the CacheManager that notices it asks the others to give pages back: members that have not cached a page for
+/// idleAfter shrink to MinPages, busy ones to their fair share. The asking member only trims itself if that is not
+/// enough. CacheManagers are used by one thread at a time so they cannot be trimmed from the outside: each one serves
+/// the request at its next safe point, the next time it caches a page or its FileSystem is called.
+
+class CachePool final
+{
+public:
+    static constexpr size_t MinPages = 16;
+    static constexpr size_t NoTrim = SIZE_MAX;
+
+    /// The share of one CacheManager.
+    struct Member
+    {
+        std::atomic<size_t> m_cachedPages = 0;
+        std::atomic<size_t> m_trimTo = NoTrim;
+        std::atomic<std::chrono::steady_clock::rep> m_lastActive = 0;
+    };
+
+    explicit CachePool(size_t bytes, std::chrono::milliseconds idleAfter = std::chrono::seconds(1)) noexcept
+        : m_maxPages(std::max(bytes / PageSize, MinPages))
+        , m_idleAfter(std::chrono::duration_cast<std::chrono::steady_clock::duration>(idleAfter).count())
+    {}
+
+    size_t maxPages() const noexcept { return m_maxPages; }
+    size_t cachedPages() const noexcept { return m_cachedPages.load(std::memory_order_relaxed); }
+    size_t members() const noexcept { return m_numberOfMembers.load(std::memory_order_relaxed); }
+    bool exceeded() const noexcept { return cachedPages() > m_maxPages; }
+
+    /// Every busy member may keep at least this many pages.
+    size_t fairShare() const noexcept { return std::max(m_maxPages / std::max(members(), size_t(1)), MinPages); }
+
+    void join(Member& member)
+    {
+        std::lock_guard lock(m_mutex);
+        member.m_lastActive = now();
+        m_members.push_back(&member);
+        m_numberOfMembers = m_members.size();
+    }
+
+    void leave(Member& member)
+    {
+        std::lock_guard lock(m_mutex);
+        m_cachedPages -= member.m_cachedPages.exchange(0);
+        m_members.erase(std::remove(m_members.begin(), m_members.end(), &member), m_members.end());
+        m_numberOfMembers = m_members.size();
+    }
+
+    /// Replaces the pages a member reported before with its current count. A member that caches more pages is busy.
+    void update(Member& member, size_t cachedPages) noexcept
+    {
+        auto reportedPages = member.m_cachedPages.exchange(cachedPages);
+        if (cachedPages >= reportedPages)
+        {
+            m_cachedPages += cachedPages - reportedPages;
+            if (cachedPages > reportedPages)
+                member.m_lastActive = now();
+        }
+        else
+            m_cachedPages -= reportedPages - cachedPages;
+    }
+
+    /// Called by a member that found the pool exceeded. Asks the other members to trim and returns the number of
+    /// pages member has to trim itself to, or NoTrim.
+    size_t rebalance(Member& member)
+    {
+        std::lock_guard lock(m_mutex);
+        if (!exceeded())
+            return NoTrim;
+
+        auto share = fairShare();
+        auto idleSince = now() - m_idleAfter;
+        size_t freed = 0;
+        for (auto other: m_members)
+        {
+            auto pages = other->m_cachedPages.load();
+            auto target = other->m_lastActive.load() < idleSince ? MinPages : share;
+            if (other == &member || pages <= target)
+                continue;
+            other->m_trimTo = target;
+            freed += pages - target;
+        }
+        return cachedPages() - m_maxPages > freed && member.m_cachedPages > share ? share : NoTrim;
+    }
+
+private:
+    static std::chrono::steady_clock::rep now() noexcept
+    {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+private:
+    const size_t m_maxPages;
+    const std::chrono::steady_clock::rep m_idleAfter;
+    std::atomic<size_t> m_cachedPages = 0;
+    std::atomic<size_t> m_numberOfMembers = 0;
+    std::mutex m_mutex;
+    std::vector<Member*> m_members;
+};
+
+}
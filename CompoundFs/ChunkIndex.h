@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Interval.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <optional>
+
+namespace TxFs
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// Content-addressed storage of file data: a deduplicating FileWriter cuts its data into chunks of DedupChunkPages
+/// pages and asks the ChunkIndex for pages that already hold the same content before writing a chunk. Shared pages
+/// are reference counted by the DirectoryStructure, which implements this interface.
+
+constexpr size_t DedupChunkPages = 16;
+constexpr size_t DedupChunkSize = DedupChunkPages * PageSize;
+
+class ChunkIndex
+{
+public:
+    virtual ~ChunkIndex() = default;
+
+    /// Returns stored pages with the content [begin, end) and adds a reference to them.
+    virtual std::optional<Interval> findChunk(uint64_t hash, const uint8_t* begin, const uint8_t* end) = 0;
+
+    /// Registers freshly written pages so that later findChunk() calls can share them.
+    virtual void addChunk(uint64_t hash, Interval pages) = 0;
+};
+
+}
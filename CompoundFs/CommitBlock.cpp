@@ -8,13 +8,15 @@ using namespace TxFs;
 std::string CommitBlock::toString() const
 {
     ByteStringStream bss;
-    uint8_t version = 0; // make it versionable
+    uint8_t version = 2; // make it versionable
     bss.push(version);
     bss.push(m_freeStoreDescriptor.m_fileSize);
     bss.push(m_freeStoreDescriptor.m_first);
     bss.push(m_freeStoreDescriptor.m_last);
     bss.push(m_compositSize);
     bss.push(m_maxFolderId);
+    bss.push(m_pageSize);
+    bss.push(uint8_t(m_longNames));
     ByteStringView bsv = bss;
     return std::string(bsv.data(), bsv.end());
 }
@@ -30,5 +32,13 @@ CommitBlock CommitBlock::fromString(std::string_view sv)
     bsv = ByteStringStream::pop(cb.m_freeStoreDescriptor.m_last, bsv);
     bsv = ByteStringStream::pop(cb.m_compositSize, bsv);
     bsv = ByteStringStream::pop(cb.m_maxFolderId, bsv);
+    cb.m_pageSize = 4096; // version 0 files were always written with 4K pages
+    if (version > 0)
+        bsv = ByteStringStream::pop(cb.m_pageSize, bsv);
+
+    uint8_t longNames = 0; // files before version 2 may have keys of the maximum size that are not long keys
+    if (version > 1)
+        bsv = ByteStringStream::pop(longNames, bsv);
+    cb.m_longNames = longNames != 0;
     return cb;
 }
@@ -9,6 +9,8 @@ namespace TxFs
         FileDescriptor m_freeStoreDescriptor;
         uint64_t m_compositSize = 0;
         uint32_t m_maxFolderId = 2;
+        uint32_t m_pageSize = PageSize;
+        bool m_longNames = true; // names longer than DirectoryKey::maxSize() are stored as long keys
         
         std::string toString() const;
         static CommitBlock fromString(std::string_view);
@@ -2,9 +2,29 @@
 #include "CommitHandler.h"
 #include "LogPage.h"
 #include "FileIo.h"
+#include <algorithm>
+#include <future>
+#include <chrono>
 
 using namespace TxFs;
 
+namespace
+{
+// Adds the time until it goes out of scope to one of the Statistics durations
+class PhaseTimer
+{
+    Statistics::Duration& m_duration;
+    std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+public:
+    explicit PhaseTimer(Statistics::Duration& duration) noexcept
+        : m_duration(duration)
+    {}
+
+    ~PhaseTimer() { m_duration += std::chrono::steady_clock::now() - m_start; }
+};
+}
+
 CommitHandler::CommitHandler(Cache& cache) noexcept
     : m_cache(cache)
 {}
@@ -22,38 +42,215 @@ std::vector<PageIndex> CommitHandler::getDivertedPageIds() const
 
 void CommitHandler::commit()
 {
+    auto& statistics = m_cache.m_statistics;
+    auto start = std::chrono::steady_clock::now();
+    auto recordCommit = [&] {
+        statistics.m_commits++;
+        statistics.m_longestCommit = std::max(statistics.m_longestCommit, std::chrono::steady_clock::now() - start);
+    };
+
     auto dirtyPageIds = getDirtyPageIds();
+    if (m_cache.m_trackWrittenPages)
+    {
+        for (auto id: dirtyPageIds)
+            addWrittenPages(m_cache, Interval(id));
+        for (auto id: m_cache.m_newPageIds)
+            addWrittenPages(m_cache, Interval(id));
+    }
     if (dirtyPageIds.empty()) 
     {
         lockedWriteCachedPages();
+        recordCommit();
+        return;
+    }
+
+    statistics.m_committedDirtyPages += dirtyPageIds.size();
+    if (m_cache.m_commitProtocol == CommitProtocol::Redo)
+    {
+        redoLoggedCommit(dirtyPageIds);
+        recordCommit();
         return;
     }
 
-    auto fileSize = m_cache.m_fileInterface->fileSizeInPages();
+    auto fileSize = fileSizeBeforeAppending();
     {
         // order the file writes: make sure the copies are visible before the Logs
-        auto origToCopyPages = copyDirtyPages(dirtyPageIds);
-        m_cache.m_fileInterface->flushFile();
+        std::vector<std::pair<PageIndex, PageIndex>> origToCopyPages;
+        {
+            PhaseTimer timer(statistics.m_copyTime);
+            origToCopyPages = copyDirtyPages(dirtyPageIds);
+            flushFile();
+        }
 
         // make sure the Logs are visible before we overwrite original contents
+        PhaseTimer timer(statistics.m_logTime);
         writeLogs(origToCopyPages);
-        m_cache.m_fileInterface->flushFile();
+        flushFile();
     }
 
+    signCachedPages();
     auto commitLock = exclusiveLockedCommit(dirtyPageIds);
-    m_cache.m_fileInterface->flushFile();
-    m_cache.m_fileInterface->truncate(fileSize);
+    {
+        PhaseTimer timer(statistics.m_overwriteTime);
+        flushFile();
+    }
+    {
+        PhaseTimer timer(statistics.m_truncateTime);
+        m_cache.m_fileInterface->truncate(fileSize);
+    }
     m_cache.m_lock = commitLock.release();
+    recordCommit();
+}
+
+/// The Redo protocol writes the New pages in place and the new contents of the Dirty pages to the end of the file
+/// and logs where they are. The log holds the checksums of all of these pages, the New ones included, so it is
+/// only complete if every one of them made it to the file. One flush makes all of it durable. Only then the originals are overwritten and the log is
+/// cut off again. After a crash in between, the RollbackHandler replays a complete log and ignores an incomplete one.
+/// The log can't outlive the commit: it is only found at the very end of the file, and the next transaction grows
+/// the file and reuses the pages the commit freed.
+void CommitHandler::redoLoggedCommit(const std::vector<PageIndex>& dirtyPageIds)
+{
+    auto& statistics = m_cache.m_statistics;
+    auto fileSize = fileSizeBeforeAppending();
+    signCachedPages();
+    {
+        std::vector<RedoEntry> redoLog;
+        {
+            PhaseTimer timer(statistics.m_copyTime);
+            writeNewPages();
+            redoLog = writeDirtyPageImages(dirtyPageIds);
+            logNewPages(redoLog);
+        }
+
+        PhaseTimer timer(statistics.m_logTime);
+        writeRedoLogs(redoLog);
+        flushFile();
+    }
+
+    auto commitLock = lockCommitAccess();
+    {
+        PhaseTimer timer(statistics.m_overwriteTime);
+        updateDirtyPages(dirtyPageIds);
+        m_cache.m_pageCache.clear();
+        m_cache.m_newPageIds.clear();
+        flushFile();
+    }
+    {
+        PhaseTimer timer(statistics.m_truncateTime);
+        m_cache.m_fileInterface->truncate(fileSize);
+    }
+    m_cache.m_lock = commitLock.release();
+}
+
+/// Writes the cached PageClass::New pages in place. They are not part of the committed state yet.
+void CommitHandler::writeNewPages()
+{
+    for (const auto& page: m_cache.m_pageCache)
+        if (page.second.m_pageClass == PageClass::New)
+            writeCachedPage(page.first, page.second.m_page.get());
+}
+
+/// Writes the new contents of the cached Dirty pages to the end of the file. Diverted Dirty pages already have their
+/// new contents at the diverted place: evicted ones since the eviction, cached ones since writeNewPages().
+std::vector<RedoEntry> CommitHandler::writeDirtyPageImages(const std::vector<PageIndex>& dirtyPageIds)
+{
+    std::vector<RedoEntry> redoLog;
+    redoLog.reserve(dirtyPageIds.size());
+    std::vector<std::pair<PageIndex, const SignedPage*>> cachedPages;
+    for (auto origIdx: dirtyPageIds)
+    {
+        auto id = TxFs::divertPage(m_cache, origIdx);
+        auto it = m_cache.m_pageCache.find(id);
+        if (id == origIdx)
+        {
+            assert(it != m_cache.m_pageCache.end());
+            cachedPages.emplace_back(origIdx, reinterpret_cast<const SignedPage*>(it->second.m_page.get()));
+            continue;
+        }
+
+        redoLog.push_back({ origIdx, id, checkSumOf(id) });
+    }
+
+    if (cachedPages.empty())
+        return redoLog;
+
+    auto interval = appendPages(cachedPages.size());
+    assert(interval.length() == cachedPages.size()); // here the file is just growing
+    auto nextPage = interval.begin();
+    for (auto [origIdx, page]: cachedPages)
+    {
+        writeCachedPage(nextPage, reinterpret_cast<const uint8_t*>(page));
+        redoLog.push_back({ origIdx, nextPage++, page->m_checkSum });
+    }
+    return redoLog;
+}
+
+/// Adds the New pages that are not the diverted place of a Dirty page to the Redo log. Their entries point to the
+/// pages themselves: there is nothing to replay, but the log is incomplete if one of them didn't make it to the file.
+void CommitHandler::logNewPages(std::vector<RedoEntry>& redoLog) const
+{
+    auto divertedPageIds = getDivertedPageIds();
+    std::sort(divertedPageIds.begin(), divertedPageIds.end());
+    for (auto id: m_cache.m_newPageIds)
+        if (!std::binary_search(divertedPageIds.begin(), divertedPageIds.end(), id))
+            redoLog.push_back({ id, id, checkSumOf(id) });
+}
+
+/// The checksum of a signed page in the cache or, if it was evicted, in the file.
+uint32_t CommitHandler::checkSumOf(PageIndex id) const
+{
+    auto it = m_cache.m_pageCache.find(id);
+    if (it != m_cache.m_pageCache.end())
+        return reinterpret_cast<const SignedPage*>(it->second.m_page.get())->m_checkSum;
+
+    uint32_t checkSum;
+    auto begin = reinterpret_cast<uint8_t*>(&checkSum);
+    m_cache.file()->readPage(id, PageSize - sizeof(checkSum), begin, begin + sizeof(checkSum));
+    return checkSum;
+}
+
+/// Writes the Redo log pages. Each of them starts with the number of log pages and the hash of the whole log.
+void CommitHandler::writeRedoLogs(const std::vector<RedoEntry>& redoLog)
+{
+    constexpr size_t entriesPerPage = LogPage::MAX_ENTRIES - 1;
+    auto logPages = std::max(size_t(1), (redoLog.size() + entriesPerPage - 1) / entriesPerPage);
+    LogPage::PageCopies header { uint32_t(logPages), redoLogHash(redoLog) };
+
+    auto begin = redoLog.begin();
+    for (size_t i = 0; i < logPages; i++)
+    {
+        auto pageIndex = appendPages(1).begin();
+        LogPage logPage(pageIndex, LogPage::Type::Redo);
+        logPage.pushBack(header);
+        auto end = begin + std::min(size_t(redoLog.end() - begin), entriesPerPage);
+        for (; begin != end; ++begin)
+            logPage.pushBack(LogPage::PageCopies { (*begin)[0], (*begin)[1] });
+        TxFs::writeSignedPage(m_cache.file(), pageIndex, &logPage);
+        m_cache.m_statistics.m_committedPages++;
+    }
 }
 
 CommitLock CommitHandler::exclusiveLockedCommit(const std::vector<PageIndex>& dirtyPageIds)
 {
-    auto commitLock = m_cache.m_fileInterface->commitAccess(std::move(m_cache.m_lock));
+    auto commitLock = lockCommitAccess();
+    PhaseTimer timer(m_cache.m_statistics.m_overwriteTime);
     updateDirtyPages(dirtyPageIds);
     writeCachedPages();
     return commitLock;
 }
 
+CommitLock CommitHandler::lockCommitAccess()
+{
+    PhaseTimer timer(m_cache.m_statistics.m_lockWaitTime);
+    return m_cache.m_fileInterface->commitAccess(std::move(m_cache.m_lock));
+}
+
+void CommitHandler::flushFile()
+{
+    m_cache.m_fileInterface->flushFile();
+    m_cache.m_statistics.m_flushes++;
+}
+
 void CommitHandler::lockedWriteCachedPages()
 {
     if (m_cache.m_newPageIds.empty())
@@ -62,7 +259,9 @@ void CommitHandler::lockedWriteCachedPages()
         return;
     }
 
-    auto commitLock = m_cache.m_fileInterface->commitAccess(std::move(m_cache.m_lock));
+    signCachedPages();
+    auto commitLock = lockCommitAccess();
+    PhaseTimer timer(m_cache.m_statistics.m_overwriteTime);
     writeCachedPages();
     m_cache.m_lock = commitLock.release();
     m_cache.m_newPageIds.clear();
@@ -92,7 +291,7 @@ std::vector<std::pair<PageIndex, PageIndex>> CommitHandler::copyDirtyPages(const
     std::vector<std::pair<PageIndex, PageIndex>> origToCopyPages;
     origToCopyPages.reserve(dirtyPageIds.size());
 
-    auto interval = m_cache.m_fileInterface->newInterval(dirtyPageIds.size());
+    auto interval = appendPages(dirtyPageIds.size());
     assert(interval.length() == dirtyPageIds.size()); // here the file is just growing
     auto nextPage = interval.begin();
 
@@ -102,10 +301,50 @@ std::vector<std::pair<PageIndex, PageIndex>> CommitHandler::copyDirtyPages(const
         origToCopyPages.emplace_back(originalPageIdx, nextPage++);
     }
     assert(nextPage == interval.end());
+    m_cache.m_statistics.m_committedPages += dirtyPageIds.size();
 
     return origToCopyPages;
 }
 
+/// Adds the checksum to every cached page that gets written by the commit, so the exclusively locked phase only
+/// does I/O. Big commits are split across m_cache.m_checksumThreads threads.
+void CommitHandler::signCachedPages()
+{
+    if (m_cachedPagesSigned)
+        return;
+
+    std::vector<const SignedPage*> pages;
+    pages.reserve(m_cache.m_pageCache.size());
+    for (const auto& page: m_cache.m_pageCache)
+        if (page.second.m_pageClass != PageClass::Read)
+            pages.push_back(reinterpret_cast<const SignedPage*>(page.second.m_page.get()));
+
+    constexpr size_t MinPagesPerThread = 64;
+    size_t threads = std::clamp(pages.size() / MinPagesPerThread, size_t(1), size_t(m_cache.m_checksumThreads));
+    size_t pagesPerThread = (pages.size() + threads - 1) / threads;
+    auto sign = [&pages](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++)
+            pages[i]->addCheckSum();
+    };
+
+    std::vector<std::future<void>> workers;
+    for (size_t begin = pagesPerThread; begin < pages.size(); begin += pagesPerThread)
+        workers.push_back(std::async(std::launch::async, sign, begin, std::min(begin + pagesPerThread, pages.size())));
+    sign(0, std::min(pagesPerThread, pages.size()));
+    for (auto& worker: workers)
+        worker.get();
+    m_cachedPagesSigned = true;
+}
+
+void CommitHandler::writeCachedPage(PageIndex idx, const uint8_t* page)
+{
+    m_cache.m_statistics.m_committedPages++;
+    if (m_cachedPagesSigned)
+        TxFs::writePresignedPage(m_cache.file(), idx, page);
+    else
+        TxFs::writeSignedPage(m_cache.file(), idx, page);
+}
+
 /// Update the original PageClass::DirtyPage pages either from the cache or from the diverted
 /// pages and erase them from the cache.
 void CommitHandler::updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds)
@@ -120,11 +359,12 @@ void CommitHandler::updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds)
             // its diverted place. (PageClass::Dirty pages are either in the cache or diverted)
             assert(id != origIdx);
             TxFs::copyPage(m_cache.file(), id, origIdx);
+            m_cache.m_statistics.m_committedPages++;
         }
         else
         {
             // we have to use the cached page or else we lose updates (if the page is not PageClass::Read)!
-            TxFs::writeSignedPage(m_cache.file(), origIdx, it->second.m_page.get());
+            writeCachedPage(origIdx, it->second.m_page.get());
             m_cache.m_pageCache.erase(it);
         }
     }
@@ -138,7 +378,7 @@ void CommitHandler::writeCachedPages()
     {
         assert(page.second.m_pageClass != PageClass::Undefined);
         if (page.second.m_pageClass != PageClass::Read)
-            TxFs::writeSignedPage(m_cache.file(), page.first, page.second.m_page.get());
+            writeCachedPage(page.first, page.second.m_page.get());
     }
     m_cache.m_pageCache.clear();
     m_cache.m_newPageIds.clear();
@@ -150,10 +390,11 @@ void CommitHandler::writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>
     auto begin = origToCopyPages.begin();
     while (begin != origToCopyPages.end())
     {
-        auto pageIndex = m_cache.file()->newInterval(1).begin();
+        auto pageIndex = appendPages(1).begin();
         LogPage logPage(pageIndex);
         begin = logPage.pushBack(begin, origToCopyPages.end());
         TxFs::writeSignedPage(m_cache.file(), pageIndex, &logPage);
+        m_cache.m_statistics.m_committedPages++;
     }
 }
 
@@ -166,3 +407,46 @@ size_t CommitHandler::getCompositeSize() const
 {
     return m_cache.m_fileInterface->fileSizeInPages();
 }
+
+/// Appends the pages the commit needs for page copies and logs to the file right away. The file may then grow
+/// behind them while the commit runs, as the commit only writes to the reserved pages and cuts them off again. The
+/// logs have to end up at the very end of the reserved pages, where the RollbackHandler looks for them, so exactly
+/// as many pages are reserved as the commit will write.
+void CommitHandler::reserveAppendedPages()
+{
+    auto dirtyPageIds = getDirtyPageIds();
+    size_t pages = 0;
+    if (!dirtyPageIds.empty() && m_cache.m_commitProtocol == CommitProtocol::Redo)
+    {
+        constexpr size_t entriesPerPage = LogPage::MAX_ENTRIES - 1;
+        pages = (dirtyPageIds.size() + entriesPerPage - 1) / entriesPerPage;
+        for (auto id: dirtyPageIds)
+            pages += TxFs::divertPage(m_cache, id) == id; // the new contents of cached Dirty pages
+    }
+    else if (!dirtyPageIds.empty())
+        pages = dirtyPageIds.size() + (dirtyPageIds.size() + LogPage::MAX_ENTRIES - 1) / LogPage::MAX_ENTRIES;
+
+    m_reservedPages = m_cache.m_fileInterface->newInterval(pages);
+    assert(m_reservedPages.length() == pages); // here the file is just growing
+    m_nextReservedPage = m_reservedPages.begin();
+}
+
+/// Hands out pages at the end of the file: the reserved ones, if reserveAppendedPages() was called, or new ones.
+Interval CommitHandler::appendPages(size_t pages)
+{
+    if (m_nextReservedPage == PageIdx::INVALID)
+        return m_cache.m_fileInterface->newInterval(pages);
+
+    assert(m_nextReservedPage + pages <= m_reservedPages.end());
+    Interval interval(m_nextReservedPage, PageIndex(m_nextReservedPage + pages));
+    m_nextReservedPage = interval.end();
+    return interval;
+}
+
+/// The size the file is cut back to once the commit is through.
+size_t CommitHandler::fileSizeBeforeAppending() const
+{
+    if (m_nextReservedPage == PageIdx::INVALID)
+        return m_cache.m_fileInterface->fileSizeInPages();
+    return m_reservedPages.begin();
+}
@@ -4,6 +4,7 @@
 
 #include "FileInterface.h"
 #include "Cache.h"
+#include "LogPage.h"
 
 #include <vector>
 #include <unordered_map>
@@ -19,20 +20,39 @@ public:
     CommitHandler(Cache& cache) noexcept;
 
     void commit();
+    void reserveAppendedPages();
     std::vector<std::pair<PageIndex, PageIndex>> copyDirtyPages(const std::vector<PageIndex>& dirtyPageIds);
     void writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>& origToCopyPages);
     void updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds);
     void writeCachedPages();
     CommitLock exclusiveLockedCommit(const std::vector<PageIndex>& dirtyPageIds);
     void lockedWriteCachedPages();
+    void signCachedPages();
+
+    void writeNewPages();
+    std::vector<RedoEntry> writeDirtyPageImages(const std::vector<PageIndex>& dirtyPageIds);
+    void logNewPages(std::vector<RedoEntry>& redoLog) const;
+    void writeRedoLogs(const std::vector<RedoEntry>& redoLog);
 
     std::vector<PageIndex> getDivertedPageIds() const;
     std::vector<PageIndex> getDirtyPageIds() const;
     bool empty() const;
     size_t getCompositeSize() const;
 
+private:
+    void writeCachedPage(PageIndex idx, const uint8_t* page);
+    uint32_t checkSumOf(PageIndex id) const;
+    CommitLock lockCommitAccess();
+    void flushFile();
+    void redoLoggedCommit(const std::vector<PageIndex>& dirtyPageIds);
+    Interval appendPages(size_t pages);
+    size_t fileSizeBeforeAppending() const;
+
 private:
     Cache& m_cache;
+    bool m_cachedPagesSigned = false;
+    Interval m_reservedPages;
+    PageIndex m_nextReservedPage = PageIdx::INVALID;
  
 };
 
@@ -1,15 +1,28 @@
 
 #include "Composite.h"
 #include "RollbackHandler.h"
+#include "FileIo.h"
+#include <string>
 
 using namespace TxFs;
 
+namespace
+{
+/// The checksum of the first page tells the page size the file was written with before anything else is read.
+void checkPageSize(const FileInterface* file)
+{
+    auto pageSize = probeSignedPageSize(file);
+    if (pageSize != 0 && pageSize != PageSize)
+        throw std::runtime_error("Composite: file uses a page size of " + std::to_string(pageSize) +
+                                 " bytes but this build uses " + std::to_string(PageSize));
+}
+}
 
 
 
-FileSystem Composite::initializeNew(std::unique_ptr<FileInterface> file)
+FileSystem Composite::initializeNew(std::unique_ptr<FileInterface> file, const CacheBudget& budget)
 {
-    auto cacheManager = std::make_shared<CacheManager>(std::move(file));
+    auto cacheManager = std::make_shared<CacheManager>(std::move(file), budget);
     auto startup = FileSystem::initialize(cacheManager);
     auto fileSystem = FileSystem(startup);
     fileSystem.commit();
@@ -17,9 +30,10 @@ FileSystem Composite::initializeNew(std::unique_ptr<FileInterface> file)
     return fileSystem;
 }
 
-FileSystem Composite::initializeExisting(std::unique_ptr<FileInterface> fileInterface)
+FileSystem Composite::initializeExisting(std::unique_ptr<FileInterface> fileInterface, const CacheBudget& budget)
 {
-    auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface));
+    checkPageSize(fileInterface.get());
+    auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface), budget);
     auto rollbackHandler = cacheManager->getRollbackHandler();
     rollbackHandler.revertPartialCommit();
 
@@ -29,9 +43,10 @@ FileSystem Composite::initializeExisting(std::unique_ptr<FileInterface> fileInte
     return fileSystem;
 }
 
-FileSystem Composite::initializeReadOnly(std::unique_ptr<FileInterface> fileInterface)
+FileSystem Composite::initializeReadOnly(std::unique_ptr<FileInterface> fileInterface, const CacheBudget& budget)
 {
-    auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface));
+    checkPageSize(fileInterface.get());
+    auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface), budget);
     auto rollbackHandler = cacheManager->getRollbackHandler();
     rollbackHandler.virtualRevertPartialCommit();
 
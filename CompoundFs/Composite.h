@@ -15,25 +15,37 @@ class Composite
 public:
     template <typename TFile, typename... TArgs>
     static FileSystem open(TArgs&&... args)
+    {
+        return open<TFile>(CacheBudget(), std::forward<TArgs>(args)...);
+    }
+
+    template <typename TFile, typename... TArgs>
+    static FileSystem open(CacheBudget budget, TArgs&&... args)
     {
         std::unique_ptr<FileInterface> file = std::make_unique<TFile>(std::forward<TArgs>(args)...);
         if (file->fileSizeInPages() == 0)
-            return initializeNew(std::move(file));
+            return initializeNew(std::move(file), budget);
 
-        return initializeExisting(std::move(file));
+        return initializeExisting(std::move(file), budget);
     }
     
     template <typename TFile, typename... TArgs>
     static FileSystem openReadOnly(TArgs&&... args)
+    {
+        return openReadOnly<TFile>(CacheBudget(), std::forward<TArgs>(args)...);
+    }
+
+    template <typename TFile, typename... TArgs>
+    static FileSystem openReadOnly(CacheBudget budget, TArgs&&... args)
     {
         std::unique_ptr<FileInterface> file = std::make_unique<ReadOnlyFile<TFile>>(std::forward<TArgs>(args)...);
-        return initializeReadOnly(std::move(file));
+        return initializeReadOnly(std::move(file), budget);
     }
 
 private:
-    static FileSystem initializeNew(std::unique_ptr<FileInterface> file);
-    static FileSystem initializeExisting(std::unique_ptr<FileInterface> file);
-    static FileSystem initializeReadOnly(std::unique_ptr<FileInterface> file);
+    static FileSystem initializeNew(std::unique_ptr<FileInterface> file, const CacheBudget& budget);
+    static FileSystem initializeExisting(std::unique_ptr<FileInterface> file, const CacheBudget& budget);
+    static FileSystem initializeReadOnly(std::unique_ptr<FileInterface> file, const CacheBudget& budget);
 };
 
 }
\ No newline at end of file
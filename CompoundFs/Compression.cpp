@@ -0,0 +1,46 @@
+
+#include "Compression.h"
+#include <lz4.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace TxFs;
+
+/// Bytes needed by compressChunk() for a chunk of the given size, header included.
+size_t TxFs::maxCompressedChunkSize(size_t size)
+{
+    return sizeof(ChunkHeader) + std::max(size, size_t(LZ4_compressBound(int(size))));
+}
+
+/// Writes the chunk [begin, end) with its header to dest and returns the end of the written data.
+uint8_t* TxFs::compressChunk(const uint8_t* begin, const uint8_t* end, uint8_t* dest)
+{
+    ChunkHeader header { 0, uint32_t(end - begin) };
+    auto payload = dest + sizeof(ChunkHeader);
+    int storedSize = LZ4_compress_default(reinterpret_cast<const char*>(begin), reinterpret_cast<char*>(payload),
+                                          int(header.m_size), LZ4_compressBound(int(header.m_size)));
+    if (storedSize <= 0 || uint32_t(storedSize) >= header.m_size)
+    {
+        std::copy(begin, end, payload);
+        storedSize = int(header.m_size);
+    }
+
+    header.m_storedSize = uint32_t(storedSize);
+    std::memcpy(dest, &header, sizeof(header));
+    return payload + header.m_storedSize;
+}
+
+void TxFs::decompressChunk(const ChunkHeader& header, const uint8_t* payload, uint8_t* dest)
+{
+    if (header.m_storedSize == header.m_size)
+    {
+        std::copy(payload, payload + header.m_size, dest);
+        return;
+    }
+
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(payload), reinterpret_cast<char*>(dest),
+                                   int(header.m_storedSize), int(header.m_size));
+    if (size != int(header.m_size))
+        throw std::runtime_error("Compression: corrupt chunk");
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace TxFs
+{
+
+enum class Compression { None, Lz4 };
+
+//////////////////////////////////////////////////////////////////////////
+/// Compressed files are stored as a sequence of chunks, each a ChunkHeader followed by its payload. A chunk
+/// holds at most CompressedChunkSize bytes of file data, so a reader only ever needs one chunk in memory.
+/// Chunks that do not shrink are stored as is (m_storedSize == m_size).
+
+struct ChunkHeader
+{
+    uint32_t m_storedSize;
+    uint32_t m_size;
+};
+
+constexpr size_t CompressedChunkSize = 64 * 1024;
+
+size_t maxCompressedChunkSize(size_t size);
+uint8_t* compressChunk(const uint8_t* begin, const uint8_t* end, uint8_t* dest);
+void decompressChunk(const ChunkHeader& header, const uint8_t* payload, uint8_t* dest);
+
+}
@@ -6,7 +6,12 @@
 #include "CommitBlock.h"
 #include "CommitHandler.h"
 #include "RollbackHandler.h"
+#include "FileReader.h"
+#include "FileWriter.h"
 #include <assert.h>
+#include <algorithm>
+#include <future>
+#include <thread>
 
 using namespace TxFs;
 
@@ -25,14 +30,223 @@ struct ValueStream
 
 constexpr Folder SystemFolder { 1 };
 constexpr std::string_view CommitBlockAttributeName { "CommitBlock" };
+
+// Page checksums of a file are kept in a file in this subfolder of the SystemFolder, named after the file's first
+// FileTable page.
+constexpr std::string_view PageChecksumFolderName { "PageChecksums" };
+
+// Pages shared between files have a reference count in this subfolder of the SystemFolder, keyed by the extent's
+// first page. Pages outside of these extents belong to exactly one file.
+constexpr std::string_view SharedExtentFolderName { "SharedExtents" };
+
+// Files referencing shared extents are listed here by their first FileTable page. Deleting them has to walk their
+// FileTables instead of handing the whole file to the FreeStore.
+constexpr std::string_view SharedFileFolderName { "SharedFiles" };
+
+// Maps the hash64() of a deduplicated chunk to its first page. The chunk's entry in ChunkPageFolderName maps the page
+// back to the hash, so both entries are removed together with the chunk's shared extent.
+constexpr std::string_view ChunkHashFolderName { "ChunkHashes" };
+constexpr std::string_view ChunkPageFolderName { "ChunkPages" };
+
+// Bounds of the pages reserved at the end of the file for the transaction that follows a commitAsync().
+constexpr uint64_t MinReservedPages = 64;
+constexpr uint64_t MaxReservedPages = 16384;
+
+// ------------------------------------------------------------------------
+
+// Strings too long for a leaf entry keep a prefix in the leaf and the remainder in an overflow file. The tag is
+// outside the range of TreeValue types so older readers see such values as Unknown.
+constexpr uint8_t OverflowTag = 0xff;
+constexpr size_t OverflowPrefixSize = 64;
+
+bool isOverflow(ByteStringView value)
+{
+    return value.size() > 0 && *value.data() == OverflowTag;
+}
+
+ByteStringView popOverflow(FileDescriptor& fileDescriptor, ByteStringView value)
+{
+    assert(isOverflow(value));
+    uint8_t tag;
+    value = ByteStringStream::pop(tag, value);
+    return ByteStringStream::pop(fileDescriptor, value);
+}
+
+std::string readOverflow(const FileDescriptor& fileDescriptor, const std::shared_ptr<CacheManager>& cacheManager)
+{
+    std::string str(size_t(fileDescriptor.m_fileSize), '\0');
+    FileReader reader(cacheManager);
+    reader.open(fileDescriptor);
+    auto begin = reinterpret_cast<uint8_t*>(str.data());
+    reader.read(begin, begin + str.size());
+    return str;
+}
+
+TreeValue readValue(ByteStringView value, const std::shared_ptr<CacheManager>& cacheManager)
+{
+    if (!isOverflow(value))
+        return TreeValue::fromStream(value);
+
+    FileDescriptor fileDescriptor;
+    auto prefix = popOverflow(fileDescriptor, value);
+    std::string str(prefix.data(), prefix.end());
+    return str.append(readOverflow(fileDescriptor, cacheManager));
+}
+
+// Names too long for a key keep a prefix in the key, followed by the FileDescriptor of an overflow file with the
+// rest. Long keys always have the maximum size, which keys of shorter names don't reach. Names sharing the prefix
+// are ordered by their overflow file, not by the rest of the name.
+constexpr size_t MaxInlineNameSize = DirectoryKey::maxSize() - 1;
+constexpr size_t LongKeyPrefixSize = DirectoryKey::sortedSize();
+
+ByteStringView longKeyPrefix(ByteStringView key)
+{
+    return ByteStringView(key.data(), uint8_t(sizeof(Folder) + LongKeyPrefixSize));
+}
+
+FileDescriptor longKeyOverflow(ByteStringView key)
+{
+    FileDescriptor fileDescriptor;
+    ByteStringStream::pop(fileDescriptor, ByteStringView(longKeyPrefix(key).end(), sizeof(FileDescriptor)));
+    return fileDescriptor;
+}
+
+// The part of the name that is not in the long key.
+std::string longNameRest(const DirectoryKey& dkey)
+{
+    ByteStringView key = dkey;
+    std::string rest(key.data() + sizeof(Folder) + LongKeyPrefixSize, key.end());
+    return rest.append(dkey.overflow());
+}
+
+std::string readLongName(ByteStringView key, const std::shared_ptr<CacheManager>& cacheManager)
+{
+    auto prefix = longKeyPrefix(key);
+    std::string name(prefix.data() + sizeof(Folder), prefix.end());
+    return name.append(readOverflow(longKeyOverflow(key), cacheManager));
+}
+
+// The pages owned by a file entry. Inline files own none.
+std::optional<FileDescriptor> storedFile(const TreeValue& treeValue)
+{
+    if (treeValue.getType() == TreeValue::Type::File)
+        return treeValue.get<FileDescriptor>();
+    if (treeValue.getType() == TreeValue::Type::CompressedFile)
+        return treeValue.get<CompressedFile>().m_descriptor;
+    return std::nullopt;
+}
+
+// The data pages of a file. Collects the FileTable pages on the way.
+IntervalSequence loadPages(const std::shared_ptr<CacheManager>& cacheManager, const FileDescriptor& fileDescriptor,
+                           std::vector<PageIndex>& fileTables)
+{
+    TypedCacheManager typedCacheManager(cacheManager);
+    IntervalSequence pages;
+    for (auto page = fileDescriptor.m_first; page != PageIdx::INVALID;)
+    {
+        auto fileTable = typedCacheManager.loadPage<FileTable>(page).m_page;
+        fileTable->insertInto(pages);
+        fileTables.push_back(page);
+        page = fileTable->getNext();
+    }
+    return pages;
+}
+
+// Reads the pages of a file on this thread and hashes them on up to hardware_concurrency() worker threads.
+bool verifyPages(const std::shared_ptr<CacheManager>& cacheManager, const FileDescriptor& fileDescriptor,
+                 const std::vector<uint32_t>& checksums)
+{
+    constexpr size_t BatchPages = 256;
+    const size_t maxPending = std::max(1U, std::thread::hardware_concurrency());
+
+    try
+    {
+        if (checksums.size() != (fileDescriptor.m_fileSize + PageSize - 1) / PageSize)
+            return false;
+
+        FileReader reader(cacheManager);
+        reader.open(fileDescriptor);
+        std::vector<std::future<bool>> pending;
+        bool valid = true;
+        for (size_t firstPage = 0; firstPage < checksums.size(); firstPage += BatchPages)
+        {
+            std::vector<uint8_t> batch(size_t(std::min(uint64_t(BatchPages * PageSize), reader.bytesLeft())));
+            reader.read(batch.data(), batch.data() + batch.size());
+            pending.push_back(std::async(std::launch::async, [batch = std::move(batch), checksum = &checksums[firstPage]] {
+                for (size_t pos = 0; pos < batch.size(); pos += PageSize)
+                    if (hash32(batch.data() + pos, std::min(PageSize, batch.size() - pos)) != checksum[pos / PageSize])
+                        return false;
+                return true;
+            }));
+
+            if (pending.size() == maxPending)
+            {
+                valid = pending.front().get() && valid;
+                pending.erase(pending.begin());
+            }
+        }
+
+        for (auto& future: pending)
+            valid = future.get() && valid;
+        return valid;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+// Big-endian names, so the extents starting in a page range form a key range
+DirectoryKey extentKey(Folder folder, PageIndex page)
+{
+    uint8_t name[sizeof(PageIndex)];
+    for (size_t i = 0; i < sizeof(name); i++)
+        name[i] = static_cast<uint8_t>(page >> (8 * (sizeof(name) - 1 - i)));
+    return DirectoryKey(folder, ByteStringView(name, sizeof(name)));
+}
+
+PageIndex extentPage(ByteStringView key)
+{
+    Folder folder;
+    auto name = ByteStringStream::pop(folder, key);
+    PageIndex page = 0;
+    for (auto it = name.data(); it != name.end(); ++it)
+        page = (page << 8) | *it;
+    return page;
+}
+
+DirectoryKey chunkKey(Folder folder, uint64_t hash)
+{
+    return DirectoryKey(folder, ByteStringView(reinterpret_cast<const uint8_t*>(&hash), sizeof(hash)));
 }
 
+// ------------------------------------------------------------------------
+
+// The smallest key greater than all keys starting with the given prefix
+ByteString prefixEnd(ByteStringView prefix)
+{
+    std::string key(reinterpret_cast<const char*>(prefix.data()), prefix.size());
+    while (!key.empty() && key.back() == '\xff')
+        key.pop_back();
+    assert(!key.empty());
+    key.back() = static_cast<char>(static_cast<uint8_t>(key.back()) + 1);
+    return key;
+}
+}
+
+struct DirectoryStructure::SharedExtent
+{
+    Interval m_pages;
+    uint32_t m_refCount;
+};
+
 DirectoryStructure::DirectoryStructure(DirectoryStructure&& ds) noexcept
     : m_cacheManager(std::move(ds.m_cacheManager))
     , m_btree(std::move(ds.m_btree))
     , m_maxFolderId(std::move(ds.m_maxFolderId))
     , m_freeStore(std::move(ds.m_freeStore))
     , m_rootIndex(std::move(ds.m_rootIndex))
+    , m_longNames(ds.m_longNames)
 {
     connectFreeStore();
 }
@@ -43,6 +257,7 @@ DirectoryStructure::DirectoryStructure(const Startup& startup)
     , m_maxFolderId(2)
     , m_freeStore(startup.m_cacheManager, FileDescriptor(startup.m_freeStoreIndex))
     , m_rootIndex(startup.m_rootIndex)
+    , m_longNames(true)
 {
     assert(static_cast<Folder>(m_maxFolderId) > SystemFolder);
     connectFreeStore();
@@ -55,6 +270,7 @@ DirectoryStructure& DirectoryStructure::operator=(DirectoryStructure&& ds) noexc
     m_maxFolderId = std::move(ds.m_maxFolderId);
     m_freeStore = std::move(ds.m_freeStore);
     m_rootIndex = ds.m_rootIndex;
+    m_longNames = ds.m_longNames;
     connectFreeStore();
     return *this;
 }
@@ -73,13 +289,93 @@ void DirectoryStructure::connectFreeStore()
         [fs = &m_freeStore](size_t maxPages) { return fs->allocate(static_cast<uint32_t>(maxPages)); });
 }
 
+/// Files written before long names were supported may have keys of the maximum size that are not long keys. They
+/// keep the old limit of DirectoryKey::maxSize() bytes.
+bool DirectoryStructure::isLongName(const DirectoryKey& dkey) const
+{
+    if (m_longNames)
+        return dkey.nameSize() > MaxInlineNameSize;
+
+    if (!dkey.overflow().empty())
+        throw std::runtime_error("DirectoryStructure: names longer than " + std::to_string(DirectoryKey::maxSize()) +
+                                 " bytes are not supported by this file");
+    return false;
+}
+
+bool DirectoryStructure::isLongKey(ByteStringView key) const noexcept
+{
+    return m_longNames && key.size() == ByteString::maxSize();
+}
+
+/// Returns the key of the entry for dkey. Long names need an entry: they are compared on the prefix in the key and
+/// on the rest in the overflow files of the keys sharing it.
+std::optional<ByteString> DirectoryStructure::findKey(const DirectoryKey& dkey) const
+{
+    if (!isLongName(dkey))
+        return ByteString(dkey);
+
+    auto prefix = longKeyPrefix(dkey);
+    auto rest = longNameRest(dkey);
+    std::vector<ByteString> candidates;
+    m_btree.visitRange(prefix, prefixEnd(prefix), [&](ByteStringView key, ByteStringView) {
+        if (isLongKey(key) && longKeyOverflow(key).m_fileSize == rest.size())
+            candidates.emplace_back(key);
+        return true;
+    });
+
+    for (const auto& key: candidates)
+        if (readOverflow(longKeyOverflow(key), m_cacheManager) == rest)
+            return key;
+    return std::nullopt;
+}
+
+/// Like findKey() but makes a new key for a long name without an entry.
+ByteString DirectoryStructure::makeKey(const DirectoryKey& dkey)
+{
+    auto key = findKey(dkey);
+    return key ? *key : writeLongKey(dkey);
+}
+
+ByteString DirectoryStructure::writeLongKey(const DirectoryKey& dkey)
+{
+    auto rest = longNameRest(dkey);
+    FileWriter writer(m_cacheManager);
+    auto begin = reinterpret_cast<const uint8_t*>(rest.data());
+    writer.write(begin, begin + rest.size());
+
+    ByteStringStream key;
+    key.push(longKeyPrefix(dkey));
+    key.push(writer.close());
+    return ByteString(key);
+}
+
+void DirectoryStructure::deleteLongKey(ByteStringView key)
+{
+    if (isLongKey(key))
+        m_freeStore.deleteFile(longKeyOverflow(key));
+}
+
+BTree::Cursor DirectoryStructure::findEntry(const DirectoryKey& dkey) const
+{
+    auto key = findKey(dkey);
+    return key ? m_btree.find(*key) : BTree::Cursor();
+}
+
+DirectoryStructure::Cursor DirectoryStructure::makeCursor(const BTree::Cursor& cursor) const
+{
+    std::shared_ptr<const std::string> longName;
+    if (cursor && isLongKey(cursor.key()))
+        longName = std::make_shared<const std::string>(readLongName(cursor.key(), m_cacheManager));
+    return Cursor(cursor, m_cacheManager, std::move(longName));
+}
+
 std::optional<Folder> DirectoryStructure::makeSubFolder(const DirectoryKey& dkey)
 {
     if (dkey == DirectoryKey(""))
         return Folder::Root;
 
     ValueStream value(Folder { m_maxFolderId });
-    auto res = m_btree.insert(dkey, value, [](ByteStringView) { return false; });
+    auto res = m_btree.insert(makeKey(dkey), value, [](ByteStringView) { return false; });
 
     auto inserted = std::get_if<BTree::Inserted>(&res);
     if (inserted)
@@ -98,7 +394,7 @@ std::optional<Folder> DirectoryStructure::subFolder(const DirectoryKey& dkey) co
     if (dkey == DirectoryKey(""))
         return Folder::Root;
 
-    auto cursor = m_btree.find(dkey);
+    auto cursor = findEntry(dkey);
     if (!cursor)
         return std::nullopt;
 
@@ -111,51 +407,140 @@ std::optional<Folder> DirectoryStructure::subFolder(const DirectoryKey& dkey) co
 
 bool DirectoryStructure::addAttribute(const DirectoryKey& dkey, const TreeValue& attribute)
 {
-    ValueStream value(attribute);
-    auto res = m_btree.insert(dkey, value, [](ByteStringView bsv) {
-        auto type = TreeValue::fromStream(bsv).getType();
-        return type != TreeValue::Type::Folder && type != TreeValue::Type::File;
+    auto overflow = writeOverflow(attribute);
+    ByteStringStream value;
+    if (overflow)
+    {
+        value.push(OverflowTag);
+        value.push(*overflow);
+        value.push(ByteStringView(attribute.get<std::string>().substr(0, OverflowPrefixSize)));
+    }
+    else
+        attribute.toStream(value);
+
+    auto res = m_btree.insert(makeKey(dkey), value, [](ByteStringView bsv) {
+        auto treeValue = TreeValue::fromStream(bsv);
+        return treeValue.getType() != TreeValue::Type::Folder && !treeValue.isFile();
     });
-    return !std::holds_alternative<BTree::Unchanged>(res);
+
+    if (auto replaced = std::get_if<BTree::Replaced>(&res))
+        deleteOverflow(replaced->m_beforeValue);
+
+    if (!std::holds_alternative<BTree::Unchanged>(res))
+        return true;
+
+    if (overflow)
+        m_freeStore.deleteFile(*overflow);
+    return false;
+}
+
+std::optional<FileDescriptor> DirectoryStructure::writeOverflow(const TreeValue& attribute)
+{
+    if (attribute.getType() != TreeValue::Type::String)
+        return std::nullopt;
+
+    const auto& str = attribute.get<std::string>();
+    if (str.size() <= TreeValue::maxVariableSize())
+        return std::nullopt;
+
+    FileWriter writer(m_cacheManager);
+    auto begin = reinterpret_cast<const uint8_t*>(str.data());
+    writer.write(begin + OverflowPrefixSize, begin + str.size());
+    return writer.close();
+}
+
+void DirectoryStructure::deleteOverflow(ByteStringView value)
+{
+    if (!isOverflow(value))
+        return;
+
+    FileDescriptor fileDescriptor;
+    popOverflow(fileDescriptor, value);
+    m_freeStore.deleteFile(fileDescriptor);
 }
 
 std::optional<TreeValue> DirectoryStructure::getAttribute(const DirectoryKey& dkey) const
 {
-    auto cursor = m_btree.find(dkey);
+    auto cursor = findEntry(dkey);
     if (!cursor)
         return std::nullopt;
 
-    auto attribute = TreeValue::fromStream(cursor.value());
-    if (attribute.getType() == TreeValue::Type::Folder || attribute.getType() == TreeValue::Type::File)
+    auto treeValue = TreeValue::fromStream(cursor.value());
+    if (treeValue.getType() == TreeValue::Type::Folder || treeValue.isFile())
         return std::nullopt;
-    return attribute;
+    return readValue(cursor.value(), m_cacheManager);
 }
 
 bool DirectoryStructure::rename(const DirectoryKey& oldKey, const DirectoryKey& newKey)
 {
-    auto res = m_btree.rename(oldKey, newKey);
-    return std::get_if<BTree::Inserted>(&res);
+    auto oldBtreeKey = findKey(oldKey);
+    if (!oldBtreeKey)
+        return false;
+
+    auto newBtreeKey = findKey(newKey);
+    auto newLongKey = !newBtreeKey;
+    if (newLongKey)
+        newBtreeKey = writeLongKey(newKey);
+
+    auto res = m_btree.rename(*oldBtreeKey, *newBtreeKey);
+    if (std::holds_alternative<BTree::Inserted>(res))
+    {
+        deleteLongKey(*oldBtreeKey);
+        return true;
+    }
+
+    if (newLongKey)
+        deleteLongKey(*newBtreeKey);
+    return false;
 }
 
 size_t DirectoryStructure::remove(Folder folder)
 {
-    std::vector<ByteString> keysToDelete;
-    for (auto cursor = begin(folder); cursor; cursor = next(cursor))
-        keysToDelete.emplace_back(cursor.m_cursor.key());
+    DirectoryKey lowKey(folder);
+    auto highKey = prefixEnd(lowKey);
+
+    std::vector<FileDescriptor> filesToDelete;
+    std::vector<Folder> foldersToDelete;
+    m_btree.visitRange(lowKey, highKey, [&](ByteStringView key, ByteStringView value) {
+        if (isLongKey(key))
+            filesToDelete.push_back(longKeyOverflow(key));
 
-    size_t numOfRemovedItems = 0;
-    for (const auto& k: keysToDelete)
-        numOfRemovedItems += remove(k);
+        if (isOverflow(value))
+        {
+            FileDescriptor fileDescriptor;
+            popOverflow(fileDescriptor, value);
+            filesToDelete.push_back(fileDescriptor);
+            return true;
+        }
+
+        auto treeValue = TreeValue::fromStream(value);
+        if (auto fileDescriptor = storedFile(treeValue))
+            filesToDelete.push_back(*fileDescriptor);
+        else if (treeValue.getType() == TreeValue::Type::Folder)
+            foldersToDelete.push_back(treeValue.get<Folder>());
+        return true;
+    });
+
+    size_t numOfRemovedItems = m_btree.removeRange(lowKey, highKey);
+    for (const auto& fileDescriptor: filesToDelete)
+        deleteFile(fileDescriptor);
+    for (auto subFolder: foldersToDelete)
+        numOfRemovedItems += remove(subFolder);
 
     return numOfRemovedItems;
 }
 
-size_t DirectoryStructure::remove(ByteStringView key)
+size_t DirectoryStructure::remove(const DirectoryKey& dkey)
 {
-    auto res = m_btree.remove(key);
+    auto key = findKey(dkey);
+    if (!key)
+        return 0;
+
+    auto res = m_btree.remove(*key);
     if (!res)
         return 0;
 
+    deleteLongKey(*key);
     auto deletedValue = TreeValue::fromStream(*res);
     switch (deletedValue.getType())
     {
@@ -163,32 +548,34 @@ size_t DirectoryStructure::remove(ByteStringView key)
         return remove(deletedValue.get<Folder>()) + 1;
 
     case TreeValue::Type::File:
-        m_freeStore.deleteFile(deletedValue.get<FileDescriptor>());
+    case TreeValue::Type::CompressedFile:
+        deleteFile(*storedFile(deletedValue));
         return 1;
 
     default:
+        deleteOverflow(*res);
         return 1;
     }
 }
 
-std::optional<FileDescriptor> DirectoryStructure::openFile(const DirectoryKey& dkey) const
+std::optional<TreeValue> DirectoryStructure::openFile(const DirectoryKey& dkey) const
 {
-    auto cursor = m_btree.find(dkey);
+    auto cursor = findEntry(dkey);
     if (!cursor)
         return std::nullopt;
 
     auto treeValue = TreeValue::fromStream(cursor.value());
-    if (treeValue.getType() != TreeValue::Type::File)
+    if (!treeValue.isFile())
         return std::nullopt;
 
-    return treeValue.get<FileDescriptor>();
+    return treeValue;
 }
 
 bool DirectoryStructure::createFile(const DirectoryKey& dkey)
 {
     ValueStream value(FileDescriptor {});
-    auto res = m_btree.insert(
-        dkey, value, [](ByteStringView bsv) { return TreeValue::fromStream(bsv).getType() == TreeValue::Type::File; });
+    auto res =
+        m_btree.insert(makeKey(dkey), value, [](ByteStringView bsv) { return TreeValue::fromStream(bsv).isFile(); });
 
     if (std::holds_alternative<BTree::Unchanged>(res))
         return false;
@@ -198,31 +585,36 @@ bool DirectoryStructure::createFile(const DirectoryKey& dkey)
         return true;
 
     auto beforeFile = TreeValue::fromStream(replaced->m_beforeValue);
-    m_freeStore.deleteFile(beforeFile.get<FileDescriptor>());
+    if (auto fileDescriptor = storedFile(beforeFile))
+        deleteFile(*fileDescriptor);
     return true;
 }
 
-std::optional<FileDescriptor> DirectoryStructure::appendFile(const DirectoryKey& dkey)
+std::optional<TreeValue> DirectoryStructure::appendFile(const DirectoryKey& dkey)
 {
     ValueStream value(FileDescriptor {});
-    auto res = m_btree.insert(dkey, value, [](ByteStringView) { return false; });
+    auto res = m_btree.insert(makeKey(dkey), value, [](ByteStringView) { return false; });
 
     if (std::holds_alternative<BTree::Inserted>(res))
         return FileDescriptor {};
 
     auto cursor = std::get<BTree::Unchanged>(res).m_currentValue;
     auto currentValue = TreeValue::fromStream(cursor.value());
-    if (currentValue.getType() != TreeValue::Type::File)
+    if (!currentValue.isFile())
         return std::nullopt;
 
-    return currentValue.get<FileDescriptor>();
+    return currentValue;
 }
 
-bool DirectoryStructure::updateFile(const DirectoryKey& dkey, FileDescriptor desc)
+bool DirectoryStructure::updateFile(const DirectoryKey& dkey, const TreeValue& file)
 {
-    ValueStream value = TreeValue { desc };
-    auto res = m_btree.insert(
-        dkey, value, [](ByteStringView bsv) { return TreeValue::fromStream(bsv).getType() == TreeValue::Type::File; });
+    assert(file.isFile());
+    auto key = findKey(dkey);
+    if (!key)
+        return false;
+
+    ValueStream value = file;
+    auto res = m_btree.insert(*key, value, [](ByteStringView bsv) { return TreeValue::fromStream(bsv).isFile(); });
 
     if (std::holds_alternative<BTree::Unchanged>(res))
         return false;
@@ -236,7 +628,423 @@ bool DirectoryStructure::updateFile(const DirectoryKey& dkey, FileDescriptor des
     return false;
 }
 
+void DirectoryStructure::deleteFile(const FileDescriptor& fileDescriptor)
+{
+    if (unmarkShared(fileDescriptor))
+        releasePages(fileDescriptor);
+    else
+        m_freeStore.deleteFile(fileDescriptor);
+    deletePageChecksums(fileDescriptor);
+}
+
+std::optional<std::vector<uint32_t>> DirectoryStructure::pageChecksums(const TreeValue& file) const
+{
+    auto fileDescriptor = storedFile(file);
+    if (!fileDescriptor || fileDescriptor->m_first == PageIdx::INVALID)
+        return std::nullopt;
+
+    auto folder = subFolder(DirectoryKey(SystemFolder, PageChecksumFolderName));
+    if (!folder)
+        return std::nullopt;
+
+    auto cursor = m_btree.find(DirectoryKey(*folder, std::to_string(fileDescriptor->m_first)));
+    if (!cursor)
+        return std::nullopt;
+
+    auto checksumFile = TreeValue::fromStream(cursor.value()).get<FileDescriptor>();
+    std::vector<uint32_t> checksums(size_t(checksumFile.m_fileSize / sizeof(uint32_t)));
+    FileReader reader(m_cacheManager);
+    reader.open(checksumFile);
+    reader.readIterator(checksums.begin(), checksums.end());
+    return checksums;
+}
+
+void DirectoryStructure::storePageChecksums(const TreeValue& file, const std::vector<uint32_t>& checksums)
+{
+    auto fileDescriptor = storedFile(file);
+    if (!fileDescriptor || fileDescriptor->m_first == PageIdx::INVALID)
+        return;
+
+    FileWriter writer(m_cacheManager);
+    auto begin = reinterpret_cast<const uint8_t*>(checksums.data());
+    writer.write(begin, begin + checksums.size() * sizeof(uint32_t));
+    ValueStream value(writer.close());
+
+    auto folder = makeSubFolder(DirectoryKey(SystemFolder, PageChecksumFolderName));
+    auto replaced = m_btree.insert(DirectoryKey(*folder, std::to_string(fileDescriptor->m_first)), value);
+    if (replaced)
+        m_freeStore.deleteFile(TreeValue::fromStream(*replaced).get<FileDescriptor>());
+}
+
+void DirectoryStructure::deletePageChecksums(const FileDescriptor& fileDescriptor)
+{
+    if (fileDescriptor.m_first == PageIdx::INVALID)
+        return;
+
+    auto folder = subFolder(DirectoryKey(SystemFolder, PageChecksumFolderName));
+    if (!folder)
+        return;
+
+    auto removed = m_btree.remove(DirectoryKey(*folder, std::to_string(fileDescriptor.m_first)));
+    if (removed)
+        m_freeStore.deleteFile(TreeValue::fromStream(*removed).get<FileDescriptor>());
+}
+
+/// Records that the file references shared extents. Must happen before the file can be deleted.
+void DirectoryStructure::markShared(const TreeValue& file)
+{
+    auto fileDescriptor = storedFile(file);
+    if (!fileDescriptor || fileDescriptor->m_first == PageIdx::INVALID)
+        return;
+
+    auto folder = makeSubFolder(DirectoryKey(SystemFolder, SharedFileFolderName));
+    m_btree.insert(DirectoryKey(*folder, std::to_string(fileDescriptor->m_first)), ValueStream(uint32_t(0)));
+}
+
+bool DirectoryStructure::unmarkShared(const FileDescriptor& fileDescriptor)
+{
+    if (fileDescriptor.m_first == PageIdx::INVALID)
+        return false;
+
+    auto folder = subFolder(DirectoryKey(SystemFolder, SharedFileFolderName));
+    if (!folder)
+        return false;
+
+    return m_btree.remove(DirectoryKey(*folder, std::to_string(fileDescriptor.m_first))).has_value();
+}
+
+/// Returns the shared extents starting in pages. Extents are always referenced as a whole, so they end in pages too.
+std::vector<DirectoryStructure::SharedExtent> DirectoryStructure::sharedExtents(Interval pages) const
+{
+    std::vector<SharedExtent> extents;
+    auto folder = subFolder(DirectoryKey(SystemFolder, SharedExtentFolderName));
+    if (!folder)
+        return extents;
+
+    m_btree.visitRange(extentKey(*folder, pages.begin()), extentKey(*folder, pages.end()),
+                       [&](ByteStringView key, ByteStringView value) {
+                           auto first = extentPage(key);
+                           auto packed = TreeValue::fromStream(value).get<uint64_t>();
+                           extents.push_back({ Interval(first, first + PageIndex(packed >> 32)), uint32_t(packed) });
+                           return true;
+                       });
+    return extents;
+}
+
+/// The value packs the length of the extent and its reference count. Unreferenced extents are removed.
+void DirectoryStructure::storeSharedExtent(const SharedExtent& extent)
+{
+    auto folder = makeSubFolder(DirectoryKey(SystemFolder, SharedExtentFolderName));
+    auto key = extentKey(*folder, extent.m_pages.begin());
+    if (extent.m_refCount == 0)
+    {
+        m_btree.remove(key);
+        removeChunk(extent.m_pages.begin());
+    }
+    else
+        m_btree.insert(key, ValueStream((uint64_t(extent.m_pages.length()) << 32) | extent.m_refCount));
+}
+
+/// Frees the FileTables of a file with shared extents and all of its pages no other file references.
+void DirectoryStructure::releasePages(const FileDescriptor& fileDescriptor)
+{
+    std::vector<PageIndex> fileTables;
+    auto pages = loadPages(m_cacheManager, fileDescriptor, fileTables);
+    for (auto page: fileTables)
+        m_freeStore.deallocate(page);
+
+    for (auto iv: pages)
+    {
+        auto begin = iv.begin();
+        for (auto extent: sharedExtents(iv))
+        {
+            if (begin != extent.m_pages.begin())
+                m_freeStore.deallocate(Interval(begin, extent.m_pages.begin()));
+            if (--extent.m_refCount == 0)
+                m_freeStore.deallocate(extent.m_pages);
+            storeSharedExtent(extent);
+            begin = extent.m_pages.end();
+        }
+        if (begin != iv.end())
+            m_freeStore.deallocate(Interval(begin, iv.end()));
+    }
+}
+
+/// Adds a reference to pages. Pages that are not shared yet start with two: their owner and the new one.
+void DirectoryStructure::sharePages(Interval pages)
+{
+    auto begin = pages.begin();
+    for (auto extent: sharedExtents(pages))
+    {
+        if (begin != extent.m_pages.begin())
+            storeSharedExtent({ Interval(begin, extent.m_pages.begin()), 2 });
+        extent.m_refCount++;
+        storeSharedExtent(extent);
+        begin = extent.m_pages.end();
+    }
+    if (begin != pages.end())
+        storeSharedExtent({ Interval(begin, pages.end()), 2 });
+}
+
+/// Drops a file's reference to its shared, partially filled last page before the file appends to it. Returns false if
+/// no other file references the page, so it can be written in place.
+bool DirectoryStructure::unsharePage(PageIndex page)
+{
+    auto extents = sharedExtents(Interval(page));
+    if (extents.empty() || extents[0].m_refCount == 1)
+        return false;
+
+    assert(extents[0].m_pages == Interval(page));
+    extents[0].m_refCount--;
+    storeSharedExtent(extents[0]);
+    return true;
+}
+
+/// Returns a file sharing all data pages with the given one. Only the FileTables are copied.
+TreeValue DirectoryStructure::cloneFile(const TreeValue& file)
+{
+    auto fileDescriptor = storedFile(file);
+    if (!fileDescriptor || fileDescriptor->m_first == PageIdx::INVALID)
+        return file;
+
+    std::vector<PageIndex> fileTables;
+    auto pages = loadPages(m_cacheManager, *fileDescriptor, fileTables);
+
+    // a partially filled last page becomes an extent of its own, see unsharePage()
+    auto partialPage = fileDescriptor->m_fileSize % PageSize ? pages.back().end() - 1 : PageIdx::INVALID;
+    for (auto iv: pages)
+    {
+        if (iv.end() - 1 != partialPage)
+            sharePages(iv);
+        else
+        {
+            if (iv.length() > 1)
+                sharePages(Interval(iv.begin(), partialPage));
+            sharePages(Interval(partialPage));
+        }
+    }
+
+    FileWriter writer(m_cacheManager);
+    TreeValue clone = writer.createFrom(std::move(pages), fileDescriptor->m_fileSize);
+    if (file.getType() == TreeValue::Type::CompressedFile)
+        clone = CompressedFile { clone.get<FileDescriptor>(), file.get<CompressedFile>().m_fileSize };
+
+    markShared(file);
+    markShared(clone);
+    if (auto checksums = pageChecksums(file))
+        storePageChecksums(clone, *checksums);
+    return clone;
+}
+
+/// Clones files, attributes and folders with all their contents. Returns the number of cloned entries.
+size_t DirectoryStructure::clone(const DirectoryKey& source, const DirectoryKey& dest)
+{
+    auto cursor = findEntry(source);
+    if (!cursor)
+        return 0;
+
+    if (isOverflow(cursor.value()))
+        return addAttribute(dest, readValue(cursor.value(), m_cacheManager));
+
+    auto treeValue = TreeValue::fromStream(cursor.value());
+    if (treeValue.getType() == TreeValue::Type::Folder)
+        return cloneFolder(treeValue.get<Folder>(), dest);
+
+    if (!treeValue.isFile())
+        return addAttribute(dest, treeValue);
+
+    // clone before createFile() replaces dest, which might be the source
+    auto file = cloneFile(treeValue);
+    if (!createFile(dest))
+    {
+        if (auto fileDescriptor = storedFile(file))
+            deleteFile(*fileDescriptor);
+        return 0;
+    }
+    updateFile(dest, file);
+    return 1;
+}
+
+size_t DirectoryStructure::cloneFolder(Folder source, const DirectoryKey& dest)
+{
+    // Collect the whole tree before creating anything: dest might be anywhere inside source. The entries are in an
+    // order where each folder comes before its contents; m_parent is 0 for source or the index + 1 of the folder entry.
+    struct Entry
+    {
+        size_t m_parent;
+        Folder m_folder;
+        std::string m_name;
+        std::optional<Folder> m_subFolder;
+    };
+    std::vector<Entry> entries;
+    std::vector<std::pair<Folder, size_t>> folders { { source, 0 } };
+    while (!folders.empty())
+    {
+        auto folder = folders.back().first;
+        auto parent = folders.back().second;
+        folders.pop_back();
+        auto first = entries.size();
+        std::vector<std::pair<size_t, ByteString>> longKeys;
+        DirectoryKey lowKey(folder);
+        m_btree.visitRange(lowKey, prefixEnd(lowKey), [&](ByteStringView key, ByteStringView value) {
+            Folder keyFolder;
+            auto name = ByteStringStream::pop(keyFolder, key);
+            if (isLongKey(key))
+                longKeys.emplace_back(entries.size(), key);
+
+            std::optional<Folder> subFolder;
+            if (!isOverflow(value))
+            {
+                auto treeValue = TreeValue::fromStream(value);
+                if (treeValue.getType() == TreeValue::Type::Folder)
+                    subFolder = treeValue.get<Folder>();
+            }
+            entries.push_back({ parent, folder, std::string(name.data(), name.end()), subFolder });
+            return true;
+        });
+        for (const auto& [entry, key]: longKeys)
+            entries[entry].m_name = readLongName(key, m_cacheManager);
+        for (auto i = first; i < entries.size(); i++)
+            if (entries[i].m_subFolder)
+                folders.emplace_back(*entries[i].m_subFolder, i + 1);
+    }
+
+    std::vector<std::optional<Folder>> destFolders(entries.size() + 1);
+    destFolders[0] = makeSubFolder(dest);
+    if (!destFolders[0])
+        return 0;
+
+    size_t numOfClonedItems = 1;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const auto& entry = entries[i];
+        auto parent = destFolders[entry.m_parent];
+        if (!parent)
+            continue; // the folder could not be created
+        DirectoryKey destKey(*parent, entry.m_name);
+        if (entry.m_subFolder)
+        {
+            destFolders[i + 1] = makeSubFolder(destKey);
+            numOfClonedItems += destFolders[i + 1].has_value();
+        }
+        else
+            numOfClonedItems += clone(DirectoryKey(entry.m_folder, entry.m_name), destKey);
+    }
+    return numOfClonedItems;
+}
+
+std::optional<Interval> DirectoryStructure::findChunk(uint64_t hash, const uint8_t* begin, const uint8_t* end)
+{
+    auto folder = subFolder(DirectoryKey(SystemFolder, ChunkHashFolderName));
+    if (!folder)
+        return std::nullopt;
+
+    auto cursor = m_btree.find(chunkKey(*folder, hash));
+    if (!cursor)
+        return std::nullopt;
+
+    // the pages may hold other data on a hash collision or have been freed by a version that kept the hash entries:
+    // check they are still shared and compare them
+    auto first = TreeValue::fromStream(cursor.value()).get<uint32_t>();
+    Interval pages(first, first + PageIndex((end - begin) / PageSize));
+    auto extents = sharedExtents(Interval(first));
+    if (extents.size() != 1 || extents[0].m_pages != pages)
+        return std::nullopt;
+
+    std::vector<uint8_t> stored(end - begin);
+    m_cacheManager->getFileInterface()->readPages(pages, stored.data());
+    if (!std::equal(begin, end, stored.begin()))
+        return std::nullopt;
+
+    extents[0].m_refCount++;
+    storeSharedExtent(extents[0]);
+    return pages;
+}
+
+void DirectoryStructure::addChunk(uint64_t hash, Interval pages)
+{
+    storeSharedExtent({ pages, 1 });
+    auto folder = makeSubFolder(DirectoryKey(SystemFolder, ChunkHashFolderName));
+    m_btree.insert(chunkKey(*folder, hash), ValueStream(uint32_t(pages.begin())));
+    auto pageFolder = makeSubFolder(DirectoryKey(SystemFolder, ChunkPageFolderName));
+    m_btree.insert(extentKey(*pageFolder, pages.begin()), ValueStream(hash));
+}
+
+/// Drops the hash entry of the chunk starting at first, unless a later chunk with the same hash took it over.
+void DirectoryStructure::removeChunk(PageIndex first)
+{
+    auto pageFolder = subFolder(DirectoryKey(SystemFolder, ChunkPageFolderName));
+    if (!pageFolder)
+        return;
+
+    auto removed = m_btree.remove(extentKey(*pageFolder, first));
+    if (!removed)
+        return;
+
+    auto hash = TreeValue::fromStream(*removed).get<uint64_t>();
+    auto folder = subFolder(DirectoryKey(SystemFolder, ChunkHashFolderName));
+    auto key = chunkKey(*folder, hash);
+    auto cursor = m_btree.find(key);
+    if (cursor && TreeValue::fromStream(cursor.value()).get<uint32_t>() == first)
+        m_btree.remove(key);
+}
+
+/// Verifies the data pages of all files that have page checksums. Loading the directory and the FileTables
+/// checks their page signatures on the way.
+DirectoryStructure::ScrubResult DirectoryStructure::scrub() const
+{
+    ScrubResult result;
+    for (auto cursor = m_btree.begin({}); cursor; cursor = m_btree.next(cursor))
+    {
+        if (isOverflow(cursor.value()))
+            continue;
+
+        auto file = TreeValue::fromStream(cursor.value());
+        auto checksums = pageChecksums(file);
+        if (!checksums)
+            continue;
+
+        result.m_checkedFiles++;
+        result.m_checkedPages += checksums->size();
+        if (!verifyPages(m_cacheManager, *storedFile(file), *checksums))
+        {
+            auto key = makeCursor(cursor).key();
+            result.m_corruptFiles.emplace_back(key.first, std::string(key.second));
+        }
+    }
+    return result;
+}
+
 void DirectoryStructure::commit()
+{
+    auto cb = prepareCommit();
+    auto commitHandler = m_cacheManager->getCommitHandler();
+    commitHandler.commit();
+    assert(commitHandler.empty());
+
+    m_freeStore = FreeStore(m_cacheManager, cb.m_freeStoreDescriptor);
+    connectFreeStore();
+    assert(cb.m_compositSize == commitHandler.getCompositeSize());
+    assert(m_btree.getFreePages().empty());
+}
+
+/// Like commit() but the pages are written on a background thread, see CacheManager::commitAsync(). The next
+/// transaction may add as many pages to the file as this one did before it has to wait for the commit.
+void DirectoryStructure::commitAsync()
+{
+    auto previousSize = retrieveCommitBlock().m_compositSize;
+    auto cb = prepareCommit();
+    auto addedPages = cb.m_compositSize - std::min(previousSize, cb.m_compositSize);
+    m_cacheManager->commitAsync(size_t(std::clamp(addedPages, MinReservedPages, MaxReservedPages)));
+
+    m_freeStore = FreeStore(m_cacheManager, cb.m_freeStoreDescriptor);
+    connectFreeStore();
+    assert(m_btree.getFreePages().empty());
+}
+
+/// Hands the pages freed by the transaction to the FreeStore, closes it and stores the commit block, which is
+/// returned.
+CommitBlock DirectoryStructure::prepareCommit()
 {
     const auto& freePages = m_btree.getFreePages();
     for (auto page: freePages)
@@ -252,20 +1060,18 @@ void DirectoryStructure::commit()
     m_cacheManager->setPageIntervalAllocator(std::function<Interval(size_t)>());
     CommitBlock cb;
     cb.m_freeStoreDescriptor = m_freeStore.close();
+    m_cacheManager->releaseReservedPages();
     cb.m_compositSize = commitHandler.getCompositeSize();
     cb.m_maxFolderId = m_maxFolderId;
+    cb.m_longNames = m_longNames;
     storeCommitBlock(cb);
-    commitHandler.commit();
-    assert(commitHandler.empty());
-
-    m_freeStore = FreeStore(m_cacheManager, cb.m_freeStoreDescriptor);
-    connectFreeStore();
-    assert(cb.m_compositSize == commitHandler.getCompositeSize());
-    assert(m_btree.getFreePages().empty());
+    m_cacheManager->clearPageLoads(); // the commit may free pages loaded so far
+    return cb;
 }
 
 void DirectoryStructure::rollback()
 {
+    m_cacheManager->releaseReservedPages();
     auto commitBlock = retrieveCommitBlock();
     auto compositeSize = static_cast<size_t>(commitBlock.m_compositSize);
     m_cacheManager->getRollbackHandler().rollback(compositeSize);
@@ -281,7 +1087,13 @@ void DirectoryStructure::init()
 
 void DirectoryStructure::init(const CommitBlock& commitBlock)
 {
+    if (commitBlock.m_pageSize != PageSize)
+        throw std::runtime_error("DirectoryStructure: file uses a page size of " +
+                                 std::to_string(commitBlock.m_pageSize) + " bytes but this build uses " +
+                                 std::to_string(PageSize));
+
     m_maxFolderId = commitBlock.m_maxFolderId;
+    m_longNames = commitBlock.m_longNames;
     m_btree = BTree(m_cacheManager, m_rootIndex);
     m_freeStore = FreeStore(m_cacheManager, commitBlock.m_freeStoreDescriptor);
     connectFreeStore();
@@ -306,14 +1118,22 @@ std::pair<Folder, std::string_view> DirectoryStructure::Cursor::key() const
     auto key = m_cursor.key();
     Folder folder;
     auto name = ByteStringStream::pop(folder, key); // TODO: fix ByteStringStream to consume std::string_views
+    if (m_longName)
+        return std::pair(folder, std::string_view(*m_longName));
+
     std::string_view nameView(reinterpret_cast<const char*>(name.data()), name.size());
     return std::pair(folder, nameView);
 }
 
+TreeValue DirectoryStructure::Cursor::value() const
+{
+    return readValue(m_cursor.value(), m_cacheManager);
+}
+
 DirectoryStructure::Cursor DirectoryStructure::next(Cursor cursor) const
 {
     auto folder = cursor.key().first;
-    cursor = m_btree.next(cursor.m_cursor);
+    cursor = makeCursor(m_btree.next(cursor.m_cursor));
     if (cursor && cursor.key().first != folder)
         cursor = Cursor();
     return cursor;
@@ -322,8 +1142,36 @@ DirectoryStructure::Cursor DirectoryStructure::next(Cursor cursor) const
 DirectoryStructure::Cursor DirectoryStructure::begin(const DirectoryKey& dkey) const
 {
     auto folder = dkey.getFolder();
-    DirectoryStructure::Cursor cursor = m_btree.begin(dkey);
+    auto cursor = makeCursor(m_btree.begin(isLongName(dkey) ? longKeyPrefix(dkey) : ByteStringView(dkey)));
     if (cursor && cursor.key().first != folder)
         cursor = Cursor();
     return cursor;
 }
+
+DirectoryStructure::Cursor DirectoryStructure::find(const DirectoryKey& dkey) const
+{
+    return makeCursor(findEntry(dkey));
+}
+
+/// Long names are looked up one by one, all others in one pass over the tree.
+std::vector<DirectoryStructure::Cursor> DirectoryStructure::findMany(const std::vector<DirectoryKey>& dkeys) const
+{
+    std::vector<Cursor> cursors(dkeys.size());
+    std::vector<ByteStringView> keys;
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < dkeys.size(); i++)
+    {
+        if (isLongName(dkeys[i]))
+            cursors[i] = find(dkeys[i]);
+        else
+        {
+            keys.push_back(dkeys[i]);
+            positions.push_back(i);
+        }
+    }
+
+    auto btreeCursors = m_btree.findMany(keys);
+    for (size_t i = 0; i < btreeCursors.size(); i++)
+        cursors[positions[i]] = makeCursor(btreeCursors[i]);
+    return cursors;
+}
@@ -5,8 +5,11 @@
 #include "FreeStore.h"
 #include "BTree.h"
 #include "TreeValue.h"
+#include "ChunkIndex.h"
 #include <memory>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 namespace TxFs
 {
@@ -16,19 +19,32 @@ struct CommitBlock;
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/// Folder and name of a directory entry. Names longer than maxSize() keep the rest in overflow(); the
+/// DirectoryStructure stores them as long keys.
 class DirectoryKey final
 {
 public:
     DirectoryKey(ByteStringView name)
-    {
-        m_key.push(Folder::Root);
-        m_key.push(name); 
-    }
+        : DirectoryKey(Folder::Root, name)
+    {}
+
+    template <typename TStr, typename = EnableWithString<TStr>>
+    DirectoryKey(TStr&& name)
+        : DirectoryKey(Folder::Root, std::string_view(name))
+    {}
 
     DirectoryKey(Folder folder, ByteStringView name)
+        : DirectoryKey(folder, std::string_view(reinterpret_cast<const char*>(name.data()), name.size()))
+    {}
+
+    template <typename TStr, typename = EnableWithString<TStr>>
+    DirectoryKey(Folder folder, TStr&& name)
     {
+        std::string_view nameView { name };
+        auto size = std::min(nameView.size(), maxSize());
         m_key.push(folder);
-        m_key.push(name);
+        m_key.push(ByteStringView(nameView.substr(0, size)));
+        m_overflow = nameView.substr(size);
     }
 
     DirectoryKey(Folder folder) noexcept { m_key.push(folder); }
@@ -41,15 +57,22 @@ public:
         return folder;
     }
 
+    std::string_view overflow() const noexcept { return m_overflow; }
+    size_t nameSize() const noexcept { return ByteStringView(m_key).size() - sizeof(Folder) + m_overflow.size(); }
+
     static constexpr size_t maxSize() noexcept { return ByteString::maxSize() - sizeof(Folder); }
 
+    /// The entries of a folder are only sorted by the first sortedSize() bytes of their names.
+    static constexpr size_t sortedSize() noexcept { return maxSize() - sizeof(FileDescriptor); }
+
 private:
     ByteStringStream m_key;
+    std::string m_overflow;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class DirectoryStructure final
+class DirectoryStructure final : private ChunkIndex
 {
 public:
     class Cursor;
@@ -60,6 +83,13 @@ public:
         PageIndex m_rootIndex;
     };
 
+    struct ScrubResult
+    {
+        size_t m_checkedFiles = 0;
+        uint64_t m_checkedPages = 0;
+        std::vector<std::pair<Folder, std::string>> m_corruptFiles;
+    };
+
 public:
     DirectoryStructure(const Startup& startup);
     DirectoryStructure(DirectoryStructure&&) noexcept;
@@ -75,28 +105,66 @@ public:
     std::optional<TreeValue> getAttribute(const DirectoryKey& dkey) const;
 
     bool rename(const DirectoryKey& oldKey, const DirectoryKey& newKey);
-    size_t remove(ByteStringView key);
+    size_t remove(const DirectoryKey& dkey);
     size_t remove(Folder folder);
 
-    std::optional<FileDescriptor> openFile(const DirectoryKey& dkey) const;
+    std::optional<TreeValue> openFile(const DirectoryKey& dkey) const;
     bool createFile(const DirectoryKey& dkey);
-    std::optional<FileDescriptor> appendFile(const DirectoryKey& dkey);
-    bool updateFile(const DirectoryKey& dkey, FileDescriptor desc);
+    std::optional<TreeValue> appendFile(const DirectoryKey& dkey);
+    bool updateFile(const DirectoryKey& dkey, const TreeValue& file);
+
+    size_t clone(const DirectoryKey& source, const DirectoryKey& dest);
+    size_t cloneFolder(Folder source, const DirectoryKey& dest);
+    TreeValue cloneFile(const TreeValue& file);
+    bool unsharePage(PageIndex page);
+
+    std::optional<std::vector<uint32_t>> pageChecksums(const TreeValue& file) const;
+    void storePageChecksums(const TreeValue& file, const std::vector<uint32_t>& checksums);
+    ScrubResult scrub() const;
+
+    ChunkIndex* chunkIndex() noexcept { return this; }
+    IntervalSequence freePages() const { return m_freeStore.freePages(); }
+    std::vector<PageIndex> freeStorePages() const { return m_freeStore.fileTablePages(); }
+    void markShared(const TreeValue& file);
 
     Cursor find(const DirectoryKey& dkey) const;
+    std::vector<Cursor> findMany(const std::vector<DirectoryKey>& keys) const;
     Cursor begin(const DirectoryKey& dkey) const;
     Cursor next(Cursor cursor) const;
 
     void commit();
+    void commitAsync();
     void rollback();
 
     void storeCommitBlock(const CommitBlock&);
     CommitBlock retrieveCommitBlock() const;
 
 private:
+    CommitBlock prepareCommit();
     void connectFreeStore();
     void init(const CommitBlock& cb);
-
+    bool isLongName(const DirectoryKey& dkey) const;
+    bool isLongKey(ByteStringView key) const noexcept;
+    std::optional<ByteString> findKey(const DirectoryKey& dkey) const;
+    ByteString makeKey(const DirectoryKey& dkey);
+    ByteString writeLongKey(const DirectoryKey& dkey);
+    BTree::Cursor findEntry(const DirectoryKey& dkey) const;
+    void deleteLongKey(ByteStringView key);
+    Cursor makeCursor(const BTree::Cursor& cursor) const;
+    std::optional<FileDescriptor> writeOverflow(const TreeValue& attribute);
+    void deleteOverflow(ByteStringView value);
+    void deleteFile(const FileDescriptor& fileDescriptor);
+    void deletePageChecksums(const FileDescriptor& fileDescriptor);
+
+    struct SharedExtent;
+    std::optional<Interval> findChunk(uint64_t hash, const uint8_t* begin, const uint8_t* end) override;
+    void addChunk(uint64_t hash, Interval pages) override;
+    void removeChunk(PageIndex first);
+    std::vector<SharedExtent> sharedExtents(Interval pages) const;
+    void storeSharedExtent(const SharedExtent& extent);
+    void sharePages(Interval pages);
+    bool unmarkShared(const FileDescriptor& fileDescriptor);
+    void releasePages(const FileDescriptor& fileDescriptor);
 
 private:
     std::shared_ptr<CacheManager> m_cacheManager;
@@ -104,6 +172,7 @@ private:
     uint32_t m_maxFolderId;
     FreeStore m_freeStore;
     PageIndex m_rootIndex;
+    bool m_longNames;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -114,30 +183,26 @@ class DirectoryStructure::Cursor final
 
 public:
     constexpr Cursor() noexcept = default;
-    Cursor(const BTree::Cursor& cursor) noexcept
+    Cursor(const BTree::Cursor& cursor, const std::shared_ptr<CacheManager>& cacheManager,
+           std::shared_ptr<const std::string> longName = {}) noexcept
         : m_cursor(cursor)
+        , m_cacheManager(cacheManager)
+        , m_longName(std::move(longName))
     {}
 
     constexpr bool operator==(const Cursor& rhs) const noexcept { return m_cursor == rhs.m_cursor; }
     constexpr bool operator!=(const Cursor& rhs) const noexcept { return !(m_cursor == rhs.m_cursor); }
 
     std::pair<Folder,std::string_view> key() const;
-    TreeValue value() const { return TreeValue::fromStream(m_cursor.value());}
+    TreeValue value() const;
     constexpr explicit operator bool() const noexcept { return m_cursor.operator bool(); }
 
 private:
     BTree::Cursor m_cursor;
+    std::shared_ptr<CacheManager> m_cacheManager;
+    std::shared_ptr<const std::string> m_longName; // the name of a long key, read from its overflow file
 };
 
-//////////////////////////////////////////////////////////////////////////
-
-inline DirectoryStructure::Cursor DirectoryStructure::find(const DirectoryKey& dkey) const
-{
-    return m_btree.find(dkey);
-}
-
-
-
 
 
 }
@@ -26,7 +26,8 @@ enum class OpenMode
 /// This is the abstraction of a file for CompoundFs. You have to allocate with newInterval()
 /// before you write to the file. Locking is advisory. Make sure you have acquired the 
 /// correct locks before you write to a file (linux will not even fail writes). All APIs 
-/// will throw exceptions on failures.
+/// will throw exceptions on failures. Reads, and writes to pages inside the file, may be issued from several threads
+/// at once as long as no two of them touch the same page. So may a truncate() that cuts off pages no other thread uses.
 
 class FileInterface
 {
@@ -39,6 +40,10 @@ public:
     virtual uint8_t* readPage(PageIndex id, size_t pageOffset, uint8_t* begin, uint8_t* end) const = 0;
     virtual uint8_t* readPages(Interval iv, uint8_t* page) const = 0;
     virtual size_t fileSizeInPages() const = 0; 
+
+    /// Copies pages from another file without passing them through memory. Returns false if that is not possible
+    /// for this source; the caller has to read and write the pages itself then.
+    virtual bool copyPages(const FileInterface&, Interval, PageIndex) { return false; }
     virtual void flushFile() = 0;
     virtual void truncate(size_t numberOfPages) = 0;
 
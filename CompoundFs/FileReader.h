@@ -6,7 +6,16 @@
 #include "TypedCacheManager.h"
 #include "PageDef.h"
 #include "FileInterface.h"
+#include "Compression.h"
+#include "Hasher.h"
+#include "TreeValue.h"
 #include <algorithm>
+#include <optional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <vector>
 
 namespace TxFs
 {
@@ -25,8 +34,12 @@ public:
 
     void open(FileDescriptor fileId)
     {
+        m_isInline = false;
+        m_isCompressed = false;
+        m_pageChecksums.reset();
         m_curFilePos = 0;
         m_fileSize = fileId.m_fileSize;
+        m_pageSequence.clear();
         if (fileId != FileDescriptor())
         {
             ConstPageDef<FileTable> fileTable = m_cacheManager.loadPage<FileTable>(fileId.m_first);
@@ -37,6 +50,35 @@ public:
             m_nextFileTable = PageIdx::INVALID;
     }
 
+    void openInline(std::string_view data)
+    {
+        m_inlineData.assign(data.begin(), data.end());
+        m_isInline = true;
+        m_isCompressed = false;
+        m_curFilePos = 0;
+        m_fileSize = data.size();
+        m_pageSequence = IntervalSequence();
+        m_nextFileTable = PageIdx::INVALID;
+    }
+
+    /// Decompresses the chunks of a file written by FileWriter::openCompressed() while reading.
+    void openCompressed(const CompressedFile& file)
+    {
+        open(file.m_descriptor);
+        m_isCompressed = true;
+        m_uncompressedPos = 0;
+        m_uncompressedSize = file.m_fileSize;
+        m_chunk.clear();
+        m_chunkPos = 0;
+    }
+
+    /// Verifies every data page against its checksum (see FileWriter::enablePageChecksums()) while reading.
+    void setPageChecksums(std::vector<uint32_t> checksums)
+    {
+        m_pageChecksums = std::move(checksums);
+        m_verifiedPage = std::numeric_limits<uint64_t>::max();
+    }
+
     Interval nextInterval(uint32_t maxSize)
     {
         if (m_pageSequence.empty())
@@ -52,6 +94,38 @@ public:
     }
 
     uint8_t* read(uint8_t* begin, uint8_t* end)
+    {
+        if (m_isCompressed)
+            return readChunks(begin, end);
+        return readPages(begin, end);
+    }
+
+    uint64_t bytesLeft() const { return size() - (m_isCompressed ? m_uncompressedPos : m_curFilePos); }
+    uint64_t size() const { return m_isCompressed ? m_uncompressedSize : m_fileSize; }
+
+    template <class TIter>
+    uint8_t* readIterator(TIter begin, TIter end)
+    {
+        return read((uint8_t*) &begin[0], (uint8_t*) &begin[end - begin]);
+    }
+
+    using Visitor = std::function < bool(const ConstPageDef<FileTable>&)>;
+    bool visitAllFileTables(FileDescriptor fd, const Visitor& visitor) const 
+    { 
+        auto idx = fd.m_first;
+        while (idx != PageIdx::INVALID)
+        {
+            ConstPageDef<FileTable> ftp = m_cacheManager.loadPage<FileTable>(idx);
+            if (!visitor(ftp))
+                return false;
+            idx = ftp.m_page->getNext();
+            assert(idx != PageIdx::INVALID || ftp.m_index == fd.m_last);
+        }
+        return true;
+    }
+
+private:
+    uint8_t* readPages(uint8_t* begin, uint8_t* end)
     {
         assert(begin <= end);
 
@@ -62,16 +136,26 @@ public:
 
         end = begin + blockSize;
 
+        if (m_isInline)
+        {
+            auto data = m_inlineData.data() + m_curFilePos;
+            m_curFilePos += blockSize;
+            return std::copy(data, data + blockSize, begin);
+        }
+
         // read the remainder of this page
-        if (m_curFilePos % 4096)
+        uint64_t pageNo = m_curFilePos / PageSize;
+        if (m_curFilePos % PageSize)
         {
-            size_t pageOffset = size_t(m_curFilePos % 4096);
+            size_t pageOffset = size_t(m_curFilePos % PageSize);
             PageIndex pageId = m_pageSequence.front().begin();
-            if ((pageOffset + blockSize) >= 4096)
+            verifyPage(pageId, pageNo);
+            if ((pageOffset + blockSize) >= PageSize)
             {
                 begin = m_cacheManager.getFileInterface()->readPage(pageId, pageOffset, begin,
-                                                                       begin + (4096 - pageOffset));
+                                                                       begin + (PageSize - pageOffset));
                 nextInterval(1); // remove that page
+                pageNo++;
             }
             else
             {
@@ -80,11 +164,14 @@ public:
         }
 
         // read full pages
-        size_t pages = (end - begin) / 4096;
+        size_t pages = (end - begin) / PageSize;
         while (pages > 0)
         {
             Interval iv = nextInterval((uint32_t) pages);
+            auto pagesBegin = begin;
             begin = m_cacheManager.getFileInterface()->readPages(iv, begin);
+            for (; pagesBegin != begin; pagesBegin += PageSize)
+                checkPage(pageNo++, pagesBegin, PageSize);
             pages -= iv.length();
         }
 
@@ -92,6 +179,7 @@ public:
         if (end - begin)
         {
             PageIndex pageId = nextInterval(0).begin();
+            verifyPage(pageId, pageNo);
             begin = m_cacheManager.getFileInterface()->readPage(pageId, 0, begin, end);
         }
 
@@ -99,28 +187,61 @@ public:
         return begin;
     }
 
-    uint64_t bytesLeft() const { return m_fileSize - m_curFilePos; }
-    uint64_t size() const { return m_fileSize; }
+    // Checks a page that is only partially read by reading all of its used bytes
+    void verifyPage(PageIndex pageId, uint64_t pageNo)
+    {
+        if (!m_pageChecksums || pageNo == m_verifiedPage)
+            return;
 
-    template <class TIter>
-    uint8_t* readIterator(TIter begin, TIter end)
+        m_checksumPage.resize(size_t(std::min(uint64_t(PageSize), m_fileSize - pageNo * PageSize)));
+        m_cacheManager.getFileInterface()->readPage(pageId, 0, m_checksumPage.data(),
+                                                    m_checksumPage.data() + m_checksumPage.size());
+        checkPage(pageNo, m_checksumPage.data(), m_checksumPage.size());
+        m_verifiedPage = pageNo;
+    }
+
+    void checkPage(uint64_t pageNo, const uint8_t* page, size_t size) const
     {
-        return read((uint8_t*) &begin[0], (uint8_t*) &begin[end - begin]);
+        if (!m_pageChecksums)
+            return;
+        if (pageNo >= m_pageChecksums->size() || (*m_pageChecksums)[size_t(pageNo)] != hash32(page, size))
+            throw std::runtime_error("FileReader: checksum mismatch in data page " + std::to_string(pageNo));
     }
 
-    using Visitor = std::function < bool(const ConstPageDef<FileTable>&)>;
-    bool visitAllFileTables(FileDescriptor fd, const Visitor& visitor) const 
-    { 
-        auto idx = fd.m_first;
-        while (idx != PageIdx::INVALID)
+    uint8_t* readChunks(uint8_t* begin, uint8_t* end)
+    {
+        while (begin != end)
         {
-            ConstPageDef<FileTable> ftp = m_cacheManager.loadPage<FileTable>(idx);
-            if (!visitor(ftp))
-                return false;
-            idx = ftp.m_page->getNext();
-            assert(idx != PageIdx::INVALID || ftp.m_index == fd.m_last);
+            if (m_chunkPos == m_chunk.size())
+            {
+                if (m_curFilePos == m_fileSize)
+                    break;
+                loadChunk();
+            }
+
+            auto size = std::min(size_t(end - begin), m_chunk.size() - m_chunkPos);
+            begin = std::copy_n(m_chunk.data() + m_chunkPos, size, begin);
+            m_chunkPos += size;
+            m_uncompressedPos += size;
         }
-        return true;
+        return begin;
+    }
+
+    void loadChunk()
+    {
+        ChunkHeader header;
+        auto headerBegin = reinterpret_cast<uint8_t*>(&header);
+        if (readPages(headerBegin, headerBegin + sizeof(header)) != headerBegin + sizeof(header))
+            throw std::runtime_error("FileReader: truncated compressed file");
+
+        m_compressedChunk.resize(header.m_storedSize);
+        auto payloadEnd = m_compressedChunk.data() + header.m_storedSize;
+        if (readPages(m_compressedChunk.data(), payloadEnd) != payloadEnd)
+            throw std::runtime_error("FileReader: truncated compressed file");
+
+        m_chunk.resize(header.m_size);
+        decompressChunk(header, m_compressedChunk.data(), m_chunk.data());
+        m_chunkPos = 0;
     }
 
 private:
@@ -130,6 +251,17 @@ private:
     uint64_t m_curFilePos;
     uint64_t m_fileSize;
     uint32_t m_nextFileTable;
+    std::string m_inlineData;
+    bool m_isInline = false;
+    std::vector<uint8_t> m_chunk;
+    std::vector<uint8_t> m_compressedChunk;
+    size_t m_chunkPos = 0;
+    uint64_t m_uncompressedPos = 0;
+    uint64_t m_uncompressedSize = 0;
+    bool m_isCompressed = false;
+    std::optional<std::vector<uint32_t>> m_pageChecksums;
+    std::vector<uint8_t> m_checksumPage;
+    uint64_t m_verifiedPage = std::numeric_limits<uint64_t>::max();
 };
 
 }
@@ -1,9 +1,297 @@
 
 #include "FileSystem.h"
 #include "Path.h"
+#include "Lock.h"
+#include "CommitBlock.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using namespace TxFs;
 
+namespace
+{
+// Files up to this size are kept in their directory entry
+constexpr size_t MaxInlineFileSize = TreeValue::maxVariableSize();
+
+TreeValue closeWriter(FileWriter& fileWriter)
+{
+    if (fileWriter.isInline())
+        return InlineFile { fileWriter.closeInline() };
+    if (fileWriter.isCompressed())
+        return fileWriter.closeCompressed();
+    return fileWriter.close();
+}
+
+void openReader(FileReader& reader, const TreeValue& file)
+{
+    if (file.getType() == TreeValue::Type::InlineFile)
+        reader.openInline(file.get<InlineFile>().m_data);
+    else if (file.getType() == TreeValue::Type::CompressedFile)
+        reader.openCompressed(file.get<CompressedFile>());
+    else if (file.get<FileDescriptor>() != FileDescriptor())
+        reader.open(file.get<FileDescriptor>());
+}
+
+constexpr uint32_t BatchPages = 256;
+
+// A replication record per commit: the header, then m_runs times a RunHeader followed by the pages of the run
+constexpr uint32_t ReplicationMagic = 0x70527854;
+
+struct ReplicationHeader
+{
+    uint32_t m_magic;
+    PageIndex m_fileSize;
+    uint32_t m_runs;
+};
+
+struct RunHeader
+{
+    PageIndex m_begin;
+    uint32_t m_length;
+};
+
+// A warm-start snapshot: the header, then m_pages times the index and the checksum of a page
+constexpr uint32_t WarmStartMagic = 0x73577854;
+
+struct WarmStartHeader
+{
+    uint32_t m_magic;
+    uint32_t m_pageSize;
+    uint64_t m_generation;
+    uint32_t m_pages;
+};
+
+size_t numberOfThreads(size_t jobs)
+{
+    return std::min(jobs, size_t(std::max(1U, std::thread::hardware_concurrency())));
+}
+
+// The stored pages of a file in steps of at most BatchPages
+std::vector<Interval> storedPages(const std::shared_ptr<CacheManager>& cacheManager, FileDescriptor file)
+{
+    std::vector<Interval> pages;
+    if (file == FileDescriptor())
+        return pages;
+
+    FileReader reader(cacheManager);
+    reader.open(file);
+    for (auto iv = reader.nextInterval(BatchPages); iv.begin() != PageIdx::INVALID; iv = reader.nextInterval(BatchPages))
+        pages.push_back(iv);
+    return pages;
+}
+
+// Runs job(i) for i in [0, count) on up to hardware_concurrency() threads. Idle threads take the next job, so large
+// and small files even out. Stops as soon as a job returns false or throws.
+template <typename TJob>
+bool forEachParallel(size_t count, TJob job)
+{
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> stopped = false;
+    auto worker = [&] {
+        try
+        {
+            for (auto i = next++; i < count && !stopped; i = next++)
+                if (!job(i))
+                    stopped = true;
+        }
+        catch (...)
+        {
+            stopped = true;
+            throw;
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    for (size_t i = 1; i < numberOfThreads(count); i++)
+        workers.push_back(std::async(std::launch::async, worker));
+    worker();
+    for (auto& w: workers)
+        w.get();
+    return !stopped;
+}
+}
+
+/// Pages of equal length in two files. Only the first m_size bytes are file data.
+struct FileSystem::PageBatch
+{
+    Interval m_source;
+    Interval m_dest;
+    size_t m_size;
+};
+
+namespace
+{
+// Pairs the pages of two stored files of the given size into PageBatches of equal length
+void pairPages(const std::vector<Interval>& source, const std::vector<Interval>& dest, uint64_t size,
+               std::vector<FileSystem::PageBatch>& batches)
+{
+    auto sourceIt = source.begin();
+    auto destIt = dest.begin();
+    Interval sourceIv;
+    Interval destIv;
+    while (size > 0)
+    {
+        if (sourceIv.empty())
+            sourceIv = *sourceIt++;
+        if (destIv.empty())
+            destIv = *destIt++;
+        auto length = std::min(sourceIv.length(), destIv.length());
+        auto bytes = std::min(uint64_t(length) * PageSize, size);
+        batches.push_back({ Interval(sourceIv.begin(), sourceIv.begin() + length),
+                            Interval(destIv.begin(), destIv.begin() + length), size_t(bytes) });
+        sourceIv = Interval(sourceIv.begin() + length, sourceIv.end());
+        destIv = Interval(destIv.begin() + length, destIv.end());
+        size -= bytes;
+    }
+}
+
+// Allocates the pages for a copy of a file of another composite. Pages the files can copy directly are copied right
+// away, the others are left as batches for transferPages().
+FileDescriptor allocateCopy(const std::shared_ptr<CacheManager>& source, FileDescriptor file,
+                            const std::shared_ptr<CacheManager>& dest, std::vector<FileSystem::PageBatch>& batches)
+{
+    if (file == FileDescriptor())
+        return file;
+
+    auto sourceFile = source->getFileInterface();
+    auto destFile = dest->getFileInterface();
+    IntervalSequence destPages;
+    for (auto iv: storedPages(source, file))
+    {
+        while (!iv.empty())
+        {
+            auto destIv = dest->allocatePageInterval(iv.length());
+            Interval sourceIv(iv.begin(), iv.begin() + destIv.length());
+            destPages.pushBack(destIv);
+            if (!destFile->copyPages(*sourceFile, sourceIv, destIv.begin()))
+                batches.push_back({ sourceIv, destIv, size_t(destIv.length()) * PageSize });
+            iv = Interval(sourceIv.end(), iv.end());
+        }
+    }
+    return FileWriter(dest).createFrom(std::move(destPages), file.m_fileSize);
+}
+
+// Reads the batches on several threads and writes them on the calling thread, the only one touching dest. At most a
+// few batches per reader are kept in memory.
+void transferPages(const FileInterface* source, FileInterface* dest, const std::vector<FileSystem::PageBatch>& batches)
+{
+    struct Pipeline
+    {
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::deque<std::pair<size_t, std::vector<uint8_t>>> m_readBatches;
+        std::atomic<size_t> m_next = 0;
+        bool m_stopped = false;
+
+        void stop()
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stopped = true;
+            }
+            m_changed.notify_all();
+        }
+    } pipeline;
+
+    auto numReaders = numberOfThreads(batches.size());
+    auto reader = [&] {
+        try
+        {
+            for (auto i = pipeline.m_next++; i < batches.size(); i = pipeline.m_next++)
+            {
+                std::vector<uint8_t> buffer(size_t(batches[i].m_source.length()) * PageSize);
+                source->readPages(batches[i].m_source, buffer.data());
+
+                std::unique_lock lock(pipeline.m_mutex);
+                pipeline.m_changed.wait(lock, [&] {
+                    return pipeline.m_readBatches.size() < 2 * numReaders || pipeline.m_stopped;
+                });
+                if (pipeline.m_stopped)
+                    return;
+                pipeline.m_readBatches.emplace_back(i, std::move(buffer));
+                lock.unlock();
+                pipeline.m_changed.notify_all();
+            }
+        }
+        catch (...)
+        {
+            pipeline.stop();
+            throw;
+        }
+    };
+
+    std::vector<std::future<void>> readers;
+    for (size_t i = 0; i < numReaders; i++)
+        readers.push_back(std::async(std::launch::async, reader));
+
+    // wakes up waiting readers if writing fails
+    struct StopOnExit
+    {
+        Pipeline& m_pipeline;
+        ~StopOnExit() { m_pipeline.stop(); }
+    } stopOnExit { pipeline };
+
+    for (size_t written = 0; written < batches.size(); written++)
+    {
+        std::unique_lock lock(pipeline.m_mutex);
+        pipeline.m_changed.wait(lock, [&] { return !pipeline.m_readBatches.empty() || pipeline.m_stopped; });
+        if (pipeline.m_readBatches.empty())
+            break; // a reader failed
+        auto [i, buffer] = std::move(pipeline.m_readBatches.front());
+        pipeline.m_readBatches.pop_front();
+        lock.unlock();
+        pipeline.m_changed.notify_all();
+        dest->writePages(batches[i].m_dest, buffer.data());
+    }
+
+    for (auto& r: readers)
+        r.get();
+}
+
+// Compares the batches on several threads
+bool comparePages(const FileInterface* source, const FileInterface* dest, const std::vector<FileSystem::PageBatch>& batches)
+{
+    return forEachParallel(batches.size(), [&](size_t i) {
+        std::vector<uint8_t> buffer(size_t(batches[i].m_source.length()) * PageSize * 2);
+        auto middle = source->readPages(batches[i].m_source, buffer.data());
+        dest->readPages(batches[i].m_dest, middle);
+        return std::equal(buffer.data(), buffer.data() + batches[i].m_size, middle);
+    });
+}
+
+// Compares two files by reading them through FileReaders, for files that are stored differently
+bool compareContents(const std::shared_ptr<CacheManager>& cacheManager, const TreeValue& file,
+                     const std::shared_ptr<CacheManager>& otherCacheManager, const TreeValue& otherFile)
+{
+    FileReader reader(cacheManager);
+    FileReader otherReader(otherCacheManager);
+    openReader(reader, file);
+    openReader(otherReader, otherFile);
+    if (reader.size() != otherReader.size())
+        return false;
+
+    std::vector<uint8_t> buffer(2 * size_t(BatchPages) * PageSize);
+    auto middle = buffer.data() + buffer.size() / 2;
+    for (;;)
+    {
+        auto end = reader.read(buffer.data(), middle);
+        auto otherEnd = otherReader.read(middle, buffer.data() + buffer.size());
+        if (end - buffer.data() != otherEnd - middle || !std::equal(buffer.data(), end, middle))
+            return false;
+        if (end == buffer.data())
+            return true;
+    }
+}
+}
+
 struct FileSystem::RollbackOnException
 {
     FileSystem& m_fileSystem;
@@ -21,7 +309,7 @@ struct FileSystem::RollbackOnException
         {
             try
             {
-                m_fileSystem.rollback();
+                m_fileSystem.rollbackTransaction();
             }
             catch (...)
             {
@@ -35,8 +323,35 @@ FileSystem::FileSystem(const Startup& startup)
     , m_directoryStructure(startup)
 {}
 
-std::optional<WriteHandle> FileSystem::createFile(Path path)
+/// A commit of commitAsync() that is still running is finished first. Its outcome can't be reported to the caller
+/// any more: if it failed, the transaction is lost and the exception goes to the CommitErrorHandler. Call
+/// waitForCommit() before to have it thrown instead.
+FileSystem::~FileSystem()
 {
+    finishCommitOnDestruction();
+}
+
+FileSystem& FileSystem::operator=(FileSystem&& other)
+{
+    if (this == &other)
+        return *this;
+
+    finishCommitOnDestruction();
+    m_cacheManager = std::move(other.m_cacheManager);
+    m_directoryStructure = std::move(other.m_directoryStructure);
+    m_openReaders = std::move(other.m_openReaders);
+    m_openWriters = std::move(other.m_openWriters);
+    m_nextHandle = other.m_nextHandle;
+    m_pageChecksums = other.m_pageChecksums;
+    m_deduplication = other.m_deduplication;
+    m_replicationSink = std::move(other.m_replicationSink);
+    m_commitErrorHandler = std::move(other.m_commitErrorHandler);
+    return *this;
+}
+
+std::optional<WriteHandle> FileSystem::createFile(Path path, Compression compression)
+{
+    pollCommit();
     RollbackOnException guard(*this);
 
     if (!path.create(&m_directoryStructure))
@@ -45,60 +360,97 @@ std::optional<WriteHandle> FileSystem::createFile(Path path)
     if (!m_directoryStructure.createFile(DirectoryKey(path.m_parentFolder, path.m_relativePath)))
         return std::nullopt;
 
-    addOpenWriter(path);
+    auto& fileWriter = addOpenWriter(path);
+    if (compression == Compression::Lz4)
+        fileWriter.openCompressed(CompressedFile {});
+    else
+        fileWriter.openInline({}, MaxInlineFileSize);
+    if (m_pageChecksums)
+        fileWriter.enablePageChecksums({});
+    if (m_deduplication)
+        fileWriter.enableDeduplication(m_directoryStructure.chunkIndex());
     return WriteHandle { m_nextHandle++ };
 }
 
 std::optional<WriteHandle> FileSystem::appendFile(Path path)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
     if (!path.create(&m_directoryStructure))
         return std::nullopt;
 
-    auto fileDescriptor = m_directoryStructure.appendFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+    auto file = m_directoryStructure.appendFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
 
-    if (!fileDescriptor)
+    if (!file)
         return std::nullopt;
 
     auto& fileWriter = addOpenWriter(path);
-    if (*fileDescriptor != FileDescriptor())
-        fileWriter.openAppend(*fileDescriptor);
+    if (file->getType() == TreeValue::Type::InlineFile)
+        fileWriter.openInline(file->get<InlineFile>().m_data, MaxInlineFileSize);
+    else if (file->getType() == TreeValue::Type::CompressedFile)
+        fileWriter.openCompressed(file->get<CompressedFile>());
+    else if (file->get<FileDescriptor>() != FileDescriptor())
+        fileWriter.openAppend(file->get<FileDescriptor>());
+    else
+        fileWriter.openInline({}, MaxInlineFileSize);
+
+    // a partially filled last page shared with a clone must not change
+    auto partialPage = fileWriter.partialLastPage();
+    if (partialPage != PageIdx::INVALID && m_directoryStructure.unsharePage(partialPage))
+        fileWriter.relocateLastPage();
+
+    // files without checksums only get them if they have no pages yet
+    if (auto checksums = m_directoryStructure.pageChecksums(*file))
+        fileWriter.enablePageChecksums(std::move(*checksums));
+    else if (m_pageChecksums && (fileWriter.isInline() || fileWriter.size() == 0))
+        fileWriter.enablePageChecksums({});
+    if (m_deduplication && (fileWriter.isInline() || fileWriter.size() == 0))
+        fileWriter.enableDeduplication(m_directoryStructure.chunkIndex());
     return WriteHandle { m_nextHandle++ };
 }
 
 std::optional<ReadHandle> FileSystem::readFile(Path path)
 {
+    pollCommit();
     if (!path.normalize(&m_directoryStructure))
         return std::nullopt;
 
-    auto fileDescriptor = m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+    auto file = m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
 
-    if (!fileDescriptor)
+    if (!file)
         return std::nullopt;
 
     auto res = m_openReaders.try_emplace(ReadHandle { m_nextHandle }, FileReader { m_cacheManager });
     assert(res.second);
-    if (*fileDescriptor != FileDescriptor())
-        res.first->second.open(*fileDescriptor);
+    openReader(res.first->second, *file);
+
+    if (auto checksums = m_directoryStructure.pageChecksums(*file))
+        res.first->second.setPageChecksums(std::move(*checksums));
     return ReadHandle { m_nextHandle++ };
 }
 
 std::optional<uint64_t> FileSystem::fileSize(Path path) const
 {
+    pollCommit();
     if (!path.normalize(&m_directoryStructure))
         return std::nullopt;
 
-    auto fileDescriptor = m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+    auto file = m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
 
-    if (!fileDescriptor)
+    if (!file)
         return std::nullopt;
 
-    return fileDescriptor->m_fileSize;
+    if (file->getType() == TreeValue::Type::InlineFile)
+        return file->get<InlineFile>().m_data.size();
+    if (file->getType() == TreeValue::Type::CompressedFile)
+        return file->get<CompressedFile>().m_fileSize;
+    return file->get<FileDescriptor>().m_fileSize;
 }
 
 size_t FileSystem::read(ReadHandle file, void* ptr, size_t size)
 {
+    pollCommit();
     uint8_t* begin = (uint8_t*) ptr;
     uint8_t* end = begin + size;
     auto cur = m_openReaders.at(file).read(begin, end);
@@ -107,6 +459,7 @@ size_t FileSystem::read(ReadHandle file, void* ptr, size_t size)
 
 size_t FileSystem::write(WriteHandle file, const void* ptr, size_t size)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
     const uint8_t* begin = (const uint8_t*) ptr;
@@ -117,35 +470,37 @@ size_t FileSystem::write(WriteHandle file, const void* ptr, size_t size)
 
 void FileSystem::close(WriteHandle file)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
-    auto& openFile = m_openWriters.at(file);
-    auto fileDescriptor = openFile.m_fileWriter.close();
-    Path path = openFile.m_path;
-    m_directoryStructure.updateFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), fileDescriptor);
+    closeOpenWriter(m_openWriters.at(file));
     m_openWriters.erase(file);
 }
 
 void FileSystem::close(ReadHandle file)
 {
+    pollCommit();
     [[maybe_unused]] auto res = m_openReaders.at(file); // throws if non-existant
     m_openReaders.erase(file);
 }
 
 uint64_t FileSystem::fileSize(WriteHandle file) const
 {
+    pollCommit();
     const auto& openFile = m_openWriters.at(file);
     return openFile.m_fileWriter.size();
 }
 
 uint64_t FileSystem::fileSize(ReadHandle file) const
 {
+    pollCommit();
     const auto& openFile = m_openReaders.at(file);
     return openFile.size();
 }
 
 std::optional<Folder> FileSystem::makeSubFolder(Path path)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
     if (!path.create(&m_directoryStructure))
@@ -156,6 +511,7 @@ std::optional<Folder> FileSystem::makeSubFolder(Path path)
 
 std::optional<Folder> FileSystem::subFolder(Path path) const
 {
+    pollCommit();
     if (!path.normalize(&m_directoryStructure))
         return std::nullopt;
 
@@ -164,6 +520,7 @@ std::optional<Folder> FileSystem::subFolder(Path path) const
 
 bool FileSystem::addAttribute(Path path, const TreeValue& attribute)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
     if (!path.create(&m_directoryStructure))
@@ -174,6 +531,7 @@ bool FileSystem::addAttribute(Path path, const TreeValue& attribute)
 
 std::optional<TreeValue> FileSystem::getAttribute(Path path) const
 {
+    pollCommit();
     if (!path.normalize(&m_directoryStructure))
         return std::nullopt;
 
@@ -182,6 +540,7 @@ std::optional<TreeValue> FileSystem::getAttribute(Path path) const
 
 bool FileSystem::rename(Path oldPath, Path newPath)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
     if (!oldPath.normalize(&m_directoryStructure))
@@ -197,6 +556,7 @@ bool FileSystem::rename(Path oldPath, Path newPath)
 
 size_t FileSystem::remove(Path path)
 {
+    pollCommit();
     RollbackOnException guard(*this);
 
     if (!path.normalize(&m_directoryStructure))
@@ -205,16 +565,130 @@ size_t FileSystem::remove(Path path)
     return m_directoryStructure.remove(DirectoryKey(path.m_parentFolder, path.m_relativePath));
 }
 
+/// Copies source to dest without copying file data: the copies share their pages with the source. Folders are cloned
+/// with all their contents. Returns the number of cloned entries.
+size_t FileSystem::clone(Path source, Path dest)
+{
+    pollCommit();
+    RollbackOnException guard(*this);
+
+    if (!source.normalize(&m_directoryStructure))
+        return 0;
+
+    if (!dest.create(&m_directoryStructure))
+        return 0;
+    DirectoryKey destKey(dest.m_parentFolder, dest.m_relativePath);
+
+    if (source.m_relativePath.empty())
+        return m_directoryStructure.cloneFolder(source.m_parentFolder, destKey);
+    return m_directoryStructure.clone(DirectoryKey(source.m_parentFolder, source.m_relativePath), destKey);
+}
+
+/// Copies a file from another FileSystem page by page without decoding it, so compressed files stay compressed. Page
+/// checksums are copied along. Within one FileSystem the file is cloned.
+bool FileSystem::copyFile(const FileSystem& sourceFs, Path sourcePath, Path destPath)
+{
+    return copyFiles(sourceFs, { { PathHolder(sourcePath), PathHolder(destPath) } }) == 1;
+}
+
+/// Batched copyFile(): the directory entries are created on the calling thread, the file data is read by several
+/// threads at once. Returns the number of copied files.
+size_t FileSystem::copyFiles(const FileSystem& sourceFs, const FilePairs& files)
+{
+    pollCommit();
+    sourceFs.pollCommit();
+    RollbackOnException guard(*this);
+
+    size_t copied = 0;
+    std::vector<PageBatch> batches;
+    for (const auto& [sourcePath, destPath]: files)
+        if (&sourceFs == this ? clone(sourcePath, destPath) == 1 : allocateCopy(sourceFs, sourcePath, destPath, batches))
+            copied++;
+
+    transferPages(sourceFs.m_cacheManager->getFileInterface(), m_cacheManager->getFileInterface(), batches);
+    return copied;
+}
+
+/// Compares the contents of files of this and another FileSystem pairwise. Files stored the same way are compared
+/// page by page on several threads. Returns false if any file is missing or differs.
+bool FileSystem::compareFiles(const FileSystem& otherFs, const FilePairs& files) const
+{
+    pollCommit();
+    otherFs.pollCommit();
+    std::vector<PageBatch> batches;
+    for (const auto& [path, otherPath]: files)
+    {
+        auto file = openFile(path);
+        auto otherFile = otherFs.openFile(otherPath);
+        if (!file || !otherFile)
+            return false;
+
+        if (file->getType() != TreeValue::Type::File || otherFile->getType() != TreeValue::Type::File)
+        {
+            if (!compareContents(m_cacheManager, *file, otherFs.m_cacheManager, *otherFile))
+                return false;
+            continue;
+        }
+
+        auto fd = file->get<FileDescriptor>();
+        auto otherFd = otherFile->get<FileDescriptor>();
+        if (fd.m_fileSize != otherFd.m_fileSize)
+            return false;
+        pairPages(storedPages(m_cacheManager, fd), storedPages(otherFs.m_cacheManager, otherFd), fd.m_fileSize, batches);
+    }
+
+    return comparePages(m_cacheManager->getFileInterface(), otherFs.m_cacheManager->getFileInterface(), batches);
+}
+
 FileSystem::Cursor FileSystem::find(Path path) const
 {
+    pollCommit();
     if (!path.normalize(&m_directoryStructure))
         return Cursor();
 
     return m_directoryStructure.find(DirectoryKey(path.m_parentFolder, path.m_relativePath));
 }
 
+/// Batched find(): resolves all paths in one walk of the directory tree. Paths sharing their parent directory with
+/// the previous path reuse its resolved Folder. The Cursors are returned in the order of the input.
+std::vector<FileSystem::Cursor> FileSystem::stat(const std::vector<Path>& paths) const
+{
+    pollCommit();
+    std::vector<DirectoryKey> keys;
+    std::vector<size_t> positions;
+    keys.reserve(paths.size());
+    positions.reserve(paths.size());
+
+    Path lastDir(Folder::Root, "");
+    std::optional<Folder> lastFolder = Folder::Root;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        auto pos = paths[i].m_relativePath.rfind('/');
+        auto name = pos == std::string_view::npos ? paths[i].m_relativePath : paths[i].m_relativePath.substr(pos + 1);
+        Path dir(paths[i].m_parentFolder, paths[i].m_relativePath.substr(0, pos == std::string_view::npos ? 0 : pos + 1));
+        if (dir != lastDir)
+        {
+            lastDir = dir;
+            lastFolder = dir.normalize(&m_directoryStructure) ? std::optional<Folder>(dir.m_parentFolder) : std::nullopt;
+        }
+
+        if (!lastFolder)
+            continue;
+
+        keys.emplace_back(*lastFolder, name);
+        positions.push_back(i);
+    }
+
+    auto found = m_directoryStructure.findMany(keys);
+    std::vector<Cursor> cursors(paths.size());
+    for (size_t i = 0; i < found.size(); i++)
+        cursors[positions[i]] = found[i];
+    return cursors;
+}
+
 FileSystem::Cursor FileSystem::begin(Path path) const
 {
+    pollCommit();
     if (!path.normalize(&m_directoryStructure))
         return Cursor();
 
@@ -222,36 +696,345 @@ FileSystem::Cursor FileSystem::begin(Path path) const
 }
 
 void FileSystem::commit()
+{
+    waitForCommit();
+    commitTransaction();
+}
+
+/// Commits on a background thread while the next transaction already goes on: the pages of the transaction are
+/// frozen and written and flushed by the background thread, see CacheManager::commitAsync(). Reads, writes and
+/// directory changes of the next transaction don't wait for it; commit(), rollback() and the calls that need the
+/// committed file do, and so does the next transaction once it has used the pages reserved for it. If the commit
+/// failed the exception is thrown by the call that finds out, and both transactions are rolled back. With
+/// replication enabled the commit is synchronous.
+void FileSystem::commitAsync()
+{
+    waitForCommit();
+    if (m_replicationSink)
+    {
+        commitTransaction();
+        return;
+    }
+
+    RollbackOnException guard(*this);
+    closeAllFiles();
+    m_directoryStructure.commitAsync();
+}
+
+/// Waits for the commit of commitAsync() and throws its exception, if there was one.
+void FileSystem::waitForCommit() const
+{
+    if (m_cacheManager && m_cacheManager->commitPending())
+        const_cast<FileSystem*>(this)->finishCommit();
+    pollCommit();
+}
+
+/// Called first by every public method: picks up the commit of commitAsync() if it is done and, as no page is in use
+/// between calls, serves a request of a shared CachePool to give pages back.
+void FileSystem::pollCommit() const
+{
+    if (!m_cacheManager)
+        return;
+    if (m_cacheManager->commitFinished())
+        const_cast<FileSystem*>(this)->finishCommit();
+    m_cacheManager->checkCachePool();
+}
+
+void FileSystem::finishCommit()
+{
+    RollbackOnException guard(*this);
+    m_cacheManager->finishCommit();
+}
+
+void FileSystem::finishCommitOnDestruction() noexcept
+{
+    if (!m_cacheManager || !m_cacheManager->commitPending())
+        return;
+
+    try
+    {
+        m_cacheManager->finishCommit();
+    }
+    catch (...)
+    {
+        if (m_commitErrorHandler)
+            m_commitErrorHandler(std::current_exception());
+    }
+}
+
+void FileSystem::commitTransaction()
 {
     RollbackOnException guard(*this);
 
     closeAllFiles();
     m_directoryStructure.commit();
+    if (m_replicationSink)
+        writeReplicationStream();
 }
 
 void FileSystem::rollback()
 {
+    waitForCommit();
+    rollbackTransaction();
+}
+
+void FileSystem::rollbackTransaction()
+{
+    try
+    {
+        m_cacheManager->finishCommit();
+    }
+    catch (...)
+    {
+    }
     closeAllFiles();
     m_directoryStructure.rollback();
 }
 
 void FileSystem::init()
 {
+    waitForCommit();
     m_directoryStructure.init();
 }
 
 void FileSystem::closeAllFiles()
 {
     for (auto& [key, openFile]: m_openWriters)
-    {
-        auto fileDescriptor = openFile.m_fileWriter.close();
-        Path path = openFile.m_path;
-        m_directoryStructure.updateFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), fileDescriptor);
-    }
+        closeOpenWriter(openFile);
     m_openWriters.clear();
     m_openReaders.clear();
 }
 
+/// Verifies all file data that was written with page checksums enabled. Data pages are hashed in parallel.
+FileSystem::ScrubResult FileSystem::scrub() const
+{
+    waitForCommit();
+    return m_directoryStructure.scrub();
+}
+
+std::optional<TreeValue> FileSystem::openFile(Path path) const
+{
+    if (!path.normalize(&m_directoryStructure))
+        return std::nullopt;
+
+    return m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+}
+
+// Creates dest as a copy of sourcePath and adds the file data that still has to be transferred to batches
+bool FileSystem::allocateCopy(const FileSystem& sourceFs, Path sourcePath, Path destPath, std::vector<PageBatch>& batches)
+{
+    auto file = sourceFs.openFile(sourcePath);
+    if (!file)
+        return false;
+
+    if (!destPath.create(&m_directoryStructure))
+        return false;
+
+    DirectoryKey destKey(destPath.m_parentFolder, destPath.m_relativePath);
+    if (!m_directoryStructure.createFile(destKey))
+        return false;
+
+    auto copy = *file;
+    if (file->getType() == TreeValue::Type::File)
+        copy = ::allocateCopy(sourceFs.m_cacheManager, file->get<FileDescriptor>(), m_cacheManager, batches);
+    else if (file->getType() == TreeValue::Type::CompressedFile)
+        copy = CompressedFile { ::allocateCopy(sourceFs.m_cacheManager, file->get<CompressedFile>().m_descriptor,
+                                               m_cacheManager, batches),
+                                file->get<CompressedFile>().m_fileSize };
+
+    m_directoryStructure.updateFile(destKey, copy);
+    if (auto checksums = sourceFs.m_directoryStructure.pageChecksums(*file))
+        m_directoryStructure.storePageChecksums(copy, *checksums);
+    return true;
+}
+
+/// Copies the committed composite to dest, an empty file, in runs of pages in use. Pages in the FreeStore are
+/// skipped; their place in dest is left as is. The copy only needs the read lock this FileSystem holds anyway, so
+/// a FileSystem opened read-only can back up a composite that is written to. Only the committed size of the file is
+/// copied: pages a concurrent writer added since, including its log pages, are left out. Call it with no changes
+/// pending.
+/// TxFs::copy() into a new composite gives a compact copy instead. Returns the number of copied pages.
+size_t FileSystem::backupTo(FileInterface& dest) const
+{
+    waitForCommit();
+    auto source = m_cacheManager->getFileInterface();
+    auto fileSize = PageIndex(m_directoryStructure.retrieveCommitBlock().m_compositSize);
+    assert(fileSize <= source->fileSizeInPages());
+    while (dest.fileSizeInPages() < fileSize)
+        dest.newInterval(fileSize - dest.fileSizeInPages());
+
+    size_t copied = 0;
+    std::vector<PageBatch> batches;
+    auto addPages = [&](Interval iv) {
+        copied += iv.length();
+        while (!iv.empty())
+        {
+            Interval batch(iv.begin(), iv.begin() + std::min(iv.length(), BatchPages));
+            if (!dest.copyPages(*source, batch, batch.begin()))
+                batches.push_back({ batch, batch, size_t(batch.length()) * PageSize });
+            iv = Interval(batch.end(), iv.end());
+        }
+    };
+
+    PageIndex next = 0;
+    for (auto free: m_directoryStructure.freePages())
+    {
+        auto end = std::min(free.begin(), fileSize);
+        if (end > next)
+            addPages(Interval(next, end));
+        next = std::max(next, free.end());
+    }
+    if (next < fileSize)
+        addPages(Interval(next, fileSize));
+
+    transferPages(source, &dest, batches);
+    dest.flushFile();
+    return copied;
+}
+
+/// Passes the pages written by every following commit to sink, so applyReplicationStream() can bring a copy of the
+/// file up to date. Enable it while no changes are pending. An empty sink disables replication.
+void FileSystem::enableReplication(ReplicationSink sink)
+{
+    waitForCommit();
+    m_replicationSink = std::move(sink);
+    m_cacheManager->trackWrittenPages(bool(m_replicationSink));
+    m_cacheManager->takeWrittenPages();
+}
+
+/// Writes the records produced by enableReplication() to replica, which has to be a byte copy of the replicated file
+/// as of the first record. The replica is held under its commit lock meanwhile. Unlike a commit, applying is not
+/// crash safe: a replica that was interrupted has to be copied anew.
+void FileSystem::applyReplicationStream(FileInterface& replica, const uint8_t* begin, const uint8_t* end)
+{
+    auto read = [&](auto& value) {
+        if (size_t(end - begin) < sizeof(value))
+            throw std::runtime_error("FileSystem: truncated replication stream");
+        std::memcpy(&value, begin, sizeof(value));
+        begin += sizeof(value);
+    };
+
+    auto commitLock = replica.commitAccess(replica.writeAccess());
+    while (begin != end)
+    {
+        ReplicationHeader header;
+        read(header);
+        if (header.m_magic != ReplicationMagic)
+            throw std::runtime_error("FileSystem: corrupt replication stream");
+
+        while (replica.fileSizeInPages() < header.m_fileSize)
+            replica.newInterval(header.m_fileSize - replica.fileSizeInPages());
+        for (uint32_t i = 0; i < header.m_runs; i++)
+        {
+            RunHeader run;
+            read(run);
+            if (size_t(end - begin) < size_t(run.m_length) * PageSize)
+                throw std::runtime_error("FileSystem: truncated replication stream");
+            if (uint64_t(run.m_begin) + run.m_length > header.m_fileSize)
+                throw std::runtime_error("FileSystem: corrupt replication stream");
+            begin = replica.writePages(Interval(run.m_begin, run.m_begin + run.m_length), begin);
+        }
+        replica.truncate(header.m_fileSize);
+        replica.flushFile();
+    }
+}
+
+// Emits the pages of the last commit as one replication record
+void FileSystem::writeReplicationStream()
+{
+    auto file = m_cacheManager->getFileInterface();
+    auto fileSize = PageIndex(file->fileSizeInPages());
+    std::vector<Interval> runs;
+    for (auto iv: m_cacheManager->takeWrittenPages())
+        if (iv.begin() < fileSize)
+            runs.emplace_back(iv.begin(), std::min(iv.end(), fileSize));
+
+    auto emit = [this](const auto& value) {
+        auto data = reinterpret_cast<const uint8_t*>(&value);
+        m_replicationSink(data, data + sizeof(value));
+    };
+    emit(ReplicationHeader { ReplicationMagic, fileSize, uint32_t(runs.size()) });
+
+    std::vector<uint8_t> buffer;
+    for (auto run: runs)
+    {
+        emit(RunHeader { run.begin(), run.length() });
+        for (auto iv = run; !iv.empty();)
+        {
+            Interval batch(iv.begin(), iv.begin() + std::min(iv.length(), BatchPages));
+            buffer.resize(size_t(batch.length()) * PageSize);
+            file->readPages(batch, buffer.data());
+            m_replicationSink(buffer.data(), buffer.data() + buffer.size());
+            iv = Interval(batch.end(), iv.end());
+        }
+    }
+}
+
+/// Records the pages loaded most often since the last commit while trackHotPages() is enabled. The pages of the
+/// FreeStore are left out, they are reused for new contents. Take the snapshot with no changes pending, e.g. right
+/// before the composite is closed, and hand it to warmStart() after it is opened again.
+std::string FileSystem::warmStartSnapshot(size_t maxPages) const
+{
+    waitForCommit();
+    auto pages = m_cacheManager->hotPages(maxPages, m_directoryStructure.freeStorePages());
+    WarmStartHeader header { WarmStartMagic, uint32_t(PageSize), commitGeneration(), uint32_t(pages.size()) };
+
+    std::string snapshot(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto page: pages)
+    {
+        snapshot.append(reinterpret_cast<const char*>(&page.first), sizeof(page.first));
+        snapshot.append(reinterpret_cast<const char*>(&page.second), sizeof(page.second));
+    }
+    return snapshot;
+}
+
+/// Prefetches the pages of a warmStartSnapshot() into the cache. A snapshot of another commit than the current one
+/// is ignored and so are pages whose contents changed. Call it before the first transaction. Returns the number of
+/// prefetched pages.
+size_t FileSystem::warmStart(std::string_view snapshot)
+{
+    waitForCommit();
+    WarmStartHeader header;
+    if (snapshot.size() < sizeof(header))
+        return 0;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    constexpr size_t entrySize = sizeof(PageIndex) + sizeof(uint32_t);
+    if (header.m_magic != WarmStartMagic || header.m_pageSize != PageSize ||
+        snapshot.size() != sizeof(header) + header.m_pages * entrySize)
+        throw std::runtime_error("FileSystem: corrupt warm-start snapshot");
+    if (header.m_generation != commitGeneration())
+        return 0;
+
+    std::vector<std::pair<PageIndex, uint32_t>> pages(header.m_pages);
+    auto pos = snapshot.data() + sizeof(header);
+    for (auto& page: pages)
+    {
+        std::memcpy(&page.first, pos, sizeof(page.first));
+        std::memcpy(&page.second, pos + sizeof(page.first), sizeof(page.second));
+        pos += entrySize;
+    }
+    return m_cacheManager->prefetch(std::move(pages));
+}
+
+// The committed state is identified by the commit block: every commit that frees or reuses pages changes it
+uint64_t FileSystem::commitGeneration() const
+{
+    auto commitBlock = m_directoryStructure.retrieveCommitBlock().toString();
+    return hash64(commitBlock.data(), commitBlock.size());
+}
+
+void FileSystem::closeOpenWriter(OpenWriter& openWriter)
+{
+    auto closedFile = closeWriter(openWriter.m_fileWriter);
+    auto checksums = openWriter.m_fileWriter.takePageChecksums();
+    // mark before updateFile(): it deletes the file if it was removed in the meantime
+    if (openWriter.m_fileWriter.hasSharedPages())
+        m_directoryStructure.markShared(closedFile);
+    Path path = openWriter.m_path;
+    if (m_directoryStructure.updateFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), closedFile) && checksums)
+        m_directoryStructure.storePageChecksums(closedFile, *checksums);
+}
+
 FileWriter& TxFs::FileSystem::addOpenWriter(Path path)
 {
     RollbackOnException guard(*this);
@@ -4,6 +4,8 @@
 #include "FileReader.h"
 #include "FileWriter.h"
 #include "Path.h"
+#include <functional>
+#include <exception>
 
 namespace TxFs
 {
@@ -17,15 +19,23 @@ class FileSystem final
 public:
     class Cursor;
     using Startup = DirectoryStructure::Startup;
+    using ScrubResult = DirectoryStructure::ScrubResult;
     struct RollbackOnException;
+    struct PageBatch;
+    using FilePairs = std::vector<std::pair<PathHolder, PathHolder>>;
+    using ReplicationSink = std::function<void(const uint8_t* begin, const uint8_t* end)>;
+    using CommitErrorHandler = std::function<void(std::exception_ptr)>;
 
 public:
     FileSystem(const Startup& startup);
+    FileSystem(FileSystem&&) = default;
+    FileSystem& operator=(FileSystem&&);
+    ~FileSystem();
 
     static Startup initialize(const std::shared_ptr<CacheManager>& cacheManager);
     void init();
 
-    std::optional<WriteHandle> createFile(Path path);
+    std::optional<WriteHandle> createFile(Path path, Compression compression = Compression::None);
     std::optional<WriteHandle> appendFile(Path path);
     std::optional<ReadHandle> readFile(Path path);
     std::optional<uint64_t> fileSize(Path path) const;
@@ -46,20 +56,47 @@ public:
 
     bool rename(Path oldPath, Path newPath);
     size_t remove(Path path);
+    size_t clone(Path source, Path dest);
+    bool copyFile(const FileSystem& sourceFs, Path sourcePath, Path destPath);
+    size_t copyFiles(const FileSystem& sourceFs, const FilePairs& files);
+    bool compareFiles(const FileSystem& otherFs, const FilePairs& files) const;
 
     Cursor find(Path path) const;
+    std::vector<Cursor> stat(const std::vector<Path>& paths) const;
     Cursor begin(Path path) const;
     Cursor next(Cursor cursor) const;
 
     void commit();
+    void commitAsync();
+    void waitForCommit() const;
+    void setCommitErrorHandler(CommitErrorHandler handler) { m_commitErrorHandler = std::move(handler); }
     void rollback();
 
+    void enablePageChecksums(bool enable) { pollCommit(); m_pageChecksums = enable; }
+    void enableDeduplication(bool enable) { pollCommit(); m_deduplication = enable; }
+    ScrubResult scrub() const;
+    size_t backupTo(FileInterface& dest) const;
+    const Statistics& statistics() const;
+    void resetStatistics();
+    void setCacheBudget(const CacheBudget& budget);
+    void releaseMemory();
+    void setCommitProtocol(CommitProtocol protocol);
+
+    void trackHotPages(bool enable) { pollCommit(); m_cacheManager->trackPageLoads(enable); }
+    std::string warmStartSnapshot(size_t maxPages = 1024) const;
+    size_t warmStart(std::string_view snapshot);
+
+    void enableReplication(ReplicationSink sink);
+    static void applyReplicationStream(FileInterface& replica, const uint8_t* begin, const uint8_t* end);
+
     bool reducePath(Path& p) const;
     bool createPath(Path& p);
 
 private:
     void closeAllFiles();
     FileWriter& addOpenWriter(Path path);
+    std::optional<TreeValue> openFile(Path path) const;
+    bool allocateCopy(const FileSystem& sourceFs, Path sourcePath, Path destPath, std::vector<PageBatch>& batches);
 
 private:
     struct OpenWriter
@@ -68,11 +105,24 @@ private:
         FileWriter m_fileWriter;
     };
 
+    void closeOpenWriter(OpenWriter& openWriter);
+    void pollCommit() const;
+    void finishCommit();
+    void finishCommitOnDestruction() noexcept;
+    void commitTransaction();
+    void rollbackTransaction();
+    void writeReplicationStream();
+    uint64_t commitGeneration() const;
+
     std::shared_ptr<CacheManager> m_cacheManager;
     DirectoryStructure m_directoryStructure;
     std::unordered_map<ReadHandle, FileReader> m_openReaders;
     std::unordered_map<WriteHandle, OpenWriter> m_openWriters;
     uint32_t m_nextHandle = 1;
+    bool m_pageChecksums = false;
+    bool m_deduplication = false;
+    ReplicationSink m_replicationSink;
+    CommitErrorHandler m_commitErrorHandler;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -108,9 +158,40 @@ inline Path FileSystem::Cursor::key() const
 
 inline FileSystem::Cursor FileSystem::next(Cursor cursor) const
 {
+    pollCommit();
     return m_directoryStructure.next(cursor.m_cursor);
 }
 
+inline const Statistics& FileSystem::statistics() const
+{
+    waitForCommit();
+    return m_cacheManager->statistics();
+}
+
+inline void FileSystem::resetStatistics()
+{
+    waitForCommit();
+    m_cacheManager->resetStatistics();
+}
+
+inline void FileSystem::setCacheBudget(const CacheBudget& budget)
+{
+    pollCommit();
+    m_cacheManager->setCacheBudget(budget);
+}
+
+inline void FileSystem::releaseMemory()
+{
+    waitForCommit();
+    m_cacheManager->releaseMemory();
+}
+
+inline void FileSystem::setCommitProtocol(CommitProtocol protocol)
+{
+    waitForCommit();
+    m_cacheManager->setCommitProtocol(protocol);
+}
+
 inline FileSystem::Startup FileSystem::initialize(const std::shared_ptr<CacheManager>& cacheManager)
 {
     return DirectoryStructure::initialize(cacheManager);
@@ -118,11 +199,13 @@ inline FileSystem::Startup FileSystem::initialize(const std::shared_ptr<CacheMan
 
 inline bool FileSystem::reducePath(Path& path) const
 {
+    pollCommit();
     return path.normalize(&m_directoryStructure);
 }
 
 inline bool FileSystem::createPath(Path& path)
 {
+    pollCommit();
     return path.create(&m_directoryStructure);
 }
 
@@ -2,6 +2,7 @@
 #include "FileSystemHelper.h"
 #include "FileSystem.h"
 #include "Path.h"
+#include <algorithm>
 #include <vector>
 
 using namespace TxFs;
@@ -10,14 +11,14 @@ namespace
 {
 struct CopyProcessor
 {
+    static constexpr size_t MaxFiles = 1024;
     FileSystem& m_sourceFs;
     FileSystem& m_destFs;
-    std::vector<char> m_buffer;
+    FileSystem::FilePairs m_files;
 
     CopyProcessor(FileSystem& sourceFs, FileSystem& destFs)
         : m_sourceFs(sourceFs)
         , m_destFs(destFs)
-        , m_buffer(4096L * 32)
     {
     }
 
@@ -25,7 +26,9 @@ struct CopyProcessor
     {
         switch (sourceCursor.value().getType())
         {
-        case TreeValue::Type::File: {
+        case TreeValue::Type::File:
+        case TreeValue::Type::InlineFile:
+        case TreeValue::Type::CompressedFile: {
             return copyFile(sourceCursor.key(), destPath);
         }
         case TreeValue::Type::Folder: {
@@ -43,7 +46,9 @@ struct CopyProcessor
         Path destPath(destFolder, Path(entry.m_key).m_relativePath);
         switch (entry.m_value.getType())
         {
-        case TreeValue::Type::File: {
+        case TreeValue::Type::File:
+        case TreeValue::Type::InlineFile:
+        case TreeValue::Type::CompressedFile: {
             return copyFile(entry.m_key, destPath);
         }
         case TreeValue::Type::Folder: {
@@ -56,33 +61,18 @@ struct CopyProcessor
         }
     }
 
-    bool copyFile(Path sourcePath, Path destPath)
+    // files are copied in batches by flushFiles(), which returns their number
+    size_t copyFile(Path sourcePath, Path destPath)
     {
-        auto readHandle = m_sourceFs.readFile(sourcePath);
-        if (!readHandle)
-            return 0;
-
-        auto writeHandle = m_destFs.createFile(destPath);
-        if (!writeHandle)
-            return 0;
-
-        bool succ = copyPhysicalFile(*readHandle, *writeHandle);
-        m_sourceFs.close(*readHandle);
-        m_destFs.close(*writeHandle);
-
-        return succ;
+        m_files.emplace_back(sourcePath, destPath);
+        return m_files.size() == MaxFiles ? flushFiles() : 0;
     }
 
-    bool copyPhysicalFile(ReadHandle readHandle, WriteHandle writeHandle)
+    size_t flushFiles()
     {
-        size_t fsize = m_sourceFs.fileSize(readHandle);
-        size_t blockSize = std::min(fsize, m_buffer.size());
-        for (size_t i = 0; i < fsize; i += blockSize)
-        {
-            m_sourceFs.read(readHandle, m_buffer.data(), blockSize);
-            m_destFs.write(writeHandle, m_buffer.data(), blockSize);
-        }
-        return true;
+        auto copied = m_destFs.copyFiles(m_sourceFs, m_files);
+        m_files.clear();
+        return copied;
     }
 
     size_t copyFolder(Folder sourceFolder, Folder destFolder)
@@ -116,6 +106,90 @@ struct CopyProcessor
         return numItems;
     }
 };
+
+// Walks a folder in the order of the names. The folder is only sorted by the first DirectoryKey::sortedSize() bytes
+// of the names, so the entries sharing them are read ahead and sorted.
+class NameOrderedCursor
+{
+    const FileSystem& m_fs;
+    FileSystem::Cursor m_cursor;
+    std::vector<std::pair<std::string, TreeValue>> m_entries; // in reverse order, back() is the current entry
+
+public:
+    NameOrderedCursor(const FileSystem& fs, Folder folder)
+        : m_fs(fs)
+        , m_cursor(fs.begin(Path(folder, "")))
+    {
+        next();
+    }
+
+    explicit operator bool() const noexcept { return !m_entries.empty(); }
+    std::string_view name() const noexcept { return m_entries.back().first; }
+    const TreeValue& value() const noexcept { return m_entries.back().second; }
+
+    void next()
+    {
+        if (!m_entries.empty())
+            m_entries.pop_back();
+        if (!m_entries.empty() || !m_cursor)
+            return;
+
+        std::string first(m_cursor.key().m_relativePath);
+        auto sortedPart = std::string_view(first).substr(0, DirectoryKey::sortedSize());
+        do
+        {
+            m_entries.emplace_back(m_cursor.key().m_relativePath, m_cursor.value());
+            m_cursor = m_fs.next(m_cursor);
+        } while (m_cursor && first.size() >= DirectoryKey::sortedSize() &&
+                 m_cursor.key().m_relativePath.substr(0, DirectoryKey::sortedSize()) == sortedPart);
+
+        std::sort(m_entries.begin(), m_entries.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+    }
+};
+
+size_t diffFolder(const FileSystem& oldFs, Folder oldFolder, const FileSystem& newFs, Folder newFolder,
+                  const std::string& prefix, const std::function<void(const DiffEntry&)>& sink)
+{
+    size_t differences = 0;
+    auto report = [&](DiffType type, std::string_view name, std::optional<TreeValue> oldValue,
+                      std::optional<TreeValue> newValue) {
+        sink(DiffEntry { type, prefix + std::string(name), std::move(oldValue), std::move(newValue) });
+        differences++;
+    };
+
+    NameOrderedCursor oldCursor(oldFs, oldFolder);
+    NameOrderedCursor newCursor(newFs, newFolder);
+    while (oldCursor || newCursor)
+    {
+        auto oldName = oldCursor ? oldCursor.name() : std::string_view();
+        auto newName = newCursor ? newCursor.name() : std::string_view();
+        auto order = !oldCursor ? 1 : !newCursor ? -1 : oldName.compare(newName);
+        if (order < 0)
+        {
+            report(DiffType::Removed, oldName, oldCursor.value(), std::nullopt);
+            oldCursor.next();
+            continue;
+        }
+        if (order > 0)
+        {
+            report(DiffType::Added, newName, std::nullopt, newCursor.value());
+            newCursor.next();
+            continue;
+        }
+
+        const auto& oldValue = oldCursor.value();
+        const auto& newValue = newCursor.value();
+        if (oldValue.getType() == TreeValue::Type::Folder && newValue.getType() == TreeValue::Type::Folder)
+            differences += diffFolder(oldFs, oldValue.get<Folder>(), newFs, newValue.get<Folder>(),
+                                      prefix + std::string(newName) + "/", sink);
+        else if (oldValue != newValue)
+            report(DiffType::Changed, newName, oldValue, newValue);
+        oldCursor.next();
+        newCursor.next();
+    }
+    return differences;
+}
 }
 
 namespace TxFs
@@ -166,7 +240,8 @@ size_t TxFs::copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Pat
         if (!destFolder)
             return 0;
 
-        return cp.copyFolder(sourcePath.m_parentFolder, destPath.m_parentFolder);
+        auto numItems = cp.copyFolder(sourcePath.m_parentFolder, destPath.m_parentFolder);
+        return numItems + cp.flushFiles();
     }
 
     auto sourceCursor = sourceFs.find(sourcePath);
@@ -176,7 +251,19 @@ size_t TxFs::copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Pat
     if (!destFs.createPath(destPath))
         return 0;
 
-    return cp.copyType(sourceCursor, destPath);
+    auto numItems = cp.copyType(sourceCursor, destPath);
+    return numItems + cp.flushFiles();
+}
+
+size_t TxFs::diff(const FileSystem& oldFs, const FileSystem& newFs, Path path,
+                  const std::function<void(const DiffEntry&)>& sink)
+{
+    auto oldFolder = path == RootPath ? Folder::Root : oldFs.subFolder(path);
+    auto newFolder = path == RootPath ? Folder::Root : newFs.subFolder(path);
+    if (!oldFolder || !newFolder)
+        return 0;
+
+    return diffFolder(oldFs, *oldFolder, newFs, *newFolder, "", sink);
 }
 
 FolderContents TxFs::retrieveFolderContents(Path path, const FileSystem& fs)
@@ -3,6 +3,8 @@
 #include "FileSystem.h"
 #include "FileSystemVisitor.h"
 #include "Path.h"
+#include <functional>
+#include <optional>
 #include <string_view>
 #include <string>
 
@@ -23,6 +25,25 @@ inline size_t copy(FileSystem& sourceFs, Path sourcePath, Path destPath)
 
 FolderContents retrieveFolderContents(Path path, const FileSystem& fs);
 
+//////////////////////////////////////////////////////////////////////////
+
+enum class DiffType { Added, Removed, Changed };
+
+struct DiffEntry
+{
+    DiffType m_type;
+    std::string m_path; // relative to the compared folder
+    std::optional<TreeValue> m_oldValue;
+    std::optional<TreeValue> m_newValue;
+};
+
+/// Merge-walks the folder at path in two versions of a composite in key order and passes every added, removed or
+/// changed entry to sink. Files with equal FileDescriptors count as unchanged without reading their data, so both
+/// versions have to stem from the same composite. Added and removed folders are reported without their contents.
+/// Returns the number of differences, 0 if path is not a folder in both versions.
+size_t diff(const FileSystem& oldFs, const FileSystem& newFs, Path path,
+            const std::function<void(const DiffEntry&)>& sink);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -47,6 +47,9 @@ VisitorControl FsCompareVisitor::dispatch(Path sourcePath, const TreeValue& sour
         return VisitorControl::Break;
     }
 
+    if (sourceValue.isFile() && destValue->isFile())
+        return compareFiles(sourcePath, destPath);
+
     auto sourceType = sourceValue.getType();
     auto destType = destValue->getType();
     if (sourceType != destType)
@@ -61,8 +64,6 @@ VisitorControl FsCompareVisitor::dispatch(Path sourcePath, const TreeValue& sour
         auto destFolder = destValue->get<Folder>();
         m_stack.push({ sourceFolder, destFolder });
     }
-    else if (sourceType == TreeValue::Type::File)
-        return compareFiles(sourcePath, destPath);
     else
     {
         if (sourceValue != *destValue)
@@ -74,44 +75,22 @@ VisitorControl FsCompareVisitor::dispatch(Path sourcePath, const TreeValue& sour
     return VisitorControl::Continue;
 }
 
+// Files are compared in batches, so a difference may only be found some entries later
 VisitorControl FsCompareVisitor::compareFiles(Path sourcePath, Path destPath)
 {
-    auto sourceHandle = *m_sourceFs.readFile(sourcePath);
-    auto destHandle = *m_destFs.readFile(destPath);
-
-    if (m_sourceFs.fileSize(sourceHandle) != m_destFs.fileSize(destHandle))
-    {
-        m_result = Result::NotEqual;
-        return VisitorControl::Break;
-    }
-
-    return compareFiles(sourceHandle, destHandle);
-}
-
-char* FsCompareVisitor::getLazyMemoryBuffer()
-{
-    if (!m_buffer)
-        m_buffer = std::make_unique<char[]>(BufferSize);
-    return m_buffer.get();
+    m_files.emplace_back(sourcePath, destPath);
+    return m_files.size() == MaxFiles ? flushFiles() : VisitorControl::Continue;
 }
 
-VisitorControl FsCompareVisitor::compareFiles(ReadHandle sourceHandle, ReadHandle destHandle)
+VisitorControl FsCompareVisitor::flushFiles()
 {
-    auto data = getLazyMemoryBuffer(); 
+    auto equal = m_sourceFs.compareFiles(m_destFs, m_files);
+    m_files.clear();
+    if (equal)
+        return VisitorControl::Continue;
 
-    size_t fsize = m_sourceFs.fileSize(sourceHandle);
-    size_t blockSize = std::min(fsize, BufferSize / 2);
-    for (size_t i = 0; i < fsize; i += blockSize)
-    {
-        m_sourceFs.read(sourceHandle, data, blockSize);
-        auto readSize = m_destFs.read(destHandle, data + blockSize, blockSize);
-        if (!std::equal(data, data + readSize, data + blockSize, data + blockSize + readSize))
-        {
-            m_result = Result::NotEqual;
-            return VisitorControl::Break;
-        }
-    }
-    return VisitorControl::Continue;
+    m_result = Result::NotEqual;
+    return VisitorControl::Break;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -152,6 +131,8 @@ struct Private::TempFileBuffer::Impl
     void write(Path path, const TreeValue& value)
     {
         DirectoryKey key(path.m_parentFolder, path.m_relativePath);
+        if (!key.overflow().empty())
+            throw std::runtime_error("TempFileBuffer: name too long");
         auto pos = toStream(key, m_buffer.get());
 
         ByteStringStream bss;
@@ -254,7 +235,10 @@ VisitorControl FsCopyVisitor::operator()(Path path, const TreeValue& value)
 {
     Path destPath = currentDestPath(path);
 
-    return dispatch(path, value, destPath);
+    auto control = dispatch(path, value, destPath);
+    if (control == VisitorControl::Break && !m_files.empty())
+        flushFiles(); // the files visited before still get copied
+    return control;
 }
 
 Path FsCopyVisitor::currentDestPath(Path sourcePath)
@@ -281,7 +265,7 @@ VisitorControl FsCopyVisitor::dispatch(Path sourcePath, const TreeValue& sourceV
 
         m_stack.push({ sourceFolder, *destFolder });
     }
-    else if (sourceType == TreeValue::Type::File)
+    else if (sourceValue.isFile())
         return copyFile(sourcePath, destPath);
     else
         if (!m_destFs.addAttribute(destPath, sourceValue))
@@ -291,35 +275,14 @@ VisitorControl FsCopyVisitor::dispatch(Path sourcePath, const TreeValue& sourceV
 
 VisitorControl FsCopyVisitor::copyFile(Path sourcePath, Path destPath)
 {
-    auto sourceHandle = *m_sourceFs.readFile(sourcePath);
-    auto destHandle = m_destFs.createFile(destPath);
-    if (!destHandle)
-        return VisitorControl::Break;
-
-    copyFile(sourceHandle, *destHandle);
-    return VisitorControl::Continue;
+    m_files.emplace_back(sourcePath, destPath);
+    return m_files.size() == MaxFiles ? flushFiles() : VisitorControl::Continue;
 }
 
-void FsCopyVisitor::copyFile(ReadHandle sourceHandle, WriteHandle destHandle)
+VisitorControl FsCopyVisitor::flushFiles()
 {
-    auto data = getLazyMemoryBuffer();
-
-    size_t fsize = m_sourceFs.fileSize(sourceHandle);
-    size_t blockSize = std::min(fsize, BufferSize);
-    for (size_t i = 0; i < fsize; i += blockSize)
-    {
-        m_sourceFs.read(sourceHandle, data, blockSize);
-        m_destFs.write(destHandle, data, blockSize);
-    }
-
-    m_sourceFs.close(sourceHandle);
-    m_destFs.close(destHandle);
+    auto copied = m_destFs.copyFiles(m_sourceFs, m_files);
+    auto complete = copied == m_files.size();
+    m_files.clear();
+    return complete ? VisitorControl::Continue : VisitorControl::Break;
 }
-
-char* FsCopyVisitor::getLazyMemoryBuffer()
-{
-    if (!m_buffer)
-        m_buffer = std::make_unique<char[]>(BufferSize);
-    return m_buffer.get();
-}
-
@@ -117,8 +117,8 @@ private:
     PathHolder m_destPath;
     Result m_result;
     SmallBufferStack<SourceDestFolder, 10> m_stack;
-    std::unique_ptr<char[]> m_buffer;
-    static constexpr size_t BufferSize = 32 * 4096;
+    FileSystem::FilePairs m_files;
+    static constexpr size_t MaxFiles = 1024;
 
 public:
     FsCompareVisitor(FileSystem& sourceFs, FileSystem& destFs, Path path)
@@ -135,8 +135,10 @@ public:
     void done(TIterator begin = nullptr, TIterator end = nullptr)
     {
         if constexpr (!std::is_null_pointer_v<TIterator>)
-            for (; begin != end; ++begin)
+            for (; begin != end && m_result == Result::Equal; ++begin)
                 operator()(begin->m_key, begin->m_value);
+        if (m_result == Result::Equal)
+            flushFiles();
     }
 
 
@@ -147,8 +149,7 @@ private:
     std::optional<TreeValue> getDestValue(Path destPath);
     VisitorControl dispatch(Path sourcePath, const TreeValue& sourceValue, Path destPath);
     VisitorControl compareFiles(Path sourcePath, Path destPath);
-    char* getLazyMemoryBuffer();    
-    VisitorControl compareFiles(ReadHandle sourceHandle, ReadHandle destHandle);
+    VisitorControl flushFiles();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -267,8 +268,8 @@ private:
     FileSystem& m_destFs;
     PathHolder m_destPath;
     SmallBufferStack<SourceDestFolder, 10> m_stack;
-    std::unique_ptr<char[]> m_buffer;
-    static constexpr size_t BufferSize = 32 * 4096;
+    FileSystem::FilePairs m_files;
+    static constexpr size_t MaxFiles = 1024;
 
 public:
     FsCopyVisitor(FileSystem& sourceFs, FileSystem& destFs, Path path)
@@ -285,7 +286,9 @@ public:
     {
         if constexpr (!std::is_null_pointer_v<TIterator>)
             for (; begin != end; ++begin)
-                operator()(begin->m_key, begin->m_value);
+                if (operator()(begin->m_key, begin->m_value) == VisitorControl::Break)
+                    return;
+        flushFiles();
     }
 
 
@@ -293,8 +296,7 @@ private:
     Path currentDestPath(Path sourcePath);
     VisitorControl dispatch(Path sourcePath, const TreeValue& sourceValue, Path destPath);
     VisitorControl copyFile(Path sourcePath, Path destPath);
-    void copyFile(ReadHandle sourceHandle, WriteHandle destHandle);
-    char* getLazyMemoryBuffer();
+    VisitorControl flushFiles();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
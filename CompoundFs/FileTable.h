@@ -16,7 +16,7 @@ class FileTable final
     uint16_t m_begin;
     uint16_t m_end;
     PageIndex m_next;
-    uint8_t m_data[4084];
+    uint8_t m_data[PageSize - 12];
 
 public:
     uint32_t m_checkSum;
@@ -28,7 +28,7 @@ public:
         , m_next(PageIdx::INVALID)
     {
         // m_data[0] = 0;
-        static_assert(sizeof(FileTable) == 4096);
+        static_assert(sizeof(FileTable) == PageSize);
     }
 
     constexpr void setNext(PageIndex next) noexcept { m_next = next; }
@@ -8,7 +8,16 @@
 #include "TypedCacheManager.h"
 #include "PageDef.h"
 #include "FileInterface.h"
+#include "Compression.h"
+#include "ChunkIndex.h"
+#include "Hasher.h"
+#include "TreeValue.h"
 #include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace TxFs
 {
@@ -28,12 +37,66 @@ public:
         m_fileDescriptor = FileDescriptor();
         m_pageSequence = IntervalSequence();
         m_fileTable = ConstPageDef<FileTable>();
+        m_pageChecksums.reset();
+        m_chunkIndex = nullptr;
+        m_hasSharedPages = false;
+    }
+
+    /// Keeps the file content in memory as long as it does not exceed maxInlineSize. Writing past that limit
+    /// promotes the file to regular pages.
+    void openInline(std::string_view data, size_t maxInlineSize)
+    {
+        createNew();
+        m_inlineData.assign(data.begin(), data.end());
+        m_maxInlineSize = maxInlineSize;
+        m_isInline = true;
+    }
+
+    bool isInline() const noexcept { return m_isInline; }
+
+    std::string closeInline()
+    {
+        assert(m_isInline);
+        m_isInline = false;
+        return std::move(m_inlineData);
+    }
+
+    /// Compresses the written data in chunks of CompressedChunkSize. Appending to an existing compressed file
+    /// adds new chunks after the last one.
+    void openCompressed(const CompressedFile& file)
+    {
+        openAppend(file.m_descriptor);
+        m_uncompressedSize = file.m_fileSize;
+        m_chunk.clear();
+        m_chunk.reserve(CompressedChunkSize);
+        m_isCompressed = true;
+    }
+
+    bool isCompressed() const noexcept { return m_isCompressed; }
+
+    CompressedFile closeCompressed()
+    {
+        assert(m_isCompressed);
+        auto fileSize = m_uncompressedSize;
+        return CompressedFile { close(), fileSize };
+    }
+
+    /// Makes the file consist of pages that are already stored, see DirectoryStructure::cloneFile().
+    FileDescriptor createFrom(IntervalSequence pages, uint64_t fileSize)
+    {
+        createNew();
+        m_pageSequence = std::move(pages);
+        m_fileDescriptor.m_fileSize = fileSize;
+        return close();
     }
 
     void openAppend(FileDescriptor fileId)
     {
         if (fileId != FileDescriptor())
         {
+            m_pageChecksums.reset();
+            m_chunkIndex = nullptr;
+            m_hasSharedPages = false;
             m_fileDescriptor = fileId;
             m_fileTable = m_cacheManager.loadPage<FileTable>(fileId.m_last);
             m_fileTable.m_page->insertInto(m_pageSequence);
@@ -42,8 +105,84 @@ public:
             createNew();
     }
 
+    /// The partially filled last page or PageIdx::INVALID
+    PageIndex partialLastPage() const
+    {
+        return m_fileDescriptor.m_fileSize % PageSize ? m_pageSequence.back().end() - 1 : PageIdx::INVALID;
+    }
+
+    /// Copies the partially filled last page to a new page, so appending leaves the old one to the files sharing it.
+    void relocateLastPage()
+    {
+        std::vector<uint8_t> data(size_t(m_fileDescriptor.m_fileSize % PageSize));
+        assert(!data.empty());
+        auto fileInterface = m_cacheManager.getFileInterface();
+        fileInterface->readPage(m_pageSequence.popBack(1).begin(), 0, data.data(), data.data() + data.size());
+        Interval iv = m_cacheManager.allocatePageInterval(1);
+        m_pageSequence.pushBack(iv);
+        fileInterface->writePage(iv.begin(), 0, data.data(), data.data() + data.size());
+    }
+
+    /// Records a checksum for every data page. checksums are those of the pages already in the file; the last one
+    /// is recomputed if that page is only partially filled.
+    void enablePageChecksums(std::vector<uint32_t> checksums)
+    {
+        auto fileSize = m_fileDescriptor.m_fileSize;
+        if (checksums.size() != (fileSize + PageSize - 1) / PageSize)
+            throw std::runtime_error("FileWriter: wrong number of page checksums");
+
+        m_checksumPage.resize(size_t(fileSize % PageSize));
+        if (!m_checksumPage.empty())
+        {
+            m_cacheManager.getFileInterface()->readPage(m_pageSequence.back().end() - 1, 0, m_checksumPage.data(),
+                                                        m_checksumPage.data() + m_checksumPage.size());
+            if (checksums.back() != hash32(m_checksumPage.data(), m_checksumPage.size()))
+                throw std::runtime_error("FileWriter: checksum mismatch in last data page");
+            checksums.pop_back();
+        }
+        m_pageChecksums = std::move(checksums);
+    }
+
+    /// Stores every full chunk of DedupChunkSize bytes only once, see ChunkIndex. The data written before the first
+    /// chunk must be page aligned, so only files without pages can be deduplicated. The last partial chunk is written
+    /// as usual.
+    void enableDeduplication(ChunkIndex* chunkIndex)
+    {
+        assert(m_fileDescriptor.m_fileSize == 0);
+        m_chunkIndex = chunkIndex;
+        m_dedupChunk.clear();
+        m_dedupChunk.reserve(DedupChunkSize);
+    }
+
+    /// True if the file references pages registered with the ChunkIndex. Still valid after close().
+    bool hasSharedPages() const noexcept { return m_hasSharedPages; }
+
+    std::optional<std::vector<uint32_t>> takePageChecksums()
+    {
+        auto checksums = std::move(m_pageChecksums);
+        m_pageChecksums.reset();
+        return checksums;
+    }
+
     FileDescriptor close()
     {
+        if (m_isInline)
+            promoteInline();
+        if (m_isCompressed)
+        {
+            flushChunk();
+            m_isCompressed = false;
+        }
+        if (m_chunkIndex)
+        {
+            flushDedupChunk();
+            m_chunkIndex = nullptr;
+        }
+        if (m_pageChecksums && !m_checksumPage.empty())
+        {
+            m_pageChecksums->push_back(hash32(m_checksumPage.data(), m_checksumPage.size()));
+            m_checksumPage.clear();
+        }
         pushFileTable();
         if (m_fileTable.m_page)
             m_fileDescriptor.m_last = m_fileTable.m_index;
@@ -55,26 +194,185 @@ public:
 
     void write(const uint8_t* begin, const uint8_t* end)
     {
+        if (m_isInline)
+        {
+            if (m_inlineData.size() + (end - begin) <= m_maxInlineSize)
+            {
+                m_inlineData.append(reinterpret_cast<const char*>(begin), reinterpret_cast<const char*>(end));
+                return;
+            }
+            promoteInline();
+        }
+
+        if (m_isCompressed)
+            writeChunks(begin, end);
+        else
+            writeStored(begin, end);
+    }
+
+    void pushFileTable()
+    {
+        if (m_pageSequence.empty())
+            return;
+
+        // create a FileTable page if we never had before and fill it
+        PageDef<FileTable> cur
+            = m_fileTable.m_page ? m_cacheManager.makePageWritable(m_fileTable) : m_cacheManager.newPage<FileTable>();
+        cur.m_page->transferFrom(m_pageSequence);
+
+        // adjust file descriptor if its still a default one
+        if (m_fileDescriptor.m_first == PageIdx::INVALID)
+            m_fileDescriptor.m_first = cur.m_index;
+
+        while (!m_pageSequence.empty())
+        {
+            PageDef<FileTable> next = m_cacheManager.newPage<FileTable>();
+            next.m_page->transferFrom(m_pageSequence);
+            cur.m_page->setNext(next.m_index);
+            cur = next;
+        }
+
+        m_fileTable = cur;
+    }
+
+    template <class TIter>
+    void writeIterator(TIter begin, TIter end)
+    {
+        write((uint8_t*) &begin[0], (uint8_t*) &begin[0] + (end - begin));
+    }
+
+    uint64_t size() const
+    {
+        if (m_isInline)
+            return m_inlineData.size();
+        return m_isCompressed ? m_uncompressedSize : m_fileDescriptor.m_fileSize;
+    }
+
+private:
+    void promoteInline()
+    {
+        m_isInline = false;
+        std::string data = std::move(m_inlineData);
+        m_inlineData.clear();
+        auto begin = reinterpret_cast<const uint8_t*>(data.data());
+        write(begin, begin + data.size());
+    }
+
+    void writeChunks(const uint8_t* begin, const uint8_t* end)
+    {
+        m_uncompressedSize += end - begin;
+        while (begin != end)
+        {
+            auto size = std::min(size_t(end - begin), CompressedChunkSize - m_chunk.size());
+            m_chunk.insert(m_chunk.end(), begin, begin + size);
+            begin += size;
+            if (m_chunk.size() == CompressedChunkSize)
+                flushChunk();
+        }
+    }
+
+    void flushChunk()
+    {
+        if (m_chunk.empty())
+            return;
+
+        m_compressedChunk.resize(maxCompressedChunkSize(m_chunk.size()));
+        auto chunkEnd = compressChunk(m_chunk.data(), m_chunk.data() + m_chunk.size(), m_compressedChunk.data());
+        m_chunk.clear();
+
+        writeStored(m_compressedChunk.data(), chunkEnd);
+    }
+
+    void writeStored(const uint8_t* begin, const uint8_t* end)
+    {
+        if (!m_chunkIndex)
+        {
+            writePages(begin, end);
+            return;
+        }
+
+        while (begin != end)
+        {
+            auto size = std::min(size_t(end - begin), DedupChunkSize - m_dedupChunk.size());
+            m_dedupChunk.insert(m_dedupChunk.end(), begin, begin + size);
+            begin += size;
+            if (m_dedupChunk.size() == DedupChunkSize)
+                flushDedupChunk();
+        }
+    }
+
+    void flushDedupChunk()
+    {
+        auto begin = m_dedupChunk.data();
+        auto end = begin + m_dedupChunk.size();
+        if (m_dedupChunk.size() != DedupChunkSize)
+        {
+            if (begin != end)
+                writePages(begin, end);
+            m_dedupChunk.clear();
+            return;
+        }
+
+        assert(m_fileDescriptor.m_fileSize % PageSize == 0);
+        auto hash = hash64(begin, DedupChunkSize);
+        if (auto pages = m_chunkIndex->findChunk(hash, begin, end))
+        {
+            appendPages(*pages, begin);
+            m_hasSharedPages = true;
+        }
+        else
+        {
+            Interval iv = m_cacheManager.allocatePageInterval(DedupChunkPages);
+            m_cacheManager.getFileInterface()->writePages(iv, begin);
+            appendPages(iv, begin);
+            if (iv.length() == DedupChunkPages)
+            {
+                m_chunkIndex->addChunk(hash, iv);
+                m_hasSharedPages = true;
+            }
+            else // not contiguous: store the chunk like any other data
+                writePages(begin + size_t(iv.length()) * PageSize, end);
+        }
+        m_dedupChunk.clear();
+    }
+
+    /// Adds full pages holding [begin, begin + iv.length() * PageSize) to the file without writing them.
+    void appendPages(Interval iv, const uint8_t* begin)
+    {
+        auto size = size_t(iv.length()) * PageSize;
+        if (m_pageChecksums)
+            updatePageChecksums(begin, begin + size);
+        m_pageSequence.pushBack(iv);
+        m_fileDescriptor.m_fileSize += size;
+        checkHighWaterMark();
+    }
+
+    void writePages(const uint8_t* begin, const uint8_t* end)
+    {
+        if (m_pageChecksums)
+            updatePageChecksums(begin, end);
+
         const size_t blockSize = end - begin;
 
         // fill last page at max to page boundary
-        if (m_fileDescriptor.m_fileSize % 4096)
+        if (m_fileDescriptor.m_fileSize % PageSize)
         {
-            size_t pageOffset = size_t(m_fileDescriptor.m_fileSize % 4096);
-            const uint8_t* newEndInPage = begin + std::min(4096 - pageOffset, blockSize);
+            size_t pageOffset = size_t(m_fileDescriptor.m_fileSize % PageSize);
+            const uint8_t* newEndInPage = begin + std::min(PageSize - pageOffset, blockSize);
             m_cacheManager.getFileInterface()->writePage(m_pageSequence.back().end() - 1, pageOffset, begin,
                                                             newEndInPage);
+            m_cacheManager.addWrittenPages(Interval(m_pageSequence.back().end() - 1));
             begin = newEndInPage;
         }
 
         // write full pages
-        size_t pages = (end - begin) / 4096;
+        size_t pages = (end - begin) / PageSize;
         while (pages > 0)
         {
             Interval iv = m_cacheManager.allocatePageInterval(pages);
             m_pageSequence.pushBack(iv);
             m_cacheManager.getFileInterface()->writePages(iv, begin);
-            begin += static_cast<size_t>(iv.length()) * 4096;
+            begin += static_cast<size_t>(iv.length()) * PageSize;
             pages -= iv.length();
         }
 
@@ -86,7 +384,11 @@ public:
             m_cacheManager.getFileInterface()->writePage(iv.begin(), 0, begin, end);
         }
         m_fileDescriptor.m_fileSize += blockSize;
+        checkHighWaterMark();
+    }
 
+    void checkHighWaterMark()
+    {
         if (m_pageSequence.size() >= m_highWaterMark)
         {
             pushFileTable();
@@ -94,45 +396,44 @@ public:
         }
     }
 
-    void pushFileTable()
+    void updatePageChecksums(const uint8_t* begin, const uint8_t* end)
     {
-        if (m_pageSequence.empty())
-            return;
-
-        // create a FileTable page if we never had before and fill it
-        PageDef<FileTable> cur
-            = m_fileTable.m_page ? m_cacheManager.makePageWritable(m_fileTable) : m_cacheManager.newPage<FileTable>();
-        cur.m_page->transferFrom(m_pageSequence);
-
-        // adjust file descriptor if its still a default one
-        if (m_fileDescriptor.m_first == PageIdx::INVALID)
-            m_fileDescriptor.m_first = cur.m_index;
-
-        while (!m_pageSequence.empty())
+        while (begin != end)
         {
-            PageDef<FileTable> next = m_cacheManager.newPage<FileTable>();
-            next.m_page->transferFrom(m_pageSequence);
-            cur.m_page->setNext(next.m_index);
-            cur = next;
+            auto size = std::min(size_t(end - begin), PageSize - m_checksumPage.size());
+            if (size == PageSize)
+                m_pageChecksums->push_back(hash32(begin, PageSize));
+            else
+            {
+                m_checksumPage.insert(m_checksumPage.end(), begin, begin + size);
+                if (m_checksumPage.size() == PageSize)
+                {
+                    m_pageChecksums->push_back(hash32(m_checksumPage.data(), PageSize));
+                    m_checksumPage.clear();
+                }
+            }
+            begin += size;
         }
-
-        m_fileTable = cur;
     }
 
-    template <class TIter>
-    void writeIterator(TIter begin, TIter end)
-    {
-        write((uint8_t*) &begin[0], (uint8_t*) &begin[0] + (end - begin));
-    }
-
-    uint64_t size() const { return m_fileDescriptor.m_fileSize; }
-
 private:
     IntervalSequence m_pageSequence;
     TypedCacheManager m_cacheManager;
     ConstPageDef<FileTable> m_fileTable;
     FileDescriptor m_fileDescriptor;
     size_t m_highWaterMark;
+    std::string m_inlineData;
+    size_t m_maxInlineSize = 0;
+    bool m_isInline = false;
+    std::vector<uint8_t> m_chunk;
+    std::vector<uint8_t> m_compressedChunk;
+    uint64_t m_uncompressedSize = 0;
+    bool m_isCompressed = false;
+    std::optional<std::vector<uint32_t>> m_pageChecksums;
+    std::vector<uint8_t> m_checksumPage;
+    ChunkIndex* m_chunkIndex = nullptr;
+    std::vector<uint8_t> m_dedupChunk;
+    bool m_hasSharedPages = false;
 };
 
 //////////////////////////////////////////////////////////////////////////
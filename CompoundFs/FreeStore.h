@@ -57,7 +57,7 @@ public:
         }
 
         auto iv = m_current.popFront(maxPages);
-        m_currentFileSize -= iv.length() * 4096ULL;
+        m_currentFileSize -= iv.length() * uint64_t(PageSize);
         return iv;
     }
 
@@ -65,6 +65,10 @@ public:
     void deallocate(uint32_t page) { m_freeMetaDataPages.insert(page); }
     void deallocateStillInUse(uint32_t page) { m_stillInUsePages.insert(page); }
 
+    /// Return data pages of a file that cannot be deleted as a whole because some of its pages are shared. These
+    /// pages will be available in the next transaction.
+    void deallocate(Interval iv) { m_freedDataPages.pushBack(iv); }
+
     /// Defered file deletion. Upon commit-time when close() is called we will add these files to the FreeStore. The
     /// space of these files will be available in the next transaction.
     void deleteFile(FileDescriptor fd)
@@ -73,10 +77,30 @@ public:
             return;
 
         // round up to page size
-        fd.m_fileSize = ((fd.m_fileSize + 4096 - 1) / 4096) * 4096;
+        fd.m_fileSize = ((fd.m_fileSize + PageSize - 1) / PageSize) * PageSize;
         m_filesToDelete.push_back(fd);
     }
 
+    /// The pages held by the committed FreeStore, sorted. All other pages of the file are in use.
+    IntervalSequence freePages() const
+    {
+        IntervalSequence is;
+        for (auto page = m_fileDescriptor.m_first; page != PageIdx::INVALID;)
+            page = loadFileTablePage(page, is);
+        is.sort();
+        return is;
+    }
+
+    /// The FileTable pages of the committed FreeStore. They are handed out once their intervals are used up.
+    std::vector<PageIndex> fileTablePages() const
+    {
+        std::vector<PageIndex> pages;
+        for (auto page = m_fileDescriptor.m_first; page != PageIdx::INVALID;
+             page = m_cacheManager.loadPage<FileTable>(page).m_page->getNext())
+            pages.push_back(page);
+        return pages;
+    }
+
     FileDescriptor close()
     {
         // if anything was changed establish consistancy before calling finalize()
@@ -95,6 +119,7 @@ public:
         // m_freeListHeadPage.reset(); TODO: ?
         m_freeMetaDataPages.clear();
         m_stillInUsePages.clear();
+        m_freedDataPages.clear();
         m_current.clear();
 
         return fd;
@@ -154,6 +179,8 @@ private:
 
     void addRemainingPagesToIntervalSequence(IntervalSequence& is)
     {
+        m_freedDataPages.moveTo(is);
+
         // add the m_freeMetaDataPages to the IntervalSequence so we can reuse it
         for (auto page: m_freeMetaDataPages)
             is.pushBack(Interval(page));
@@ -220,10 +247,11 @@ private:
         for (const auto& fd: m_filesToDelete)
             m_fileDescriptor.m_fileSize += fd.m_fileSize;
 
+        m_fileDescriptor.m_fileSize += m_freedDataPages.totalLength() * uint64_t(PageSize);
         auto is = onePageOptimization();
         addRemainingPagesToIntervalSequence(is);
-        m_fileDescriptor.m_fileSize += m_freeMetaDataPages.size() * 4096ULL;
-        m_fileDescriptor.m_fileSize += m_stillInUsePages.size() * 4096ULL;
+        m_fileDescriptor.m_fileSize += m_freeMetaDataPages.size() * uint64_t(PageSize);
+        m_fileDescriptor.m_fileSize += m_stillInUsePages.size() * uint64_t(PageSize);
 
         FileDescriptor cur = pushFileTables(is);
         for (const auto& fd: m_filesToDelete)
@@ -239,8 +267,8 @@ private:
         assert(ft.m_page->getNext() == PageIdx::INVALID);
         m_cacheManager.makePageWritable(ft).m_page->setNext(next.m_first);
 
-        assert(prev.m_fileSize % 4096 == 0);
-        assert(next.m_fileSize % 4096 == 0);
+        assert(prev.m_fileSize % PageSize == 0);
+        assert(next.m_fileSize % PageSize == 0);
 
         prev.m_last = next.m_last;
         return prev;
@@ -253,6 +281,7 @@ private:
     std::vector<FileDescriptor> m_filesToDelete;
     std::unordered_set<PageIndex> m_freeMetaDataPages;
     std::unordered_set<PageIndex> m_stillInUsePages;
+    IntervalSequence m_freedDataPages;
     IntervalSequence m_current;
     ConstPageDef<FileTable> m_freeListHeadPage; 
 };
@@ -18,7 +18,7 @@ namespace TxFs
 
 class InnerNode final : public Node
 {
-    uint8_t m_data[4083];
+    uint8_t m_data[PageSize - 13];
     PageIndex m_leftMost;
 
 public:
@@ -30,7 +30,7 @@ public:
         , m_leftMost(PageIdx::INVALID)
     {
         m_data[0] = 0;
-        static_assert(sizeof(InnerNode) == 4096);
+        static_assert(sizeof(InnerNode) == PageSize);
     }
 
     InnerNode(ByteStringView key, PageIndex left, PageIndex right) noexcept
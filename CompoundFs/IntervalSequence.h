@@ -80,6 +80,20 @@ public:
         return Interval(id, id + size);
     }
 
+    Interval popBack(uint32_t maxSize)
+    {
+        assert(!empty());
+        PageIndex end = m_intervals.back().end();
+
+        PageIndex size = std::min(maxSize, m_intervals.back().length());
+        m_intervals.back().end() -= size;
+        if (m_intervals.back().empty())
+            m_intervals.pop_back();
+
+        m_totalLength -= size;
+        return Interval(end - size, end);
+    }
+
     void clear() 
     { 
         m_intervals.clear(); 
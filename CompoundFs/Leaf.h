@@ -18,7 +18,7 @@ namespace TxFs
 
 class Leaf final : public Node
 {
-    uint8_t m_data[4079];
+    uint8_t m_data[PageSize - 17];
     PageIndex m_prev;
     PageIndex m_next;
 
@@ -32,7 +32,7 @@ public:
         , m_next(next)
     {
         m_data[0] = 0; // make the compiler happy
-        static_assert(sizeof(Leaf) == 4096);
+        static_assert(sizeof(Leaf) == PageSize);
     }
 
     constexpr PageIndex getNext() const noexcept { return m_next; }
@@ -142,6 +142,19 @@ public:
                 *it -= size;
     }
 
+    void remove(const uint16_t* first, const uint16_t* last) noexcept
+    {
+        assert(beginTable() <= first && first <= last && last <= endTable());
+        Leaf tmp = *this;
+        const uint16_t* tmpFirst = tmp.beginTable() + (first - beginTable());
+        const uint16_t* tmpLast = tmp.beginTable() + (last - beginTable());
+
+        m_begin = 0;
+        m_end = uint16_t(sizeof(m_data) - sizeof(uint16_t) * (tmp.nofItems() - (tmpLast - tmpFirst)));
+        uint16_t* destTable = append(tmp, tmp.beginTable(), tmpFirst, beginTable());
+        append(tmp, tmpLast, tmp.endTable(), destTable);
+    }
+
     void split(Leaf* rightLeaf, ByteStringView key, ByteStringView value) noexcept
     {
         Leaf tmp = *this;
@@ -175,7 +188,11 @@ private:
     {
         m_begin = 0;
         m_end = uint16_t(sizeof(m_data) - sizeof(uint16_t) * (end - begin));
-        uint16_t* destTable = beginTable();
+        append(leaf, begin, end, beginTable());
+    }
+
+    uint16_t* append(const Leaf& leaf, const uint16_t* begin, const uint16_t* end, uint16_t* destTable) noexcept
+    {
         for (const uint16_t* it = begin; it < end; ++it)
         {
             auto xend = toStream(leaf.getKey(it), &m_data[m_begin]);
@@ -184,6 +201,7 @@ private:
             destTable++;
             m_begin = toIndex(xend);
         }
+        return destTable;
     }
 };
 
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "Lock.h"
+#include "LockTracer.h"
 #include <optional>
 #include <variant>
 #include <mutex>
@@ -11,7 +12,8 @@
 namespace TxFs
 {
 
-/// Implements the lock-protocol.
+/// Implements the lock-protocol. The blocking acquisitions report to the installed LockTracer, if there is one, along
+/// with the thread of this process that held the lock while they waited.
 template <typename TSharedMutex, typename TMutex>
 class LockProtocol final
 {
@@ -28,6 +30,18 @@ public:
     CommitLock commitAccess(Lock&& writeLock);
     std::variant<CommitLock, Lock> tryCommitAccess(Lock&& writeLock);
 
+private:
+    template <typename TLockable>
+    static void lock(TLockable& mutex, LockKind kind);
+    template <typename TLockable>
+    static void lockShared(TLockable& mutex, LockKind kind);
+    template <typename TTryLock, typename TLock>
+    static void tracedLock(LockWait wait, TTryLock&& tryLock, TLock&& lock);
+    static void held(const void* mutex, LockMode mode);
+    static void releaseShared(void* mutex);
+    static void releaseExclusive(void* mutex);
+    static void releaseWriter(void* mutex);
+
 private:
     TSharedMutex m_gate;
     TSharedMutex m_shared;
@@ -44,12 +58,82 @@ inline LockProtocol<TSMutex, TXMutex>::LockProtocol(TSMutex&& gate, TSMutex&& sh
 {
 }
 
+template <typename TSMutex, typename TXMutex>
+template <typename TTryLock, typename TLock>
+inline void LockProtocol<TSMutex, TXMutex>::tracedLock(LockWait wait, TTryLock&& tryLock, TLock&& lock)
+{
+    wait.m_thread = std::this_thread::get_id();
+    wait.m_begin = LockWait::Clock::now();
+    wait.m_contended = !tryLock();
+    if (wait.m_contended)
+    {
+        wait.m_holder = lockHolder(wait.m_lock);
+        lock();
+    }
+    wait.m_end = wait.m_contended ? LockWait::Clock::now() : wait.m_begin;
+    lockHeld(wait.m_lock, wait.m_mode);
+    traceLockWait(wait); // the tracer may have been replaced while we waited
+}
+
+template <typename TSMutex, typename TXMutex>
+inline void LockProtocol<TSMutex, TXMutex>::held(const void* mutex, LockMode mode)
+{
+    if (lockTracer())
+        lockHeld(mutex, mode);
+}
+
+template <typename TSMutex, typename TXMutex>
+inline void LockProtocol<TSMutex, TXMutex>::releaseShared(void* mutex)
+{
+    lockReleased(mutex, LockMode::Shared);
+    static_cast<TSMutex*>(mutex)->unlock_shared();
+}
+
+template <typename TSMutex, typename TXMutex>
+inline void LockProtocol<TSMutex, TXMutex>::releaseExclusive(void* mutex)
+{
+    lockReleased(mutex, LockMode::Exclusive);
+    static_cast<TSMutex*>(mutex)->unlock();
+}
+
+template <typename TSMutex, typename TXMutex>
+inline void LockProtocol<TSMutex, TXMutex>::releaseWriter(void* mutex)
+{
+    lockReleased(mutex, LockMode::Exclusive);
+    static_cast<TXMutex*>(mutex)->unlock();
+}
+
+template <typename TSMutex, typename TXMutex>
+template <typename TLockable>
+inline void LockProtocol<TSMutex, TXMutex>::lock(TLockable& mutex, LockKind kind)
+{
+    if (!lockTracer())
+        return mutex.lock();
+
+    tracedLock(
+        LockWait { kind, LockMode::Exclusive, false, &mutex }, [&] { return mutex.try_lock(); },
+        [&] { mutex.lock(); });
+}
+
+template <typename TSMutex, typename TXMutex>
+template <typename TLockable>
+inline void LockProtocol<TSMutex, TXMutex>::lockShared(TLockable& mutex, LockKind kind)
+{
+    if (!lockTracer())
+        return mutex.lock_shared();
+
+    tracedLock(
+        LockWait { kind, LockMode::Shared, false, &mutex }, [&] { return mutex.try_lock_shared(); },
+        [&] { mutex.lock_shared(); });
+}
+
 template <typename TSMutex, typename TXMutex>
 inline Lock LockProtocol<TSMutex, TXMutex>::readAccess()
 {
-    std::shared_lock slock(m_gate);
-    m_shared.lock_shared();
-    return Lock(&m_shared, [](void* m) { static_cast<TSMutex*>(m)->unlock_shared(); });
+    lockShared(m_gate, LockKind::Gate);
+    Lock gateLock(&m_gate, releaseShared);
+    lockShared(m_shared, LockKind::Shared);
+    return Lock(&m_shared, releaseShared);
 }
 
 template <typename TSMutex, typename TXMutex>
@@ -62,14 +146,15 @@ inline std::optional<Lock> LockProtocol<TSMutex, TXMutex>::tryReadAccess()
     if (!m_shared.try_lock_shared())
         return std::nullopt;
 
-    return Lock(&m_shared, [](void* m) { static_cast<TSMutex*>(m)->unlock_shared(); });
+    held(&m_shared, LockMode::Shared);
+    return Lock(&m_shared, releaseShared);
 }
 
 template <typename TSMutex, typename TXMutex>
 inline Lock LockProtocol<TSMutex, TXMutex>::writeAccess()
 {
-    m_writer.lock();
-    return Lock(&m_writer, [](void* m) { static_cast<TXMutex*>(m)->unlock(); });
+    lock(m_writer, LockKind::Writer);
+    return Lock(&m_writer, releaseWriter);
 }
 
 template <typename TSMutex, typename TXMutex>
@@ -78,7 +163,8 @@ inline std::optional<Lock> LockProtocol<TSMutex, TXMutex>::tryWriteAccess()
     if (!m_writer.try_lock())
         return std::nullopt;
 
-    return Lock(&m_writer, [](void* m) { static_cast<TXMutex*>(m)->unlock(); });
+    held(&m_writer, LockMode::Exclusive);
+    return Lock(&m_writer, releaseWriter);
 }
 
 template <typename TSMutex, typename TXMutex>
@@ -87,10 +173,11 @@ CommitLock LockProtocol<TSMutex, TXMutex>::commitAccess(Lock&& writeLock)
     if (!writeLock.isSameMutex(&m_writer))
         throw std::runtime_error("Incompatible writeLock parameter for commitAccess()");
 
-    std::unique_lock ulock(m_gate);
+    lock(m_gate, LockKind::Gate);
+    Lock gateLock(&m_gate, releaseExclusive);
 
-    m_shared.lock();
-    return CommitLock(std::move(writeLock), Lock(&m_shared, [](void* m) { static_cast<TSMutex*>(m)->unlock(); }));
+    lock(m_shared, LockKind::Shared);
+    return CommitLock(std::move(writeLock), Lock(&m_shared, releaseExclusive));
 }
 
 template <typename TSMutex, typename TXMutex>
@@ -105,8 +192,9 @@ std::variant<CommitLock, Lock> LockProtocol<TSMutex, TXMutex>::tryCommitAccess(L
 
     if (!m_shared.try_lock())
         return std::move(writeLock);
-    
-    return CommitLock(std::move(writeLock), Lock(&m_shared, [](void* m) { static_cast<TSMutex*>(m)->unlock(); }));
+
+    held(&m_shared, LockMode::Exclusive);
+    return CommitLock(std::move(writeLock), Lock(&m_shared, releaseExclusive));
 }
 
 }
@@ -0,0 +1,190 @@
+
+
+#include "LockTracer.h"
+#include <algorithm>
+#include <atomic>
+
+using namespace TxFs;
+
+namespace
+{
+std::atomic<LockTracer*> g_lockTracer = nullptr;
+std::atomic<size_t> g_tracerCalls = 0; // calls of traceLockWait() in flight
+
+// the holders of the locks taken while a tracer was installed
+struct HeldLock
+{
+    std::optional<std::thread::id> m_exclusive;
+    size_t m_shared = 0;
+    std::thread::id m_lastShared;
+};
+
+std::mutex g_heldLocksMutex;
+std::unordered_map<const void*, HeldLock> g_heldLocks;
+std::atomic<size_t> g_numberOfHeldLocks = 0;
+
+const char* kindName(LockKind kind)
+{
+    switch (kind)
+    {
+    case LockKind::Gate:
+        return "gate";
+    case LockKind::Shared:
+        return "shared";
+    default:
+        return "writer";
+    }
+}
+
+const char* modeName(LockMode mode)
+{
+    return mode == LockMode::Shared ? "shared" : "exclusive";
+}
+
+size_t histogramBucket(LockStatistics::Duration wait)
+{
+    auto micros = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+    size_t bucket = 0;
+    while (micros >= (uint64_t(1) << bucket) && bucket + 1 < LockStatistics::HistogramBuckets)
+        bucket++;
+    return bucket;
+}
+
+}
+
+// The store and the loads of the count are sequentially consistent with the ones in traceLockWait(): a call either
+// sees the new tracer or is seen here.
+void TxFs::setLockTracer(LockTracer* tracer) noexcept
+{
+    g_lockTracer.store(tracer, std::memory_order_seq_cst);
+    while (g_tracerCalls.load(std::memory_order_seq_cst) != 0)
+        std::this_thread::yield();
+}
+
+LockTracer* TxFs::lockTracer() noexcept
+{
+    return g_lockTracer.load(std::memory_order_acquire);
+}
+
+void TxFs::traceLockWait(const LockWait& wait)
+{
+    struct CallInFlight
+    {
+        CallInFlight() noexcept { g_tracerCalls.fetch_add(1, std::memory_order_seq_cst); }
+        ~CallInFlight() { g_tracerCalls.fetch_sub(1, std::memory_order_release); }
+    } call;
+
+    if (auto tracer = g_lockTracer.load(std::memory_order_seq_cst))
+        tracer->lockAcquired(wait);
+}
+
+void TxFs::lockHeld(const void* lock, LockMode mode)
+{
+    std::lock_guard guard(g_heldLocksMutex);
+    auto& heldLock = g_heldLocks[lock];
+    if (mode == LockMode::Exclusive)
+        heldLock.m_exclusive = std::this_thread::get_id();
+    else
+    {
+        heldLock.m_shared++;
+        heldLock.m_lastShared = std::this_thread::get_id();
+    }
+    g_numberOfHeldLocks = g_heldLocks.size();
+}
+
+void TxFs::lockReleased(const void* lock, LockMode mode) noexcept
+{
+    if (g_numberOfHeldLocks.load(std::memory_order_relaxed) == 0)
+        return;
+
+    std::lock_guard guard(g_heldLocksMutex);
+    auto it = g_heldLocks.find(lock);
+    if (it == g_heldLocks.end())
+        return; // taken before the tracer was installed
+
+    if (mode == LockMode::Exclusive)
+        it->second.m_exclusive.reset();
+    else if (it->second.m_shared)
+        it->second.m_shared--;
+    if (!it->second.m_exclusive && !it->second.m_shared)
+        g_heldLocks.erase(it);
+    g_numberOfHeldLocks = g_heldLocks.size();
+}
+
+std::optional<LockHolder> TxFs::lockHolder(const void* lock)
+{
+    std::lock_guard guard(g_heldLocksMutex);
+    auto it = g_heldLocks.find(lock);
+    if (it == g_heldLocks.end())
+        return std::nullopt;
+    if (it->second.m_exclusive)
+        return LockHolder { *it->second.m_exclusive, LockMode::Exclusive };
+    return LockHolder { it->second.m_lastShared, LockMode::Shared };
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void LockStatistics::lockAcquired(const LockWait& wait)
+{
+    auto duration = wait.m_end - wait.m_begin;
+    std::lock_guard lock(m_mutex);
+    auto& counters = m_counters[size_t(wait.m_kind) * 2 + size_t(wait.m_mode)];
+    counters.m_acquisitions++;
+    if (!wait.m_contended)
+        return;
+
+    counters.m_contended++;
+    counters.m_totalWait += duration;
+    counters.m_longestWait = std::max(counters.m_longestWait, duration);
+    counters.m_histogram[histogramBucket(duration)]++;
+}
+
+LockStatistics::Counters LockStatistics::counters(LockKind kind, LockMode mode) const
+{
+    std::lock_guard lock(m_mutex);
+    return m_counters[size_t(kind) * 2 + size_t(mode)];
+}
+
+void LockStatistics::reset()
+{
+    std::lock_guard lock(m_mutex);
+    m_counters = {};
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ChromeTraceWriter::ChromeTraceWriter(std::ostream& out)
+    : m_out(out)
+    , m_start(LockWait::Clock::now())
+{
+    m_out << "[";
+}
+
+ChromeTraceWriter::~ChromeTraceWriter()
+{
+    m_out << "\n]\n";
+    m_out.flush();
+}
+
+void ChromeTraceWriter::lockAcquired(const LockWait& wait)
+{
+    if (!wait.m_contended)
+        return;
+
+    using namespace std::chrono;
+    auto begin = duration<double, std::micro>(wait.m_begin - m_start).count();
+    auto length = duration<double, std::micro>(wait.m_end - wait.m_begin).count();
+
+    std::lock_guard lock(m_mutex);
+    auto threadId = [this](std::thread::id id) {
+        return m_threads.try_emplace(id, uint32_t(m_threads.size() + 1)).first->second;
+    };
+    m_out << (m_first ? "\n" : ",\n") << "{\"name\":\"" << kindName(wait.m_kind) << " " << modeName(wait.m_mode)
+          << "\",\"cat\":\"lock\",\"ph\":\"X\",\"ts\":" << begin << ",\"dur\":" << length
+          << ",\"pid\":1,\"tid\":" << threadId(wait.m_thread) << ",\"args\":{\"lock\":\"" << wait.m_lock << "\"";
+    if (wait.m_holder)
+        m_out << ",\"holder\":" << threadId(wait.m_holder->m_thread) << ",\"holderMode\":\""
+              << modeName(wait.m_holder->m_mode) << "\"";
+    m_out << "}}";
+    m_first = false;
+}
@@ -0,0 +1,119 @@
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace TxFs
+{
+
+/// The three locks of the LockProtocol. Readers wait on the Gate while a commit waits for or holds it, a commit waits
+/// on Shared until the readers are gone and writers wait on Writer for each other.
+enum class LockKind : uint8_t { Gate, Shared, Writer };
+enum class LockMode : uint8_t { Shared, Exclusive };
+
+/// A thread holding the lock another thread has to wait for. If the lock is held shared by several threads it is the
+/// latest of them. Only locks of this process taken while a tracer was installed are known; a lock held by another
+/// process leaves the holder of a contended wait empty.
+struct LockHolder
+{
+    std::thread::id m_thread;
+    LockMode m_mode;
+};
+
+/// One blocking lock acquisition. m_contended is set if the lock could not be taken right away; the thread waited from
+/// m_begin to m_end then, for the lock of the same kind held by m_holder when the wait began.
+struct LockWait
+{
+    using Clock = std::chrono::steady_clock;
+
+    LockKind m_kind;
+    LockMode m_mode;
+    bool m_contended;
+    const void* m_lock;
+    std::thread::id m_thread;
+    Clock::time_point m_begin;
+    Clock::time_point m_end;
+    std::optional<LockHolder> m_holder;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Receives the lock acquisitions of all LockProtocols of the process once it is installed with setLockTracer().
+/// Calls come from any thread holding the lock that was just acquired, so implementations have to be thread-safe
+/// and quick.
+
+class LockTracer
+{
+public:
+    virtual ~LockTracer() = default;
+    virtual void lockAcquired(const LockWait& wait) = 0;
+};
+
+/// Installs the tracer (nullptr removes it). Returns once no thread calls the replaced tracer any more, so it may be
+/// destroyed then; a tracer must not call it. Without a tracer lock acquisition is not timed at all.
+void setLockTracer(LockTracer* tracer) noexcept;
+LockTracer* lockTracer() noexcept;
+
+/// Hands an acquisition to the tracer installed right now, if there is one.
+void traceLockWait(const LockWait& wait);
+
+/// Bookkeeping of the LockProtocol: which thread holds which lock. lockHeld() is only called while a tracer is
+/// installed, lockReleased() always and before the lock is unlocked.
+void lockHeld(const void* lock, LockMode mode);
+void lockReleased(const void* lock, LockMode mode) noexcept;
+std::optional<LockHolder> lockHolder(const void* lock);
+
+///////////////////////////////////////////////////////////////////////////////
+/// Counts acquisitions and contention per lock kind and mode and keeps a histogram of the wait times.
+
+class LockStatistics final : public LockTracer
+{
+public:
+    using Duration = std::chrono::steady_clock::duration;
+    static constexpr size_t HistogramBuckets = 24; // bucket i counts waits below 2^i microseconds
+
+    struct Counters
+    {
+        uint64_t m_acquisitions = 0;
+        uint64_t m_contended = 0;
+        Duration m_totalWait {};
+        Duration m_longestWait {};
+        std::array<uint64_t, HistogramBuckets> m_histogram {};
+    };
+
+    void lockAcquired(const LockWait& wait) override;
+    Counters counters(LockKind kind, LockMode mode) const;
+    void reset();
+
+private:
+    mutable std::mutex m_mutex;
+    std::array<Counters, 6> m_counters;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes every contended wait as a complete event ("ph":"X") in the Chrome trace event format, which chrome://tracing
+/// and Perfetto load. The array is closed when the writer is destroyed.
+
+class ChromeTraceWriter final : public LockTracer
+{
+public:
+    explicit ChromeTraceWriter(std::ostream& out);
+    ~ChromeTraceWriter() override;
+
+    void lockAcquired(const LockWait& wait) override;
+
+private:
+    std::mutex m_mutex;
+    std::ostream& m_out;
+    LockWait::Clock::time_point m_start;
+    std::unordered_map<std::thread::id, uint32_t> m_threads;
+    bool m_first = true;
+};
+
+}
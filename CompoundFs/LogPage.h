@@ -1,23 +1,28 @@
 #pragma once
 
+#include "Node.h"
+#include "Hasher.h"
+#include <array>
 #include <random>
 #include <vector>
 #include <algorithm>
 
 namespace TxFs
 {
-using PageIndex = uint32_t;
-
 class LogPage final
 {
 public:
+    /// Undo logs point to copies of the original pages, Redo logs to the new contents. The first entry of a Redo log
+    /// page holds the number of Redo log pages and the redoLogHash() of the whole log.
+    enum class Type { Undo, Redo };
+
     struct PageCopies
     {
         uint32_t m_original;
         uint32_t m_copy;
     };
 
-    constexpr static size_t MAX_ENTRIES = 509;
+    constexpr static size_t MAX_ENTRIES = (PageSize - 6 * sizeof(uint32_t)) / sizeof(PageCopies);
 
 private:
     uint32_t m_signature[4];
@@ -30,19 +35,19 @@ public:
 public:
     explicit LogPage() noexcept = default;
 
-    LogPage(PageIndex pageIndex) noexcept
+    LogPage(PageIndex pageIndex, Type type = Type::Undo) noexcept
         : m_size(0)
     {
-        std::minstd_rand mt(pageIndex);
+        std::minstd_rand mt(seed(pageIndex, type));
         m_signature[0] = (uint32_t) mt();
         m_signature[1] = (uint32_t) mt();
         m_signature[2] = (uint32_t) mt();
         m_signature[3] = (uint32_t) mt();
     }
 
-    bool checkSignature(PageIndex pageIndex) const noexcept
+    bool checkSignature(PageIndex pageIndex, Type type = Type::Undo) const noexcept
     {
-        std::minstd_rand mt(pageIndex);
+        std::minstd_rand mt(seed(pageIndex, type));
         uint32_t sig[4] = { (uint32_t) mt(), (uint32_t) mt(), (uint32_t) mt(), (uint32_t) mt() };
         return std::equal(sig, sig + 4, m_signature, m_signature + 4) && m_size <= MAX_ENTRIES;
     }
@@ -78,12 +83,28 @@ public:
     }
 
     constexpr size_t size() const noexcept { return m_size; }
+
+private:
+    static uint32_t seed(PageIndex pageIndex, Type type) noexcept
+    {
+        return type == Type::Undo ? pageIndex : pageIndex ^ 0x52656430;
+    }
 };
 
+/// A Redo log entry: the original page, the page with its new contents and the checksum of the new contents.
+using RedoEntry = std::array<uint32_t, 3>;
+
+/// Identifies a complete Redo log independent of the order of its entries.
+inline uint32_t redoLogHash(std::vector<RedoEntry> entries)
+{
+    std::sort(entries.begin(), entries.end());
+    return hash32(entries.data(), entries.size() * sizeof(RedoEntry));
+}
+
 constexpr bool operator==(LogPage::PageCopies lhs, LogPage::PageCopies rhs) noexcept
 {
     return lhs.m_copy == rhs.m_copy && lhs.m_original == rhs.m_original;
 }
 
-static_assert(sizeof(LogPage) == 4096);
+static_assert(sizeof(LogPage) == PageSize);
 }
@@ -13,6 +13,7 @@ MemoryFileBase::MemoryFileBase()
 
 Interval MemoryFileBase::newInterval(size_t maxPages)
 {
+    std::unique_lock lock(*m_mutex);
     PageIndex idx = (PageIndex) m_file.size();
     for (size_t i = 0; i < maxPages; i++)
         m_file.emplace_back(m_allocator.allocate());
@@ -21,8 +22,9 @@ Interval MemoryFileBase::newInterval(size_t maxPages)
 
 const uint8_t* MemoryFileBase::writePage(PageIndex idx, size_t pageOffset, const uint8_t* begin, const uint8_t* end)
 {
+    std::shared_lock lock(*m_mutex);
     auto p = m_file.at(idx);
-    if (pageOffset + (end - begin) > 4096)
+    if (pageOffset + (end - begin) > PageSize)
         throw std::runtime_error("MemoryFileBase::writePage over page boundary");
     std::copy(begin, end, p.get() + pageOffset);
     return end;
@@ -30,29 +32,32 @@ const uint8_t* MemoryFileBase::writePage(PageIndex idx, size_t pageOffset, const
 
 const uint8_t* MemoryFileBase::writePages(Interval iv, const uint8_t* page)
 {
+    std::shared_lock lock(*m_mutex);
     for (auto idx = iv.begin(); idx < iv.end(); idx++)
     {
         auto p = m_file.at(idx);
-        std::copy(page, page + 4096, p.get());
-        page += 4096;
+        std::copy(page, page + PageSize, p.get());
+        page += PageSize;
     }
     return page;
 }
 
 uint8_t* MemoryFileBase::readPage(PageIndex idx, size_t pageOffset, uint8_t* begin, uint8_t* end) const
 {
+    std::shared_lock lock(*m_mutex);
     auto p = m_file.at(idx);
-    if (pageOffset + (end - begin) > 4096)
+    if (pageOffset + (end - begin) > PageSize)
         throw std::runtime_error("MemoryFileBase::readPage over page boundary");
     return std::copy(p.get() + pageOffset, p.get() + pageOffset + (end - begin), begin);
 }
 
 uint8_t* MemoryFileBase::readPages(Interval iv, uint8_t* page) const
 {
+    std::shared_lock lock(*m_mutex);
     for (auto idx = iv.begin(); idx < iv.end(); idx++)
     {
         auto p = m_file.at(idx);
-        page = std::copy(p.get(), p.get() + 4096, page);
+        page = std::copy(p.get(), p.get() + PageSize, page);
     }
     return page;
 }
@@ -62,12 +67,14 @@ void MemoryFileBase::flushFile()
 
 void MemoryFileBase::truncate(size_t numberOfPages)
 {
-    assert(numberOfPages <= fileSizeInPages());
+    std::unique_lock lock(*m_mutex);
+    assert(numberOfPages <= m_file.size());
     m_file.resize(numberOfPages);
 }
 
 size_t MemoryFileBase::fileSizeInPages() const
 {
+    std::shared_lock lock(*m_mutex);
     return m_file.size();
 }
 
@@ -38,6 +38,8 @@ public:
     void truncate(size_t numberOfPages) override;
 
 private:
+    // pages are accessed shared, the file grows and shrinks exclusively
+    std::unique_ptr<std::shared_mutex> m_mutex = std::make_unique<std::shared_mutex>();
     PageAllocator m_allocator;
     std::vector<std::shared_ptr<uint8_t>> m_file;
 };
@@ -5,6 +5,11 @@
 #define NODE_H
 
 #include <cstdint>
+#include <cstddef>
+
+#ifndef TXFS_PAGE_SIZE
+#define TXFS_PAGE_SIZE 4096
+#endif
 
 namespace TxFs
 {
@@ -12,6 +17,13 @@ namespace TxFs
 using PageIndex = uint32_t;
 enum PageIdx : PageIndex { INVALID = UINT32_MAX };
 
+/// Size of all pages in bytes. It is fixed at build time and recorded in the CommitBlock of each file.
+constexpr size_t PageSize = TXFS_PAGE_SIZE;
+constexpr size_t MinPageSize = 4096;
+constexpr size_t MaxPageSize = 65536;
+static_assert(PageSize >= MinPageSize && PageSize <= MaxPageSize && (PageSize & (PageSize - 1)) == 0,
+              "TXFS_PAGE_SIZE must be a power of two between 4096 and 65536");
+
 enum class NodeType : uint8_t { Undefined, Leaf, Inner };
 
 //////////////////////////////////////////////////////////////////////////
@@ -1,14 +1,29 @@
 
 #include "PageAllocator.h"
+#include "Node.h"
 #include <algorithm>
 #include <unordered_map>
 #include <system_error>
 
 using namespace TxFs;
 
-PageAllocator::PageAllocator(size_t pagesPerBlock)
+namespace
+{
+size_t blockSize(size_t pagesPerBlock, HugePages hugePages)
+{
+    pagesPerBlock = std::max(pagesPerBlock, size_t(16));
+    if (hugePages == HugePages::None)
+        return pagesPerBlock;
+
+    constexpr size_t pagesPerHugePage = PageAllocator::HugePageSize / PageSize;
+    return (pagesPerBlock + pagesPerHugePage - 1) / pagesPerHugePage * pagesPerHugePage;
+}
+}
+
+PageAllocator::PageAllocator(size_t pagesPerBlock, HugePages hugePages)
     : m_blocksAllocated(0)
-    , m_pagesPerBlock(std::max(pagesPerBlock, size_t(16)))
+    , m_pagesPerBlock(blockSize(pagesPerBlock, hugePages))
+    , m_hugePages(hugePages)
     , m_currentPosInBlock(nullptr)
 {}
 
@@ -29,8 +44,8 @@ std::shared_ptr<uint8_t> PageAllocator::allocate()
     }
 
     auto page = makePage(m_block, m_currentPosInBlock);
-    m_currentPosInBlock += 4096;
-    if ((m_block.get() + m_pagesPerBlock * 4096) != m_currentPosInBlock)
+    m_currentPosInBlock += PageSize;
+    if ((m_block.get() + m_pagesPerBlock * PageSize) != m_currentPosInBlock)
         return page;
 
     m_block = allocBlock();
@@ -77,13 +92,19 @@ std::pair<size_t, size_t> PageAllocator::trim()
 #define NOMINMAX 1
 #include <windows.h>
 
+// large pages need the SeLockMemoryPrivilege on Windows: blocks are always regular pages here
+std::shared_ptr<uint8_t> PageAllocator::allocHugePageBlock()
+{
+    return allocBlock();
+}
+
 std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 {
     // reserves the memory but allocates only on touch (when you start using it)
-    uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * 4096, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * PageSize, MEM_COMMIT, PAGE_READWRITE);
 
     // actually allocates the memory immediately 
-    //uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * 4096, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    //uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * PageSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 
     if (block == nullptr)
         throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), "PageAllocator");
@@ -94,13 +115,52 @@ std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 
 #else
 
+#include <sys/mman.h>
+#include <cerrno>
+
 std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 {
-    std::shared_ptr<uint8_t> block(new uint8_t[m_pagesPerBlock * 4096], [](uint8_t* b) { delete[] b; });
+    if (m_hugePages != HugePages::None)
+        return allocHugePageBlock();
+
+    std::shared_ptr<uint8_t> block(new uint8_t[m_pagesPerBlock * PageSize], [](uint8_t* b) { delete[] b; });
     m_blocksAllocated++;
     return block;
 }
 
+// The mapping is only backed by memory on first touch, so the pages land on the NUMA node of the thread that uses
+// them. trim() unmaps whole blocks which hands the huge pages back to the system.
+std::shared_ptr<uint8_t> PageAllocator::allocHugePageBlock()
+{
+    auto size = m_pagesPerBlock * PageSize;
+    void* block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (m_hugePages == HugePages::Explicit)
+        block = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+    if (block == MAP_FAILED)
+    {
+        // over-allocate to cut out a block aligned to the huge page size
+        auto mapped = ::mmap(nullptr, size + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            throw std::system_error(errno, std::system_category(), "PageAllocator");
+
+        auto begin = reinterpret_cast<uintptr_t>(mapped);
+        auto aligned = (begin + HugePageSize - 1) / HugePageSize * HugePageSize;
+        if (aligned != begin)
+            ::munmap(mapped, aligned - begin);
+        ::munmap(reinterpret_cast<void*>(aligned + size), begin + HugePageSize - aligned);
+        block = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        ::madvise(block, size, MADV_HUGEPAGE); // only a hint: fails if transparent huge pages are disabled
+#endif
+    }
+
+    m_blocksAllocated++;
+    return std::shared_ptr<uint8_t>(static_cast<uint8_t*>(block), [size](uint8_t* b) { ::munmap(b, size); });
+}
+
 #endif
 
 std::shared_ptr<uint8_t> PageAllocator::makePage(std::shared_ptr<uint8_t> block, uint8_t* page)
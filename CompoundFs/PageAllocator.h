@@ -8,30 +8,39 @@
 
 namespace TxFs
 {
+
+/// How the PageAllocator backs its blocks. Transparent asks the kernel to use huge pages for 2 MiB aligned blocks,
+/// Explicit maps them from the reserved huge page pool and falls back to Transparent if the pool is empty.
+enum class HugePages : uint8_t { None, Transparent, Explicit };
+
 //////////////////////////////////////////////////////////////////////////////////
 /// PageAllocator is a bump-pointer allocator. It allocates pages from a 
 /// block with the size of multiple pages. The pages are handed out via a 
 /// std::shared_ptr<> which upon deletion returns the memory to the PageAllocator
 /// instance where it is kept in container for re-usage. PageAllocator can be 
 /// moved. PageAllocator::trim() will return as many blocks as possible to the 
-/// system.
+/// system. With huge pages a block covers at least one 2 MiB huge page.
 
 class PageAllocator final
 {
 public:
-    PageAllocator(size_t pagesPerBlock=16);
+    static constexpr size_t HugePageSize = 2 << 20;
+
+    PageAllocator(size_t pagesPerBlock=16, HugePages hugePages = HugePages::None);
 
     std::shared_ptr<uint8_t> allocate();
     std::pair<size_t, size_t> trim();
 
 private:
     std::shared_ptr<uint8_t> allocBlock();
+    std::shared_ptr<uint8_t> allocHugePageBlock();
     std::shared_ptr<uint8_t> makePage(std::shared_ptr<uint8_t> block, uint8_t* page);
 
 private:
     using BlockPage = std::pair<std::shared_ptr<uint8_t>, uint8_t*>;
     size_t m_blocksAllocated;
     size_t m_pagesPerBlock;
+    HugePages m_hugePages;
     std::unique_ptr<std::vector<BlockPage>> m_freePages; // to make lambdas immune to move ops
     std::shared_ptr<uint8_t> m_block;
     uint8_t* m_currentPosInBlock;
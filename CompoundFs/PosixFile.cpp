@@ -4,6 +4,7 @@
 #include "Lock.h"
 #include <sys/types.h>
 #include <fcntl.h>
+#include <mutex>
 
 #ifndef _WINDOWS
     #include <unistd.h>
@@ -50,12 +51,39 @@ constexpr auto read = WrapOsCall<::read>();
     constexpr auto lseek = WrapOsCall<::lseek>();
     constexpr auto fsync = WrapOsCall<::fsync>();
     constexpr auto ftruncate = WrapOsCall<::ftruncate>();
+    constexpr auto pread = WrapOsCall<::pread>();
+    constexpr auto pwrite = WrapOsCall<::pwrite>();
 
     int fileHandleToLockHandle(int file) { return file; }
 
 #else
-    constexpr auto lseek = WrapOsCall<::_lseeki64>();
     constexpr auto fsync = WrapOsCall<::_commit>();
+    constexpr auto lseekUnlocked = WrapOsCall<::_lseeki64>();
+
+    // There are no positional reads and writes here: they seek first and every seek moves the offset all threads
+    // share. One mutex for all files makes seeking and reading or writing a single step, so concurrent reads and
+    // writes land where they belong. A WindowsFile does not need that.
+    std::mutex g_fileOffsetMutex;
+
+    int64_t lseek(int fd, int64_t offset, int origin)
+    {
+        std::lock_guard lock(g_fileOffsetMutex);
+        return lseekUnlocked(fd, offset, origin);
+    }
+
+    int pread(int fd, void* buffer, unsigned size, int64_t offset)
+    {
+        std::lock_guard lock(g_fileOffsetMutex);
+        lseekUnlocked(fd, offset, SEEK_SET);
+        return read(fd, buffer, size);
+    }
+
+    int pwrite(int fd, const void* buffer, unsigned size, int64_t offset)
+    {
+        std::lock_guard lock(g_fileOffsetMutex);
+        lseekUnlocked(fd, offset, SEEK_SET);
+        return write(fd, buffer, size);
+    }
 
     int ftruncate(int fd, int64_t size)
     {
@@ -76,7 +104,6 @@ constexpr auto read = WrapOsCall<::read>();
 
 namespace
 {
-constexpr uint64_t PageSize = 4096ULL;
 constexpr uint32_t BlockSize = 16 * 1024 * 1024;
 }
 
@@ -161,7 +188,7 @@ PosixFile::PosixFile(int file, bool readOnly)
         FileLock { posix::fileHandleToLockHandle(file), FileLockPosition::WriteBegin, FileLockPosition::WriteEnd },
     }
 {
-    static constexpr int64_t MaxFileSize = 4096LL * int64_t(std::numeric_limits<uint32_t>::max() - 1LL);
+    static constexpr int64_t MaxFileSize = int64_t(PageSize) * int64_t(std::numeric_limits<uint32_t>::max() - 1LL);
     static_assert(MaxFileSize < FileLockPosition::GateBegin);
     static_assert(FileLockPosition::GateBegin < FileLockPosition::GateEnd);
     static_assert(MaxFileSize < FileLockPosition::SharedBegin);
@@ -184,8 +211,7 @@ const uint8_t* PosixFile::writePage(PageIndex id, size_t pageOffset, const uint8
     if (fileSizeInPages() <= id)
         throw std::runtime_error("File::writePage outside file");
 
-    posix::lseek(m_file, id * PageSize + pageOffset, SEEK_SET);
-    posix::write(m_file, begin, unsigned(end - begin));
+    posix::pwrite(m_file, begin, unsigned(end - begin), int64_t(id) * PageSize + pageOffset);
     return end;
 }
 
@@ -194,19 +220,18 @@ const uint8_t* PosixFile::writePages(Interval iv, const uint8_t* page)
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("File::writePages outside file");
 
-    posix::lseek(m_file, iv.begin() * PageSize, SEEK_SET);
     auto end = page + (iv.length() * PageSize);
-    writePagesInBlocks(page, end);
+    writePagesInBlocks(int64_t(iv.begin()) * PageSize, page, end);
 
     return end;
 }
 
-void PosixFile::writePagesInBlocks(const uint8_t* begin, const uint8_t* end)
+void PosixFile::writePagesInBlocks(int64_t position, const uint8_t* begin, const uint8_t* end)
 {
-    for (; (begin + BlockSize) < end; begin += BlockSize)
-        posix::write(m_file, begin, BlockSize);
+    for (; (begin + BlockSize) < end; begin += BlockSize, position += BlockSize)
+        posix::pwrite(m_file, begin, BlockSize, position);
 
-    posix::write(m_file, begin, unsigned(end-begin));
+    posix::pwrite(m_file, begin, unsigned(end - begin), position);
 }
 
 uint8_t* PosixFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin, uint8_t* end) const
@@ -216,8 +241,7 @@ uint8_t* PosixFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin, ui
     if (fileSizeInPages() <= id)
         throw std::runtime_error("File::readPage outside file");
 
-    posix::lseek(m_file, id * PageSize + pageOffset, SEEK_SET);
-    int bytesRead = posix::read(m_file, begin, unsigned(end - begin));
+    auto bytesRead = posix::pread(m_file, begin, unsigned(end - begin), int64_t(id) * PageSize + pageOffset);
     return begin + bytesRead;
 }
 
@@ -226,23 +250,55 @@ uint8_t* PosixFile::readPages(Interval iv, uint8_t* page) const
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("File::readPages outside file");
 
-    posix::lseek(m_file, iv.begin() * PageSize, SEEK_SET);
     auto end = page + (iv.length() * PageSize);
-    size_t bytesRead = readPagesInBlocks(page, end);
+    size_t bytesRead = readPagesInBlocks(int64_t(iv.begin()) * PageSize, page, end);
 
     return page + bytesRead;
 }
 
-size_t PosixFile::readPagesInBlocks(uint8_t* begin, uint8_t* end) const
+size_t PosixFile::readPagesInBlocks(int64_t position, uint8_t* begin, uint8_t* end) const
 {
     size_t bytesRead = 0;
-    for (; (begin + BlockSize) < end; begin += BlockSize)
-        bytesRead += posix::read(m_file, begin, BlockSize);
+    for (; (begin + BlockSize) < end; begin += BlockSize, position += BlockSize)
+        bytesRead += posix::pread(m_file, begin, BlockSize, position);
 
-    bytesRead += posix::read(m_file, begin, unsigned(end - begin));
+    bytesRead += posix::pread(m_file, begin, unsigned(end - begin), position);
     return bytesRead;
 }
 
+/// Uses copy_file_range() on Linux if source is a PosixFile as well. The kernel can then share or copy the data
+/// without moving it through user space.
+bool PosixFile::copyPages([[maybe_unused]] const FileInterface& source, [[maybe_unused]] Interval sourcePages,
+                          [[maybe_unused]] PageIndex dest)
+{
+#ifdef __linux__
+    auto posixSource = dynamic_cast<const PosixFile*>(&source);
+    if (!posixSource)
+        return false;
+    if (fileSizeInPages() < dest + sourcePages.length())
+        throw std::runtime_error("File::copyPages outside file");
+
+    loff_t sourceOffset = loff_t(sourcePages.begin()) * PageSize;
+    loff_t destOffset = loff_t(dest) * PageSize;
+    size_t size = size_t(sourcePages.length()) * PageSize;
+    while (size > 0)
+    {
+        auto copied = ::copy_file_range(posixSource->m_file, &sourceOffset, m_file, &destOffset, size, 0);
+        if (copied <= 0)
+        {
+            // e.g. EXDEV on older kernels: nothing is lost as long as nothing was copied
+            if (size == size_t(sourcePages.length()) * PageSize)
+                return false;
+            throw std::runtime_error("File::copyPages failed");
+        }
+        size -= size_t(copied);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
 size_t PosixFile::fileSizeInPages() const
 {
     auto bytes = posix::lseek(m_file, 0, SEEK_END);
@@ -37,6 +37,7 @@ public:
     uint8_t* readPage(PageIndex id, size_t pageOffset, uint8_t* begin, uint8_t* end) const override;
     uint8_t* readPages(Interval iv, uint8_t* page) const override;
     size_t fileSizeInPages() const override;
+    bool copyPages(const FileInterface& source, Interval sourcePages, PageIndex dest) override;
     void flushFile() override;
     void truncate(size_t numberOfPages) override;
     Lock defaultAccess() override;
@@ -47,8 +48,8 @@ public:
 private:
     PosixFile(int file, bool readOnly);
     static int open(std::filesystem::path path, OpenMode mode);
-    void writePagesInBlocks(const uint8_t* begin, const uint8_t* end);
-    size_t readPagesInBlocks(uint8_t* begin, uint8_t* end) const;
+    void writePagesInBlocks(int64_t position, const uint8_t* begin, const uint8_t* end);
+    size_t readPagesInBlocks(int64_t position, uint8_t* begin, uint8_t* end) const;
 
 
 private:
@@ -2,19 +2,135 @@
 #include "RollbackHandler.h"
 #include "LogPage.h"
 #include "FileIo.h"
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <future>
+#include <optional>
+#include <thread>
 
 using namespace TxFs;
 
+namespace
+{
+constexpr PageIndex ScanPages = 64;  // log pages read at once
+constexpr uint32_t BatchPages = 64; // pages restored by one job
+
+/// Consecutive original pages whose copies are consecutive as well
+struct PageRun
+{
+    PageIndex m_original;
+    PageIndex m_copy;
+    uint32_t m_length;
+};
+
+// Calls visit(pageIndex, logPage) for the log pages of the given type at the end of the file, from the last page
+// backwards. Reads one page first, as most files have no log, and then ScanPages at a time. Stops at the first page
+// that is no log page or when visit() returns false.
+template <typename TVisit>
+void scanLogPages(const FileInterface* file, LogPage::Type type, TVisit visit)
+{
+    std::vector<LogPage> logPages(ScanPages);
+    auto end = static_cast<PageIndex>(file->fileSizeInPages());
+    for (PageIndex length = 1; end != 0; length = ScanPages)
+    {
+        auto begin = end - std::min(end, length);
+        file->readPages(Interval(begin, end), reinterpret_cast<uint8_t*>(logPages.data()));
+        for (auto idx = end; idx-- != begin;)
+        {
+            const auto& logPage = logPages[idx - begin];
+            if (!reinterpret_cast<const SignedPage*>(&logPage)->validateCheckSum() || !logPage.checkSignature(idx, type))
+                return;
+            if (!visit(idx, logPage))
+                return;
+        }
+        end = begin;
+    }
+}
+
+std::vector<PageRun> coalesce(std::vector<std::pair<PageIndex, PageIndex>> logs)
+{
+    std::sort(logs.begin(), logs.end());
+    std::vector<PageRun> runs;
+    for (auto [orig, cpy]: logs)
+    {
+        if (!runs.empty())
+        {
+            auto& run = runs.back();
+            if (run.m_length < BatchPages && run.m_original + run.m_length == orig && run.m_copy + run.m_length == cpy)
+            {
+                run.m_length++;
+                continue;
+            }
+        }
+        runs.push_back({ orig, cpy, 1 });
+    }
+    return runs;
+}
+
+void restoreRun(FileInterface* file, const PageRun& run, uint8_t* buffer)
+{
+    file->readPages(Interval(run.m_copy, run.m_copy + run.m_length), buffer);
+    for (uint32_t i = 0; i < run.m_length; i++)
+        if (!reinterpret_cast<const SignedPage*>(buffer + size_t(i) * PageSize)->validateCheckSum())
+            throw std::runtime_error("Error validating checkSum");
+    file->writePages(Interval(run.m_original, run.m_original + run.m_length), buffer); // no need to add checksum
+}
+
+// Restores the runs in jobs of about BatchPages pages on up to hardware_concurrency() threads. Runs never share a
+// page, so the writes do not interfere.
+void restorePages(FileInterface* file, const std::vector<PageRun>& runs)
+{
+    std::vector<size_t> jobs; // index of the first run of each job
+    uint32_t jobPages = BatchPages;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (jobPages + runs[i].m_length > BatchPages)
+        {
+            jobs.push_back(i);
+            jobPages = 0;
+        }
+        jobPages += runs[i].m_length;
+    }
+    jobs.push_back(runs.size());
+
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> stopped = false;
+    auto worker = [&] {
+        try
+        {
+            std::vector<uint8_t> buffer(size_t(BatchPages) * PageSize);
+            for (auto i = next++; i + 1 < jobs.size() && !stopped; i = next++)
+                for (auto run = jobs[i]; run < jobs[i + 1]; run++)
+                    restoreRun(file, runs[run], buffer.data());
+        }
+        catch (...)
+        {
+            stopped = true;
+            throw;
+        }
+    };
+
+    auto threads = std::min(jobs.size() - 1, size_t(std::max(1U, std::thread::hardware_concurrency())));
+    std::vector<std::future<void>> workers;
+    for (size_t i = 1; i < threads; i++)
+        workers.push_back(std::async(std::launch::async, worker));
+    worker();
+    for (auto& w: workers)
+        w.get();
+}
+}
+
 RollbackHandler::RollbackHandler(Cache& cache) noexcept
     : m_cache(cache)
 {}
 
-void TxFs::RollbackHandler::revertPartialCommit()
+/// Copies the logged pages back to their original place. The copies are sorted by their original page and
+/// neighbours are joined into runs, so the pages are read and written in large blocks by several threads at once.
+/// One flush at the end makes the restored pages durable.
+void RollbackHandler::revertPartialCommit()
 {
-    auto logs = readLogs();
-    for (auto [orig, cpy]: logs)
-        TxFs::copyPage(m_cache.file(), cpy, orig);
+    restorePages(m_cache.file(), coalesce(readLogs()));
     m_cache.file()->flushFile();
 }
 
@@ -46,23 +162,57 @@ std::vector<std::pair<PageIndex, PageIndex>> RollbackHandler::readLogs() const
     if (!size)
         return res;
 
-    PageIndex idx = static_cast<PageIndex>(size);
     LogPage logPage {};
+    auto last = static_cast<PageIndex>(size - 1);
+    if (TxFs::testReadSignedPage(m_cache.file(), last, &logPage) && logPage.checkSignature(last, LogPage::Type::Redo))
+        return readRedoLogs();
 
-    do
-    {
-        bool check = TxFs::testReadSignedPage(m_cache.file(), --idx, &logPage);
-        if (!check)
-            return res;
-
-        if (!logPage.checkSignature(idx))
-            return res;
-
+    scanLogPages(m_cache.file(), LogPage::Type::Undo, [&res](PageIndex, const LogPage& logPage) {
         res.reserve(res.size() + logPage.size());
         for (auto [orig, cpy]: logPage)
             res.emplace_back(orig, cpy);
-    } while (idx != 0);
+        return true;
+    });
+    return res;
+}
+
+/// Returns the pages of a Redo log if it is complete, i.e. if all its log pages and all the new page contents it
+/// points to made it to the file. Otherwise the commit never happened and there is nothing to replay. The entries
+/// of the New pages point to themselves and only take part in that check.
+std::vector<std::pair<PageIndex, PageIndex>> RollbackHandler::readRedoLogs() const
+{
+    std::optional<LogPage::PageCopies> header;
+    std::vector<RedoEntry> redoLog;
+    uint32_t logPages = 0;
+    scanLogPages(m_cache.file(), LogPage::Type::Redo, [&](PageIndex, const LogPage& logPage) {
+        auto it = logPage.begin();
+        if (logPage.size() == 0 || (header && !(*header == *it)))
+            return false;
+        header = *it;
+        logPages++;
+        for (++it; it != logPage.end(); ++it)
+            redoLog.push_back({ it->m_original, it->m_copy, 0 });
+        return true;
+    });
 
+    if (!header || header->m_original != logPages)
+        return {};
+
+    SignedPage page;
+    for (auto& entry: redoLog)
+    {
+        if (!TxFs::testReadSignedPage(m_cache.file(), entry[1], &page))
+            return {};
+        entry[2] = page.m_checkSum;
+    }
+    if (redoLogHash(redoLog) != header->m_copy)
+        return {};
+
+    std::vector<std::pair<PageIndex, PageIndex>> res;
+    res.reserve(redoLog.size());
+    for (const auto& entry: redoLog)
+        if (entry[0] != entry[1])
+            res.emplace_back(entry[0], entry[1]);
     return res;
 }
 
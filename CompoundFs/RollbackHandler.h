@@ -15,6 +15,9 @@ public:
     void virtualRevertPartialCommit();
     std::vector<std::pair<PageIndex, PageIndex>> readLogs() const;
 
+private:
+    std::vector<std::pair<PageIndex, PageIndex>> readRedoLogs() const;
+
 private:
     Cache& m_cache;
 };
@@ -0,0 +1,44 @@
+
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+
+namespace TxFs
+{
+
+///////////////////////////////////////////////////////////////////////////
+/// Counters of a CacheManager since it was created or its statistics were reset. They are plain integers updated by
+/// the thread that owns the CacheManager, so keeping them costs next to nothing.
+
+struct Statistics
+{
+    using Duration = std::chrono::steady_clock::duration;
+
+    // page cache
+    uint64_t m_cacheHits = 0;
+    uint64_t m_cacheMisses = 0;
+    uint64_t m_evictedReadPages = 0;
+    uint64_t m_evictedNewPages = 0;
+    uint64_t m_divertedPages = 0; // evicted Dirty pages
+
+    // page allocation
+    uint64_t m_pagesFromFreeStore = 0;
+    uint64_t m_pagesFromFileGrowth = 0;
+
+    // commits
+    uint64_t m_commits = 0;
+    uint64_t m_committedPages = 0; // pages written by commits including copies and logs
+    uint64_t m_committedDirtyPages = 0;
+    uint64_t m_flushes = 0;
+
+    // time spent in the commit phases
+    Duration m_copyTime {};
+    Duration m_logTime {};
+    Duration m_lockWaitTime {};
+    Duration m_overwriteTime {};
+    Duration m_truncateTime {};
+    Duration m_longestCommit {};
+};
+
+}
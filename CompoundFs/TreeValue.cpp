@@ -22,7 +22,7 @@ void defaultCreate(size_t index, std::variant<Ts...>& var)
 std::string_view TreeValue::getTypeName() const
 {
     constexpr std::array<std::string_view, std::variant_size_v<Variant>> ar = 
-    { "File", "Folder", "Version", "Double", "Int64", "Int32", "String", "Unknown" };
+    { "File", "Folder", "Version", "Double", "Int64", "Int32", "String", "InlineFile", "CompressedFile", "Unknown" };
 
     static_assert(!ar.at(std::variant_size_v<Variant> - 1).empty(), "Missing type name?");
     return ar.at(m_variant.index());
@@ -32,12 +32,14 @@ void TreeValue::toStream(ByteStringStream& bss) const
 {
     static_assert(sizeof(FileDescriptor) == 16);
     static_assert(sizeof(Version) == 12);
+    static_assert(sizeof(CompressedFile) == 24);
 
     auto index = static_cast<uint8_t>(m_variant.index());
     bss.push(index);
     std::visit(Overloaded
     { 
         [bss = &bss](const std::string& val) { bss->push(ByteStringView(val)); },
+        [bss = &bss](const InlineFile& val) { bss->push(ByteStringView(val.m_data)); },
         [bss = &bss](const auto& val) { bss->push(val); }
     }, m_variant);
 }
@@ -51,6 +53,7 @@ TreeValue TreeValue::fromStream(ByteStringView bsv)
     std::visit(Overloaded 
     { 
         [bsv](std::string& val) { val = std::string(bsv.data(), bsv.end()); }, 
+        [bsv](InlineFile& val) { val.m_data = std::string(bsv.data(), bsv.end()); },
         [bsv](auto& val) { ByteStringStream::pop(val, bsv); }
     }
     ,tv.m_variant);
@@ -36,18 +36,42 @@ struct Version
     }
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// Content of a small file stored directly in the directory entry.
+
+struct InlineFile
+{
+    std::string m_data;
+
+    bool operator==(const InlineFile& rhs) const { return m_data == rhs.m_data; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// File whose pages hold compressed chunks. m_fileSize is the size of the uncompressed content.
+
+struct CompressedFile
+{
+    FileDescriptor m_descriptor;
+    uint64_t m_fileSize = 0;
+
+    bool operator==(const CompressedFile& rhs) const
+    {
+        return m_descriptor == rhs.m_descriptor && m_fileSize == rhs.m_fileSize;
+    }
+};
+
 //////////////////////////////////////////////////////////////////////////
 
 class TreeValue final 
 {
 public:
-    enum class Type { File, Folder, Version, Double, Int64, Int32, String, Unknown };
+    enum class Type { File, Folder, Version, Double, Int64, Int32, String, InlineFile, CompressedFile, Unknown };
     struct Unknown
     {};
     friend bool operator==(const Unknown&, const Unknown&) { return false; }
 
 private:
-    using Variant = std::variant<FileDescriptor, Folder, Version, double, uint64_t, uint32_t, std::string, Unknown>;
+    using Variant = std::variant<FileDescriptor, Folder, Version, double, uint64_t, uint32_t, std::string, InlineFile, CompressedFile, Unknown>;
 
     template <typename T>
     using EnableVariantTypes = std::enable_if_t<std::is_convertible_v<T, Variant>>;
@@ -71,6 +95,10 @@ public:
 
     std::string_view getTypeName() const;
     Type getType() const { return static_cast<Type>(m_variant.index()); }
+    bool isFile() const
+    {
+        return getType() == Type::File || getType() == Type::InlineFile || getType() == Type::CompressedFile;
+    }
 
     template <typename T>
     T get() const
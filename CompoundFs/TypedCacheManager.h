@@ -56,6 +56,7 @@ public:
 
     FileInterface* getFileInterface() const { return m_cacheManager->getFileInterface(); }
     Interval allocatePageInterval(size_t maxPages) { return m_cacheManager->allocatePageInterval(maxPages); }
+    void addWrittenPages(Interval pages) { m_cacheManager->addWrittenPages(pages); }
 
 private:
     std::shared_ptr<CacheManager> m_cacheManager;
@@ -44,24 +44,45 @@ struct WrapOsCall
 
 constexpr auto GetFileSizeEx = WrapOsCall<::GetFileSizeEx>();
 constexpr auto CreateFile = WrapOsCall<::CreateFile>();
-constexpr auto SetFilePointerEx = WrapOsCall <::SetFilePointerEx>();
-constexpr auto SetEndOfFile = WrapOsCall<::SetEndOfFile>();
+constexpr auto SetFileInformationByHandle = WrapOsCall<::SetFileInformationByHandle>();
 constexpr auto WriteFile = WrapOsCall<::WriteFile>();
 constexpr auto ReadFile = WrapOsCall<::ReadFile>();
 constexpr auto FlushFileBuffers = WrapOsCall<::FlushFileBuffers>();
 constexpr auto GetFinalPathNameByHandle = WrapOsCall<::GetFinalPathNameByHandle>();
 
-void Seek(HANDLE handle, uint64_t position)
+// Sets the file size without moving the file pointer, so it does not interfere with ReadAt() and WriteAt()
+void SetFileSize(HANDLE handle, uint64_t size)
 {
-    LARGE_INTEGER pos;
-    pos.QuadPart = position;
-    Win32::SetFilePointerEx(handle, pos, nullptr, FILE_BEGIN);
+    FILE_END_OF_FILE_INFO info {};
+    info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    Win32::SetFileInformationByHandle(handle, FileEndOfFileInfo, &info, static_cast<DWORD>(sizeof(info)));
+}
+
+// Reads at position without relying on the file pointer, so reads on several threads do not interfere
+DWORD ReadAt(HANDLE handle, uint64_t position, void* buffer, DWORD size)
+{
+    OVERLAPPED overlapped {};
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    DWORD bytesRead;
+    Win32::ReadFile(handle, buffer, size, &bytesRead, &overlapped);
+    return bytesRead;
+}
+
+// Writes at position without relying on the file pointer, so writes on several threads do not interfere
+DWORD WriteAt(HANDLE handle, uint64_t position, const void* buffer, DWORD size)
+{
+    OVERLAPPED overlapped {};
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    DWORD bytesWritten;
+    Win32::WriteFile(handle, buffer, size, &bytesWritten, &overlapped);
+    return bytesWritten;
 }
 }
 
 namespace
 {
-constexpr uint64_t PageSize = 4096ULL;
 constexpr uint32_t BlockSize = 16 * 1024 * 1024;
 }
 
@@ -85,7 +106,7 @@ WindowsFile::WindowsFile(void* handle, bool readOnly)
         FileLockWindows { handle, FileLockPosition::WriteBegin, FileLockPosition::WriteEnd},
     }
 {
-    static constexpr int64_t MaxFileSize = 4096LL * int64_t(std::numeric_limits<uint32_t>::max() - 1LL);
+    static constexpr int64_t MaxFileSize = int64_t(PageSize) * int64_t(std::numeric_limits<uint32_t>::max() - 1LL);
     static_assert(MaxFileSize < FileLockPosition::GateBegin);
     static_assert(FileLockPosition::GateBegin < FileLockPosition::GateEnd);
     static_assert(MaxFileSize < FileLockPosition::SharedBegin);
@@ -171,8 +192,7 @@ Interval WindowsFile::newInterval(size_t maxPages)
 {
     LARGE_INTEGER size;
     Win32::GetFileSizeEx(m_handle, &size);
-    Win32::Seek(m_handle, PageSize * maxPages + size.QuadPart);
-    Win32::SetEndOfFile(m_handle);
+    Win32::SetFileSize(m_handle, PageSize * maxPages + size.QuadPart);
 
     return Interval(static_cast<PageIndex>(size.QuadPart / PageSize),
                     static_cast<PageIndex>(size.QuadPart / PageSize + maxPages));
@@ -185,9 +205,7 @@ const uint8_t* WindowsFile::writePage(PageIndex id, size_t pageOffset, const uin
     if (fileSizeInPages() <= id)
         throw std::runtime_error("WindowsFile::writePage outside file");
 
-    Win32::Seek(m_handle, PageSize * id + pageOffset);
-    DWORD bytesWritten;
-    Win32::WriteFile(m_handle, begin, static_cast<DWORD>(end - begin), &bytesWritten, nullptr);
+    Win32::WriteAt(m_handle, PageSize * id + pageOffset, begin, static_cast<DWORD>(end - begin));
 
     return end;
 }
@@ -197,20 +215,18 @@ const uint8_t* WindowsFile::writePages(Interval iv, const uint8_t* page)
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("WindowsFile::writePages outside file");
 
-    Win32::Seek(m_handle, PageSize * iv.begin());
     auto end = page + (iv.length() * PageSize);
-    writePagesInBlocks(page, end);
+    writePagesInBlocks(uint64_t(PageSize) * iv.begin(), page, end);
 
     return end;
 }
 
-void TxFs::WindowsFile::writePagesInBlocks(const uint8_t* begin, const uint8_t* end)
+void TxFs::WindowsFile::writePagesInBlocks(uint64_t position, const uint8_t* begin, const uint8_t* end)
 {
-    DWORD bytesWritten;
-    for (; (begin + BlockSize) < end; begin += BlockSize)
-        Win32::WriteFile(m_handle, begin, BlockSize, &bytesWritten, nullptr);
+    for (; (begin + BlockSize) < end; begin += BlockSize, position += BlockSize)
+        Win32::WriteAt(m_handle, position, begin, BlockSize);
 
-    Win32::WriteFile(m_handle, begin, static_cast<DWORD>(end - begin), &bytesWritten, nullptr);
+    Win32::WriteAt(m_handle, position, begin, static_cast<DWORD>(end - begin));
 }
 
 uint8_t* WindowsFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin, uint8_t* end) const
@@ -220,10 +236,7 @@ uint8_t* WindowsFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin,
     if (fileSizeInPages() <= id)
         throw std::runtime_error("WindowsFile::readPage outside file");
 
-    Win32::Seek(m_handle, PageSize * id + pageOffset);
-    DWORD bytesRead;
-    Win32::ReadFile(m_handle, begin, static_cast<DWORD>(end - begin), &bytesRead, nullptr);
-
+    DWORD bytesRead = Win32::ReadAt(m_handle, PageSize * id + pageOffset, begin, static_cast<DWORD>(end - begin));
     return begin + bytesRead;
 }
 
@@ -232,25 +245,19 @@ uint8_t* WindowsFile::readPages(Interval iv, uint8_t* page) const
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("WindowsFile::readPages outside file");
 
-    Win32::Seek(m_handle, PageSize * iv.begin());
     auto end = page + (iv.length() * PageSize);
-    size_t bytesRead = readPagesInBlocks(page, end);
+    size_t bytesRead = readPagesInBlocks(uint64_t(PageSize) * iv.begin(), page, end);
 
     return page + bytesRead;
 }
 
-size_t WindowsFile::readPagesInBlocks(uint8_t* begin, uint8_t* end) const
+size_t WindowsFile::readPagesInBlocks(uint64_t position, uint8_t* begin, uint8_t* end) const
 {
-    DWORD bytesRead;
     size_t totalBytesRead = 0;
-    for (; (begin + BlockSize) < end; begin += BlockSize)
-    {
-        Win32::ReadFile(m_handle, begin, BlockSize, &bytesRead, nullptr);
-        totalBytesRead += bytesRead;
-    }
+    for (; (begin + BlockSize) < end; begin += BlockSize, position += BlockSize)
+        totalBytesRead += Win32::ReadAt(m_handle, position, begin, BlockSize);
 
-    Win32::ReadFile(m_handle, begin, static_cast<DWORD>(end - begin), &bytesRead, nullptr);
-    return totalBytesRead + bytesRead;
+    return totalBytesRead + Win32::ReadAt(m_handle, position, begin, static_cast<DWORD>(end - begin));
 }
 
 size_t WindowsFile::fileSizeInPages() const
@@ -268,8 +275,7 @@ void WindowsFile::flushFile()
 
 void WindowsFile::truncate(size_t numberOfPages)
 {
-    Win32::Seek(m_handle, PageSize * numberOfPages);
-    Win32::SetEndOfFile(m_handle);
+    Win32::SetFileSize(m_handle, uint64_t(PageSize) * numberOfPages);
 }
 
 Lock WindowsFile::defaultAccess()
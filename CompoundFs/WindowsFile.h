@@ -41,8 +41,8 @@ public:
 private:
     WindowsFile(void* handle, bool readOnly);
     static void* open(std::filesystem::path path, OpenMode mode);
-    void writePagesInBlocks(const uint8_t* begin, const uint8_t* end);
-    size_t readPagesInBlocks(uint8_t* begin, uint8_t* end) const;
+    void writePagesInBlocks(uint64_t position, const uint8_t* begin, const uint8_t* end);
+    size_t readPagesInBlocks(uint64_t position, uint8_t* begin, uint8_t* end) const;
 
 private:
     void* m_handle;
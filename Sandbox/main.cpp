@@ -728,11 +728,85 @@ static_assert(!TupleLike<std::variant<int, double>>);
 static_assert(!TupleLike<int[3]>);
 
 
+//int main()
+//{
+//    std::tuple<int, double> t {};
+//    auto v = std::get<0>(t);
+//
+//}
+
+#include "CompoundFs/FileSystem.h"
+#include "CompoundFs/MemoryFile.h"
+#include <chrono>
+
+// Write/read throughput and compression ratio of compressed vs. plain files on a MemoryFile.
+void compressionBenchmark(TxFs::Compression compression, const std::string& data)
+{
+    using namespace TxFs;
+    using Clock = std::chrono::steady_clock;
+
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+
+    auto start = Clock::now();
+    auto writeHandle = *fs.createFile("bench.dat", compression);
+    for (size_t pos = 0; pos < data.size(); pos += 16 * PageSize)
+        fs.write(writeHandle, data.data() + pos, std::min(16 * PageSize, data.size() - pos));
+    fs.commit();
+    auto written = Clock::now();
+
+    std::string readBack(data.size(), ' ');
+    auto readHandle = *fs.readFile("bench.dat");
+    fs.read(readHandle, readBack.data(), readBack.size());
+    auto read = Clock::now();
+
+    auto value = fs.find("bench.dat").value();
+    auto storedSize = value.getType() == TreeValue::Type::CompressedFile
+                          ? value.get<CompressedFile>().m_descriptor.m_fileSize
+                          : value.get<FileDescriptor>().m_fileSize;
+
+    auto mbPerSec = [&](auto duration) {
+        return data.size() / std::chrono::duration<double>(duration).count() / (1024. * 1024.);
+    };
+    std::cout << (compression == Compression::Lz4 ? "lz4 " : "none") << "  write " << mbPerSec(written - start)
+              << " MB/s  read " << mbPerSec(read - written) << " MB/s  ratio "
+              << double(data.size()) / storedSize << (readBack == data ? "" : "  MISMATCH") << "\n";
+}
+
+// Commit latency for a transaction with many new metadata pages depending on the number of checksum threads.
+void commitBenchmark(uint32_t threads)
+{
+    using namespace TxFs;
+    using Clock = std::chrono::steady_clock;
+
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>(), 100000);
+    cm->setChecksumThreads(threads);
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.commit();
+
+    // the longest value stored in the leaf itself: longer ones go to overflow files
+    std::string value(TreeValue::maxVariableSize(), 'v');
+    for (int i = 0; i < 100000; i++)
+        fs.addAttribute(Path("attribute" + std::to_string(i)), value);
+
+    auto start = Clock::now();
+    fs.commit();
+    auto duration = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "threads " << threads << "  commit " << duration << " ms\n";
+}
+
 int main()
 {
-    std::tuple<int, double> t {};
-    auto v = std::get<0>(t);
+    for (uint32_t threads: { 1, 2, 4, 8 })
+        commitBenchmark(threads);
+
+    std::string data;
+    for (int i = 0; data.size() < 64 * 1024 * 1024; i++)
+        data += "2021-03-04 12:00:" + std::to_string(i % 60) + " sensor " + std::to_string(i % 17) +
+                " value=" + std::to_string((i * 7919) % 1000) + "\n";
 
+    compressionBenchmark(TxFs::Compression::None, data);
+    compressionBenchmark(TxFs::Compression::Lz4, data);
 }
 
 
@@ -161,11 +161,11 @@ TYPED_TEST_P(DiskFileTester, readOnlyFileThrowsOnWriteOps)
 TYPED_TEST_P(DiskFileTester, canReadWriteBigPages)
 {
     // File.cpp BlockSize=16MegaByte
-    std::vector<uint64_t> out((16 * 3 * 1024 * 1024 - 4096) / sizeof(uint64_t));
+    std::vector<uint64_t> out((16 * 3 * 1024 * 1024 - PageSize) / sizeof(uint64_t));
     std::iota(out.begin(), out.end(), 0);
 
     TypeParam file(this->m_tempFileName, OpenMode::CreateAlways);
-    auto iv = file.newInterval(out.size() * sizeof(uint64_t) / 4096);
+    auto iv = file.newInterval(out.size() * sizeof(uint64_t) / PageSize);
     file.writePages(iv, (const uint8_t*) out.data());
 
     std::vector<uint64_t> in(out.size());
@@ -186,7 +186,7 @@ TYPED_TEST_P(DiskFileTester, readPageOverEndOfFileReturnsBufferPosition)
     this->prepareFileWithContents(data);
     TypeParam file(this->m_tempFileName, OpenMode::ReadOnly);
 
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     ASSERT_EQ(file.readPage(0, 0, buf, buf + sizeof(buf)), buf + data.size());
 }
 
@@ -196,7 +196,7 @@ TYPED_TEST_P(DiskFileTester, readPagesOverEndOfFileReturnsBufferPosition)
     this->prepareFileWithContents(data);
     TypeParam file(this->m_tempFileName, OpenMode::ReadOnly);
 
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     ASSERT_EQ(file.readPages(Interval(0, 1), buf), buf + data.size()); // different api than previous test
 }
 
@@ -2,7 +2,10 @@
 #pragma once
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "CompoundFs/ByteString.h"
 #include "CompoundFs/FileIo.h"
@@ -50,7 +53,7 @@ TYPED_TEST_P(FileInterfaceTester, truncateReducesFileSize)
 
 TYPED_TEST_P(FileInterfaceTester, readWriteOutsideCurrentFileSizeThrows)
 {
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     this->m_fileInterface->newInterval(5);
 
     ASSERT_THROW(this->m_fileInterface->readPage(5, 0, buf, buf + 1), std::exception);
@@ -61,22 +64,22 @@ TYPED_TEST_P(FileInterfaceTester, readWriteOutsideCurrentFileSizeThrows)
 
 TYPED_TEST_P(FileInterfaceTester, readWritePageOverPageBounderiesThrows)
 {
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     this->m_fileInterface->newInterval(5);
 
-    ASSERT_THROW(this->m_fileInterface->readPage(1, 4095, buf, buf + 2), std::exception);
-    ASSERT_THROW(this->m_fileInterface->writePage(1, 4095, buf, buf + 2), std::exception);
+    ASSERT_THROW(this->m_fileInterface->readPage(1, PageSize - 1, buf, buf + 2), std::exception);
+    ASSERT_THROW(this->m_fileInterface->writePage(1, PageSize - 1, buf, buf + 2), std::exception);
 }
 
 TYPED_TEST_P(FileInterfaceTester, readPagesReturnsDataOfWritePages)
 {
-    std::string outString(3 * 4096, 'X');
+    std::string outString(3 * PageSize, 'X');
     auto begin = (uint8_t*) outString.data();
     this->m_fileInterface->newInterval(5);
 
     ASSERT_EQ(this->m_fileInterface->writePages(Interval(1, 4), begin), begin + outString.size());
 
-    std::string inString(3 * 4096, 'Y');
+    std::string inString(3 * PageSize, 'Y');
     begin = (uint8_t*) inString.data();
     ASSERT_EQ(this->m_fileInterface->readPages(Interval(1, 4), begin), begin + inString.size());
     ASSERT_EQ(inString, outString);
@@ -84,7 +87,7 @@ TYPED_TEST_P(FileInterfaceTester, readPagesReturnsDataOfWritePages)
 
 TYPED_TEST_P(FileInterfaceTester, readPageReturnsDataOfWritePage)
 {
-    std::string outString(3 * 4096, 'X');
+    std::string outString(3 * PageSize, 'X');
     auto begin = (uint8_t*) outString.data();
     this->m_fileInterface->newInterval(5);
     this->m_fileInterface->writePages(Interval(1, 4), begin);
@@ -101,16 +104,44 @@ TYPED_TEST_P(FileInterfaceTester, readPageReturnsDataOfWritePage)
     ASSERT_EQ(this->m_fileInterface->readPage(2, 100, in, in + sizeof(in)), in + sizeof(in));
     ASSERT_EQ("0123456789X", ByteStringView(in, sizeof(in)));
 
-    ASSERT_EQ(this->m_fileInterface->readPage(3, 4096 - 11, in, in + sizeof(in)), in + sizeof(in));
+    ASSERT_EQ(this->m_fileInterface->readPage(3, PageSize - 11, in, in + sizeof(in)), in + sizeof(in));
     ASSERT_EQ("XXXXXXXXXXX", ByteStringView(in, sizeof(in)));
-    ASSERT_EQ(this->m_fileInterface->writePage(3, 4096 - 10, out.data(), out.end()), out.end());
-    ASSERT_EQ(this->m_fileInterface->readPage(3, 4096 - 11, in, in + sizeof(in)), in + sizeof(in));
+    ASSERT_EQ(this->m_fileInterface->writePage(3, PageSize - 10, out.data(), out.end()), out.end());
+    ASSERT_EQ(this->m_fileInterface->readPage(3, PageSize - 11, in, in + sizeof(in)), in + sizeof(in));
     ASSERT_EQ("X0123456789", ByteStringView(in, sizeof(in)));
 }
 
+TYPED_TEST_P(FileInterfaceTester, concurrentReadsAndWritesOfDistinctPages)
+{
+    constexpr PageIndex pagesPerThread = 64;
+    constexpr PageIndex numberOfThreads = 4;
+    auto file = this->m_fileInterface;
+    file->newInterval(pagesPerThread * numberOfThreads);
+
+    std::vector<std::thread> threads;
+    for (PageIndex t = 0; t < numberOfThreads; t++)
+        threads.emplace_back([=] {
+            std::vector<uint8_t> page(PageSize);
+            for (PageIndex i = t; i < pagesPerThread * numberOfThreads; i += numberOfThreads)
+            {
+                std::fill(page.begin(), page.end(), uint8_t(i));
+                file->writePages(Interval(i), page.data());
+                file->readPage(i, 0, page.data(), page.data() + PageSize);
+                ASSERT_EQ(page.front(), uint8_t(i));
+            }
+        });
+    for (auto& thread: threads)
+        thread.join();
+
+    std::vector<uint8_t> pages(size_t(pagesPerThread) * numberOfThreads * PageSize);
+    file->readPages(Interval(0, pagesPerThread * numberOfThreads), pages.data());
+    for (size_t i = 0; i < pages.size(); i += PageSize)
+        ASSERT_TRUE(std::all_of(&pages[i], &pages[i] + PageSize, [=](uint8_t b) { return b == uint8_t(i / PageSize); }));
+}
+
 REGISTER_TYPED_TEST_SUITE_P(FileInterfaceTester, newlyCreatedFileIsEmpty, newIntervalReturnsCorrespondingInterval,
                             truncateReducesFileSize, readWriteOutsideCurrentFileSizeThrows,
                             readWritePageOverPageBounderiesThrows, readPagesReturnsDataOfWritePages,
-                            readPageReturnsDataOfWritePage);
+                            readPageReturnsDataOfWritePage, concurrentReadsAndWritesOfDistinctPages);
 
 }
@@ -256,40 +256,42 @@ TEST(BTree, removeOfSomeValuesLeavesTheOthersIntact)
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     BTree bt(cm);
 
+    // the same number of leaves at every page size
+    constexpr size_t scale = PageSize / 4096;
     std::vector<std::string> keys;
 
-    keys.reserve(3000);
-    for (size_t i = 0; i < 3000; i++)
+    keys.reserve(3000 * scale);
+    for (size_t i = 0; i < 3000 * scale; i++)
     {
         keys.push_back(std::to_string(i));
         bt.insert(keys.back().c_str(), keys.back().c_str());
     }
 
     std::shuffle(keys.begin(), keys.end(), std::mt19937(std::random_device()()));
-    for (size_t i = 1000; i < 3000; i++)
+    for (size_t i = 1000 * scale; i < 3000 * scale; i++)
     {
         auto res = bt.remove(keys[i].c_str());
         ASSERT_TRUE(res);
     }
     TxFs::clearPages(cm->getFileInterface(), bt.getFreePages());
 
-    for (size_t i = 0; i < 1000; i++)
+    for (size_t i = 0; i < 1000 * scale; i++)
     {
         auto res = bt.find(keys[i].c_str());
         ASSERT_TRUE(res);
     }
 
-    for (size_t i = 1000; i < 3000; i++)
+    for (size_t i = 1000 * scale; i < 3000 * scale; i++)
     {
         auto res = bt.find(keys[i].c_str());
         ASSERT_TRUE(!res);
     }
 
-    std::sort(keys.begin(), keys.begin() + 1000);
+    std::sort(keys.begin(), keys.begin() + 1000 * scale);
 
     // make sure at least one page is completely empty
     auto size = bt.getFreePages().size();
-    for (size_t i = 800; i < 1000; i++)
+    for (size_t i = 800 * scale; i < 1000 * scale; i++)
     {
         auto res = bt.remove(keys[i].c_str());
         ASSERT_TRUE(res);
@@ -298,7 +300,7 @@ TEST(BTree, removeOfSomeValuesLeavesTheOthersIntact)
     clearPages(cm->getFileInterface(), bt.getFreePages());
 
     auto cursor = bt.begin("");
-    for (size_t i = 0; i < 800; i++)
+    for (size_t i = 0; i < 800 * scale; i++)
     {
         ASSERT_EQ(cursor.key() , keys[i]);
         cursor = bt.next(cursor);
@@ -518,3 +520,135 @@ TEST(BTree, interruptedVisit)
     }));
     ASSERT_EQ(nodes, 5);
 }
+
+TEST(BTree, findManyReturnsCursorsInInputOrder)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (size_t i = 0; i < 3000; i++)
+    {
+        auto key = std::to_string(i);
+        bt.insert(key, key + " Test");
+    }
+
+    std::vector<std::string> keys { "2999", "0", "gaga", "1500", "1500", "17", "" };
+    std::vector<ByteStringView> views(keys.begin(), keys.end());
+    auto cursors = bt.findMany(views);
+
+    ASSERT_EQ(cursors.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(cursors[i], bt.find(keys[i]));
+    ASSERT_EQ(cursors[0].value(), "2999 Test");
+    ASSERT_FALSE(cursors[2]);
+    ASSERT_FALSE(cursors[6]);
+}
+
+TEST(BTree, findManyFindsAllKeysOfABigTree)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < MANYITERATION; i++)
+    {
+        keys.push_back(std::to_string(i));
+        bt.insert(keys.back(), keys.back());
+    }
+
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(std::random_device()()));
+    std::vector<ByteStringView> views(keys.begin(), keys.end());
+    auto cursors = bt.findMany(views);
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(cursors[i].key(), keys[i]);
+}
+
+TEST(BTree, removeRangeRemovesOnlyKeysInRange)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 10000; i++)
+    {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "%05zu", i);
+        keys.push_back(buf);
+        bt.insert(keys.back(), keys.back());
+    }
+
+    auto nofRemoved = bt.removeRange("01000", "08500");
+    ASSERT_EQ(nofRemoved, 7500U);
+    ASSERT_FALSE(bt.getFreePages().empty());
+    clearPages(cm->getFileInterface(), bt.getFreePages());
+
+    auto cursor = bt.begin("");
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (i >= 1000 && i < 8500)
+            continue;
+        ASSERT_EQ(cursor.key(), keys[i]);
+        cursor = bt.next(cursor);
+    }
+    ASSERT_FALSE(cursor);
+
+    ASSERT_EQ(bt.removeRange("01000", "08500"), 0U);
+    ASSERT_EQ(bt.removeRange("08500", "00000"), 0U);
+}
+
+TEST(BTree, removeRangeOfAllKeysLeavesTreeEmpty)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (uint32_t i = 0; i < MANYITERATION; i++)
+    {
+        auto key = std::to_string(i);
+        bt.insert(key, key);
+    }
+    auto size = cm->getFileInterface()->fileSizeInPages();
+
+    ASSERT_EQ(bt.removeRange("", "a"), size_t(MANYITERATION));
+    ASSERT_TRUE(!bt.begin(""));
+    ASSERT_EQ(bt.getFreePages().size(), size);
+}
+
+TEST(BTree, removeRangeAllowsFurtherInserts)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 5000; i++)
+    {
+        keys.push_back(std::to_string(i));
+        bt.insert(keys.back(), keys.back());
+    }
+
+    bt.removeRange("2", "4");
+    for (const auto& key: keys)
+        bt.insert(key, key);
+    for (const auto& key: keys)
+        ASSERT_EQ(bt.find(key).value(), key);
+}
+
+TEST(BTree, visitRangeVisitsKeysInRangeInOrder)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (size_t i = 0; i < 3000; i++)
+    {
+        auto key = std::to_string(i);
+        bt.insert(key, key + " Test");
+    }
+
+    std::vector<std::string> visited;
+    ASSERT_TRUE(bt.visitRange("12", "13", [&visited](ByteStringView key, ByteStringView value) {
+        visited.emplace_back(reinterpret_cast<const char*>(key.data()), key.size());
+        EXPECT_EQ(value, visited.back() + " Test");
+        return true;
+    }));
+    ASSERT_EQ(visited.size(), 111U);
+    ASSERT_TRUE(std::is_sorted(visited.begin(), visited.end()));
+    ASSERT_EQ(visited.front(), "12");
+    ASSERT_EQ(visited.back(), "1299");
+
+    size_t count = 0;
+    ASSERT_FALSE(bt.visitRange("", "z", [&count](ByteStringView, ByteStringView) { return ++count < 10; }));
+    ASSERT_EQ(count, 10U);
+}
@@ -7,6 +7,8 @@
 #include "CompoundFs/CommitHandler.h"
 #include "CompoundFs/RollbackHandler.h"
 #include <algorithm>
+#include <random>
+#include <thread>
 
 using namespace TxFs;
 
@@ -21,7 +23,7 @@ namespace
 
     void writeFirstByteFromPage(FileInterface* fi, PageIndex idx, uint8_t val)
     {
-        uint8_t page[4096];
+        uint8_t page[PageSize];
         page[0] = val;
         writeSignedPage(fi, idx, page);
     }
@@ -190,6 +192,95 @@ TEST(CacheManager, dirtyPagesCanBeEvictedAndReadInAgain)
     }
 }
 
+TEST(CacheManager, cacheGrowsWithinBudgetWhileDirtyPagesAreDiverted)
+{
+    std::unique_ptr<FileInterface> file = std::make_unique<MemoryFile>();
+    {
+        CacheManager cm(std::move(file));
+        for (int i = 0; i < 200; i++)
+            *cm.newPage().m_page = uint8_t(i);
+        cm.trim(0);
+        file = cm.handOverFile();
+    }
+
+    CacheManager cm(std::move(file), CacheBudget::adaptive(16 * PageSize, 64 * PageSize));
+    ASSERT_EQ(cm.maxCachedPages(), 16U);
+    for (int i = 0; i < 200; i++)
+        *cm.makePageWritable(cm.loadPage(i)).m_page = uint8_t(i + 1);
+    ASSERT_EQ(cm.maxCachedPages(), 64U);
+
+    for (int i = 0; i < 200; i++)
+        ASSERT_EQ(*cm.loadPage(i).m_page, uint8_t(i + 1));
+
+    cm.releaseMemory();
+    ASSERT_EQ(cm.maxCachedPages(), 16U);
+
+    cm.setCacheBudget(CacheBudget::fixed(8 * PageSize));
+    ASSERT_EQ(cm.maxCachedPages(), 8U);
+    ASSERT_EQ(cm.trim(100), 8U);
+}
+
+TEST(CacheManager, cachePoolIsSharedFairly)
+{
+    auto makeFile = [] {
+        CacheManager cm(std::make_unique<MemoryFile>());
+        for (int i = 0; i < 100; i++)
+            *cm.newPage().m_page = uint8_t(i);
+        cm.trim(0);
+        return cm.handOverFile();
+    };
+
+    auto pool = std::make_shared<CachePool>(64 * PageSize);
+    CacheManager busy(makeFile(), CacheBudget::shared(pool));
+    for (int i = 0; i < 60; i++)
+        busy.loadPage(i);
+    ASSERT_EQ(pool->cachedPages(), 60U);
+    ASSERT_FALSE(pool->exceeded());
+
+    {
+        CacheManager other(makeFile(), CacheBudget::shared(pool));
+        ASSERT_EQ(pool->members(), 2U);
+        for (int i = 0; i < 60; i++)
+            ASSERT_EQ(*other.loadPage(i).m_page, uint8_t(i));
+        ASSERT_LE(other.trim(100), pool->fairShare());
+
+        busy.loadPage(60);
+        ASSERT_LE(busy.trim(100), pool->fairShare());
+        ASSERT_LE(pool->cachedPages(), pool->maxPages());
+    }
+    ASSERT_EQ(pool->members(), 1U);
+    ASSERT_EQ(pool->cachedPages(), busy.trim(100));
+}
+
+TEST(CacheManager, idlePoolMembersAreAskedToGiveTheirPagesBack)
+{
+    auto makeFile = [] {
+        CacheManager cm(std::make_unique<MemoryFile>());
+        for (int i = 0; i < 100; i++)
+            *cm.newPage().m_page = uint8_t(i);
+        cm.trim(0);
+        return cm.handOverFile();
+    };
+
+    auto pool = std::make_shared<CachePool>(64 * PageSize, std::chrono::milliseconds(10));
+    CacheManager idle(makeFile(), CacheBudget::shared(pool));
+    for (int i = 0; i < 60; i++)
+        idle.loadPage(i);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    CacheManager busy(makeFile(), CacheBudget::shared(pool));
+    for (int i = 0; i < 45; i++)
+        busy.loadPage(i);
+    ASSERT_TRUE(pool->exceeded());
+    ASSERT_EQ(idle.trim(100), 60U);
+
+    idle.checkCachePool();
+    ASSERT_LE(idle.trim(100), CachePool::MinPages);
+    ASSERT_EQ(busy.trim(100), 45U);
+    ASSERT_GT(busy.trim(100), pool->fairShare());
+    ASSERT_FALSE(pool->exceeded());
+}
+
 TEST(CacheManager, asNewPageIsNotFollowingDirtyPageProtocol)
 {
     std::unique_ptr<FileInterface> file = std::make_unique<MemoryFile>();
@@ -332,6 +423,31 @@ TEST(CacheManager, setPageIntervalAllocator)
     ASSERT_THROW(cm.trim(0), std::exception);
 }
 
+TEST(CacheManager, handedOutPagesDropTheirPrefetchedContents)
+{
+    std::unique_ptr<FileInterface> file;
+    std::vector<std::pair<PageIndex, uint32_t>> hotPages;
+    {
+        CacheManager cm(std::make_unique<MemoryFile>());
+        for (int i = 0; i < 10; i++)
+            *cm.newPage().m_page = uint8_t(i);
+        cm.getCommitHandler().commit();
+        cm.trackPageLoads(true);
+        cm.loadPage(5);
+        hotPages = cm.hotPages(10);
+        file = cm.handOverFile();
+    }
+
+    // page 5 got freed after the snapshot and takes the evicted Dirty page 2
+    CacheManager cm(std::move(file));
+    ASSERT_EQ(cm.prefetch(hotPages), 1U);
+    auto prefetched = cm.loadPage(5);
+    cm.setPageIntervalAllocator([](size_t) { return Interval(5); });
+    *cm.makePageWritable(cm.loadPage(2)).m_page = 42;
+    cm.trim(0);
+    ASSERT_EQ(*cm.loadPage(2).m_page, 42);
+}
+
 TEST(CacheManager, NoLogsReturnEmpty)
 {
     CacheManager cm(std::make_unique<MemoryFile>());
@@ -354,3 +470,28 @@ TEST(CacheManager, ReadLogsReturnTheLogs)
     std::sort(logs2.begin(), logs2.end());
     ASSERT_EQ(logs , logs2);
 }
+
+TEST(CacheManager, revertPartialCommitRestoresLoggedPages)
+{
+    CacheManager cm(std::make_unique<MemoryFile>());
+    for (int i = 0; i < 350; i++)
+        *cm.newPage().m_page = uint8_t(i);
+    cm.trim(0);
+
+    // 100 copies in one block and 50 scattered ones, kept apart from the originals like in a real log
+    std::vector<std::pair<PageIndex, PageIndex>> logs;
+    for (PageIndex i = 0; i < 100; i++)
+        logs.emplace_back(i, 200 + i);
+    for (PageIndex i = 0; i < 50; i++)
+        logs.emplace_back(100 + 2 * i, 349 - i);
+    std::shuffle(logs.begin(), logs.end(), std::mt19937(42));
+    cm.getCommitHandler().writeLogs(logs);
+
+    cm.getRollbackHandler().revertPartialCommit();
+    for (auto [orig, cpy]: logs)
+    {
+        uint8_t buffer[PageSize];
+        TxFs::readSignedPage(cm.getFileInterface(), orig, buffer);
+        ASSERT_EQ(*buffer, uint8_t(cpy));
+    }
+}
@@ -4,6 +4,7 @@
 #include "CompoundFs/MemoryFile.h"
 #include "CompoundFs/CacheManager.h"
 #include "CompoundFs/CommitHandler.h"
+#include "CompoundFs/RollbackHandler.h"
 #include <random>
 #include <numeric>
 #include "CompoundFs/FileIo.h"
@@ -89,7 +90,7 @@ TEST(CommitHandler, copyDirtyPagesMakesACopyOfTheOriginalPage)
     {
         ASSERT_NE(orig , cpy);
         ASSERT_TRUE(TxFs::isEqualPage(cm.getFileInterface(), orig, cpy));
-        uint8_t buffer[4096];
+        uint8_t buffer[PageSize];
         TxFs::readSignedPage(cm.getFileInterface(), orig, buffer);
         ASSERT_TRUE(*buffer < 100);
     }
@@ -133,8 +134,154 @@ TEST(CommitHandler, updateDirtyPagesChangesOriginalPages)
     // do the test...
     for (auto orig: dirtyPageIds)
     {
-        uint8_t buffer[4096];
+        uint8_t buffer[PageSize];
         TxFs::readSignedPage(cm.getFileInterface(), orig, buffer);
         ASSERT_TRUE(*buffer > 100);
     }
 }
+
+TEST(CommitHandler, commitSignsPagesOnSeveralThreads)
+{
+    std::unique_ptr<FileInterface> file = std::make_unique<MemoryFile>();
+    {
+        CacheManager cm(std::move(file), 2000);
+        for (int i = 0; i < 1000; i++)
+            *cm.newPage().m_page = uint8_t(i);
+        cm.getCommitHandler().commit();
+        file = cm.handOverFile();
+    }
+
+    CacheManager cm(std::move(file), 2000);
+    cm.setChecksumThreads(4);
+    for (int i = 0; i < 1000; i += 2)
+        *cm.makePageWritable(cm.loadPage(i)).m_page += 1;
+    for (int i = 0; i < 500; i++)
+        *cm.newPage().m_page = uint8_t(i);
+    cm.getCommitHandler().commit();
+
+    for (int i = 0; i < 1500; i++)
+    {
+        uint8_t buffer[PageSize];
+        TxFs::readSignedPage(cm.getFileInterface(), i, buffer);
+        ASSERT_EQ(*buffer, i < 1000 ? uint8_t(i + (i % 2 ? 0 : 1)) : uint8_t(i - 1000));
+    }
+}
+
+namespace
+{
+std::unique_ptr<FileInterface> fiftyNumberedPages()
+{
+    CacheManager cm(std::make_unique<MemoryFile>());
+    for (int i = 0; i < 50; i++)
+        *cm.newPage().m_page = uint8_t(i);
+    cm.getCommitHandler().commit();
+    return cm.handOverFile();
+}
+
+// 5 pages are new, 10 dirty pages get diverted and 10 stay in the cache
+void makeRedoTransaction(CacheManager& cm)
+{
+    for (int i = 50; i < 55; i++)
+        *cm.newPage().m_page = uint8_t(i);
+    for (int i = 10; i < 20; i++)
+        *cm.makePageWritable(cm.loadPage(i)).m_page += 100;
+    cm.trim(0);
+    for (int i = 20; i < 30; i++)
+        *cm.makePageWritable(cm.loadPage(i)).m_page += 100;
+}
+
+uint8_t expectedAfterRedoTransaction(int i)
+{
+    return uint8_t(i >= 10 && i < 30 ? i + 100 : i);
+}
+}
+
+TEST(CommitHandler, redoLoggedCommitNeedsTwoFlushes)
+{
+    CacheManager cm(fiftyNumberedPages());
+    cm.setCommitProtocol(CommitProtocol::Redo);
+    makeRedoTransaction(cm);
+    cm.resetStatistics();
+    cm.getCommitHandler().commit();
+
+    ASSERT_EQ(cm.statistics().m_flushes, 2U);
+    ASSERT_EQ(cm.getFileInterface()->fileSizeInPages(), 65U); // the diverted pages are not freed here
+    for (int i = 0; i < 55; i++)
+        ASSERT_EQ(*cm.loadPage(i).m_page, expectedAfterRedoTransaction(i));
+}
+
+TEST(CommitHandler, completeRedoLogIsReplayed)
+{
+    std::unique_ptr<FileInterface> file;
+    {
+        CacheManager cm(fiftyNumberedPages());
+        makeRedoTransaction(cm);
+        auto commitHandler = cm.getCommitHandler();
+        auto dirtyPageIds = commitHandler.getDirtyPageIds();
+        commitHandler.signCachedPages();
+        commitHandler.writeNewPages();
+        auto redoLog = commitHandler.writeDirtyPageImages(dirtyPageIds);
+        commitHandler.logNewPages(redoLog);
+        commitHandler.writeRedoLogs(redoLog);
+        file = cm.handOverFile(); // crash before the originals are overwritten
+    }
+
+    CacheManager cm(std::move(file));
+    ASSERT_EQ(cm.getRollbackHandler().readLogs().size(), 20U);
+    cm.getRollbackHandler().revertPartialCommit();
+    for (int i = 0; i < 55; i++)
+        ASSERT_EQ(*cm.loadPage(i).m_page, expectedAfterRedoTransaction(i));
+}
+
+TEST(CommitHandler, redoLogWithLostNewPageIsIgnored)
+{
+    std::unique_ptr<FileInterface> file;
+    {
+        CacheManager cm(fiftyNumberedPages());
+        makeRedoTransaction(cm);
+        auto commitHandler = cm.getCommitHandler();
+        auto dirtyPageIds = commitHandler.getDirtyPageIds();
+        commitHandler.signCachedPages();
+        commitHandler.writeNewPages();
+        auto redoLog = commitHandler.writeDirtyPageImages(dirtyPageIds);
+        commitHandler.logNewPages(redoLog);
+        commitHandler.writeRedoLogs(redoLog);
+        file = cm.handOverFile();
+    }
+
+    // the new page 50 did not make it to the disk: replaying the log would install a tree pointing to it
+    uint8_t zeros[PageSize] = {};
+    file->writePage(50, 0, zeros, zeros + PageSize);
+
+    CacheManager cm(std::move(file));
+    ASSERT_TRUE(cm.getRollbackHandler().readLogs().empty());
+}
+
+TEST(CommitHandler, incompleteRedoLogIsIgnored)
+{
+    std::unique_ptr<FileInterface> file;
+    PageIndex lostPage;
+    {
+        CacheManager cm(fiftyNumberedPages());
+        makeRedoTransaction(cm);
+        auto commitHandler = cm.getCommitHandler();
+        auto dirtyPageIds = commitHandler.getDirtyPageIds();
+        commitHandler.signCachedPages();
+        commitHandler.writeNewPages();
+        auto redoLog = commitHandler.writeDirtyPageImages(dirtyPageIds);
+        commitHandler.logNewPages(redoLog);
+        commitHandler.writeRedoLogs(redoLog);
+        lostPage = redoLog.front()[1];
+        file = cm.handOverFile();
+    }
+
+    // one of the new page contents did not make it to the disk
+    uint8_t zeros[PageSize] = {};
+    file->writePage(lostPage, 0, zeros, zeros + PageSize);
+
+    CacheManager cm(std::move(file));
+    ASSERT_TRUE(cm.getRollbackHandler().readLogs().empty());
+    cm.getRollbackHandler().revertPartialCommit();
+    for (int i = 10; i < 30; i++)
+        ASSERT_EQ(*cm.loadPage(i).m_page, uint8_t(i));
+}
@@ -12,6 +12,7 @@
 #include "CompoundFs/TempFile.h"
 
 #include <fstream>
+#include <algorithm>
 #include <thread>
 
 using namespace TxFs;
@@ -36,6 +37,19 @@ TEST(Composite, canReopenFile)
     ASSERT_EQ(fsys.getAttribute("test")->get<std::string>(), "test");
 }
 
+TEST(Composite, openTakesCacheBudget)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    {
+        auto fsys = Composite::open<WrappedFile>(CacheBudget::fixed(1 << 20), file);
+        fsys.addAttribute("test", "test");
+        fsys.commit();
+    }
+
+    auto fsys = Composite::openReadOnly<WrappedFile>(CacheBudget::adaptive(64 * PageSize, 1 << 24), file);
+    ASSERT_EQ(fsys.getAttribute("test")->get<std::string>(), "test");
+}
+
 TEST(Composite, openDoesRollback)
 {
     std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
@@ -64,6 +78,30 @@ TEST(Composite, openNonTxFsFileThrows)
     ASSERT_THROW(Composite::open<WrappedFile>(file), std::exception);
 }
 
+TEST(Composite, openFileOfOtherPageSizeThrows)
+{
+    // a first page signed like a build with another page size would sign it
+    const size_t otherPageSize = PageSize == MinPageSize ? 2 * PageSize : PageSize / 2;
+    std::vector<uint8_t> page(std::max(otherPageSize, PageSize), 'X');
+    uint32_t checkSum = hash32(page.data(), otherPageSize - sizeof(checkSum));
+    memcpy(page.data() + otherPageSize - sizeof(checkSum), &checkSum, sizeof(checkSum));
+
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    file->newInterval(page.size() / PageSize);
+    for (size_t i = 0; i < page.size() / PageSize; i++)
+        file->writePage(PageIndex(i), 0, page.data() + i * PageSize, page.data() + (i + 1) * PageSize);
+
+    ASSERT_THROW(Composite::open<WrappedFile>(file), std::runtime_error);
+    ASSERT_THROW(Composite::openReadOnly<WrappedFile>(file), std::runtime_error);
+}
+
+TEST(Composite, probeFindsPageSizeOfFile)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    Composite::open<WrappedFile>(file);
+    ASSERT_EQ(probeSignedPageSize(file.get()), PageSize);
+}
+
 struct CompositeTester : ::testing::Test
 {
     using MemoryFile = LockedMemoryFile<DebugSharedLock, DebugSharedLock>;
@@ -251,6 +289,23 @@ TEST_F(CompositeTester, CrashCommitFileProvidesReplacedDirtyPages)
         ASSERT_FALSE(TxFs::isEqualPage(m_file.get(), orig, cpy));
 }
 
+TEST_F(CompositeTester, DestructionAfterCommitAsyncReportsTheLostTransaction)
+{
+    std::exception_ptr error;
+    {
+        auto fsys = Composite::open<CrashCommitFile>(m_file);
+        fsys.setCommitErrorHandler([&](std::exception_ptr e) { error = e; });
+        fsys.remove("test");
+        fsys.commitAsync();
+    }
+
+    ASSERT_TRUE(error);
+    ASSERT_THROW(std::rethrow_exception(error), CrashCommitFile::Exception);
+    auto fsys = Composite::open<WrappedFile>(m_file);
+    ASSERT_TRUE(fsys.getAttribute("test/attribute"));
+    m_helper.checkFileSystem(fsys);
+}
+
 TEST_F(CompositeTester, RollbackFromCrashedCommit)
 {
     {
@@ -279,6 +334,23 @@ TEST_F(CompositeTester, ReadOnlyRollbackFromCrashedCommit)
     m_helper.checkFileSystem(fsys);
 }
 
+TEST_F(CompositeTester, RedoLoggedCommitSurvivesCrashBeforeTruncate)
+{
+    {
+        auto fsys = Composite::open<CrashCommitFile>(m_file);
+        fsys.setCommitProtocol(CommitProtocol::Redo);
+        fsys.remove("test");
+        ASSERT_THROW(fsys.commit(), CrashCommitFile::Exception);
+    }
+
+    {
+        auto fsys = Composite::openReadOnly<WrappedFile>(m_file);
+        ASSERT_FALSE(fsys.getAttribute("test/attribute"));
+    }
+    auto fsys = Composite::open<WrappedFile>(m_file);
+    ASSERT_FALSE(fsys.getAttribute("test/attribute"));
+}
+
 TEST_F(CompositeTester, ReadOnlyCommitDoesNotThrow)
 {
     auto fsys = Composite::openReadOnly<WrappedFile>(m_file);
@@ -5,6 +5,8 @@
 #include "CompoundFs/MemoryFile.h"
 #include "CompoundFs/DirectoryStructure.h"
 #include "CompoundFs/CommitBlock.h"
+#include "CompoundFs/FileWriter.h"
+#include <algorithm>
 
 using namespace TxFs;
 
@@ -135,6 +137,30 @@ TEST(DirectoryStructure, recursiveRemoveReturnsNumOfDeletedItems)
     ASSERT_EQ(nof, 1+4+4*3);
 }
 
+TEST(DirectoryStructure, removeOfBigFolderLeavesNeighbourFoldersIntact)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+
+    auto before = ds.makeSubFolder(DirectoryKey("a")).value();
+    auto subFolder = ds.makeSubFolder(DirectoryKey("b")).value();
+    auto after = ds.makeSubFolder(DirectoryKey("c")).value();
+    for (int i = 0; i < 20000; i++)
+    {
+        ds.addAttribute(DirectoryKey(before, std::to_string(i)), "test");
+        ds.addAttribute(DirectoryKey(subFolder, std::to_string(i)), "test");
+        ds.addAttribute(DirectoryKey(after, std::to_string(i)), "test");
+    }
+
+    auto nof = ds.remove(DirectoryKey("b"));
+    ASSERT_EQ(nof, 20001);
+    ASSERT_TRUE(!ds.begin(DirectoryKey(subFolder)));
+    for (int i = 0; i < 20000; i++)
+    {
+        ASSERT_TRUE(ds.getAttribute(DirectoryKey(before, std::to_string(i))));
+        ASSERT_TRUE(ds.getAttribute(DirectoryKey(after, std::to_string(i))));
+    }
+}
+
 TEST(DirectoryStructure, addGetAttribute)
 {
     DirectoryStructure ds = makeDirectoryStructure();
@@ -150,6 +176,94 @@ TEST(DirectoryStructure, addGetAttribute)
     ASSERT_EQ(res->get<double>(), 42.42);
 }
 
+TEST(DirectoryStructure, longStringAttributesAreStoredOutOfLine)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+
+    std::string longString(10000, 'x');
+    for (size_t i = 0; i < longString.size(); i++)
+        longString[i] = char('a' + i % 26);
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey("long"), longString));
+    ASSERT_EQ(ds.getAttribute(DirectoryKey("long"))->get<std::string>(), longString);
+    ASSERT_EQ(ds.find(DirectoryKey("long")).value(), TreeValue(longString));
+
+    std::string limit(TreeValue::maxVariableSize() + 1, 'y');
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey("long"), limit));
+    ASSERT_EQ(ds.getAttribute(DirectoryKey("long"))->get<std::string>(), limit);
+
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey("long"), "short"));
+    ASSERT_EQ(ds.getAttribute(DirectoryKey("long"))->get<std::string>(), "short");
+}
+
+TEST(DirectoryStructure, longStringAttributesDoNotReplaceFolders)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    ds.makeSubFolder(DirectoryKey("folder"));
+    ASSERT_FALSE(ds.addAttribute(DirectoryKey("folder"), std::string(1000, 'x')));
+    ASSERT_TRUE(ds.subFolder(DirectoryKey("folder")));
+}
+
+TEST(DirectoryStructure, longNamesSharingTheirPrefixAreToldApart)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    auto folder = *ds.makeSubFolder(DirectoryKey("folder"));
+
+    std::string prefix(DirectoryKey::maxSize(), 'p');
+    std::vector<std::string> names { prefix.substr(1), prefix, prefix + "a", prefix + "b",
+                                     prefix + std::string(5000, 'c') };
+    for (size_t i = 0; i < names.size(); i++)
+        ASSERT_TRUE(ds.addAttribute(DirectoryKey(folder, names[i]), uint32_t(i)));
+
+    for (size_t i = 0; i < names.size(); i++)
+        ASSERT_EQ(ds.getAttribute(DirectoryKey(folder, names[i]))->get<uint32_t>(), i);
+    ASSERT_FALSE(ds.getAttribute(DirectoryKey(folder, prefix + "c")));
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey(folder, prefix + "a"), uint32_t(42)));
+    ASSERT_EQ(ds.getAttribute(DirectoryKey(folder, prefix + "a"))->get<uint32_t>(), 42U);
+
+    std::vector<std::string> found;
+    for (auto cursor = ds.begin(DirectoryKey(folder, "")); cursor; cursor = ds.next(cursor))
+        found.emplace_back(cursor.key().second);
+    ASSERT_EQ(found.size(), names.size());
+    std::sort(found.begin(), found.end());
+    std::sort(names.begin(), names.end());
+    ASSERT_EQ(found, names);
+}
+
+TEST(DirectoryStructure, longNamesCanBeRenamedAndRemoved)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    std::string name(1000, 'n');
+    ASSERT_TRUE(ds.createFile(DirectoryKey(name)));
+    ASSERT_TRUE(ds.openFile(DirectoryKey(name)));
+
+    ASSERT_TRUE(ds.rename(DirectoryKey(name), DirectoryKey(name + "2")));
+    ASSERT_FALSE(ds.openFile(DirectoryKey(name)));
+    ASSERT_TRUE(ds.openFile(DirectoryKey(name + "2")));
+    ASSERT_FALSE(ds.rename(DirectoryKey(name), DirectoryKey("short")));
+
+    auto folder = *ds.makeSubFolder(DirectoryKey(name));
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey(folder, name), "attribute"));
+    ASSERT_EQ(ds.subFolder(DirectoryKey(name)), folder);
+    ASSERT_EQ(ds.remove(DirectoryKey(name)), 2U);
+    ASSERT_EQ(ds.remove(DirectoryKey(name + "2")), 1U);
+    ASSERT_FALSE(ds.begin(DirectoryKey("")));
+}
+
+TEST(DirectoryStructure, filesWithoutLongNamesKeepTheOldLimit)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    ds.commit();
+    auto cb = ds.retrieveCommitBlock();
+    cb.m_longNames = false;
+    ds.storeCommitBlock(cb);
+    ds.init();
+
+    std::string name(DirectoryKey::maxSize(), 'n');
+    ASSERT_TRUE(ds.createFile(DirectoryKey(name)));
+    ASSERT_EQ(ds.find(DirectoryKey(name)).key().second, name);
+    ASSERT_THROW(ds.createFile(DirectoryKey(name + "n")), std::runtime_error);
+}
+
 TEST(DirectoryStructure, attributesDoNotReplaceFolders)
 {
     DirectoryStructure ds = makeDirectoryStructure();
@@ -225,6 +339,27 @@ TEST(DirectoryStructure, storeCommitBlockEqualsRetrieveCommitBlock)
     ASSERT_EQ(in.m_freeStoreDescriptor, out.m_freeStoreDescriptor);
     ASSERT_EQ(in.m_compositSize, out.m_compositSize);
     ASSERT_EQ(in.m_maxFolderId, out.m_maxFolderId);
+    ASSERT_EQ(in.m_pageSize, PageSize);
+}
+
+TEST(DirectoryStructure, commitBlockWithoutPageSizeDefaultsTo4K)
+{
+    CommitBlock out { { 1234567, 123, 234 }, 54321, 23 };
+    auto str = out.toString();
+    str[0] = 0; // version 0 had no page size
+    str.resize(str.size() - sizeof(uint32_t));
+    auto in = CommitBlock::fromString(str);
+    ASSERT_EQ(in.m_maxFolderId, out.m_maxFolderId);
+    ASSERT_EQ(in.m_pageSize, 4096U);
+}
+
+TEST(DirectoryStructure, initThrowsOnPageSizeMismatch)
+{
+    auto ds = makeDirectoryStructure();
+    CommitBlock cb;
+    cb.m_pageSize = PageSize * 2;
+    ds.storeCommitBlock(cb);
+    ASSERT_THROW(ds.init(), std::runtime_error);
 }
 
 TEST(DirectoryStructure, EmptyFolderReturnsNullCursorOnBegin)
@@ -238,6 +373,43 @@ TEST(DirectoryStructure, EmptyFolderReturnsNullCursorOnBegin)
     ASSERT_FALSE(cursor);
 }
 
+TEST(DirectoryStructure, removingDeduplicatedFilesDropsTheirChunkHashes)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    DirectoryStructure ds(DirectoryStructure::initialize(cm));
+
+    std::vector<uint8_t> data(2 * DedupChunkSize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * 7 + i / DedupChunkSize);
+    auto writeFile = [&](std::string_view name) {
+        FileWriter writer(cm);
+        writer.enableDeduplication(ds.chunkIndex());
+        writer.write(data.data(), data.data() + data.size());
+        TreeValue file = writer.close();
+        ds.markShared(file);
+        ds.createFile(DirectoryKey(name));
+        ds.updateFile(DirectoryKey(name), file);
+    };
+    auto numOfEntries = [&](std::string_view systemFolderName) {
+        size_t num = 0;
+        if (auto folder = ds.subFolder(DirectoryKey(Folder { 1 }, systemFolderName)))
+            for (auto cursor = ds.begin(DirectoryKey(*folder, "")); cursor; cursor = ds.next(cursor))
+                num++;
+        return num;
+    };
+
+    writeFile("a.dat");
+    writeFile("b.dat");
+    ASSERT_EQ(numOfEntries("ChunkHashes"), 2U);
+    ASSERT_EQ(numOfEntries("ChunkPages"), 2U);
+
+    ASSERT_EQ(ds.remove(DirectoryKey("a.dat")), 1U);
+    ASSERT_EQ(numOfEntries("ChunkHashes"), 2U);
+    ASSERT_EQ(ds.remove(DirectoryKey("b.dat")), 1U);
+    ASSERT_EQ(numOfEntries("ChunkHashes"), 0U);
+    ASSERT_EQ(numOfEntries("ChunkPages"), 0U);
+}
+
 
 TEST(Cursor, creation)
 {
@@ -10,7 +10,7 @@ using namespace TxFs;
 
 TEST(FileIo, modifiedSignedPagesGetDetected)
 {
-    uint8_t page[4096];
+    uint8_t page[PageSize];
     MemoryFile mf;
     mf.newInterval(1);
     writeSignedPage(&mf, 0, page);
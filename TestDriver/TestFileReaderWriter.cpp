@@ -8,9 +8,16 @@
 #include <string>
 #include <algorithm>
 #include <random>
+#include <numeric>
 
 using namespace TxFs;
 
+namespace
+{
+/// a FileTable page full of single page intervals
+constexpr size_t IntervalsPerFileTable = (PageSize - 12) / sizeof(PageIndex);
+}
+
 TEST(FileWriter, CtorCreatesEmptyFileDesc)
 {
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
@@ -123,12 +130,13 @@ TEST(FileWriter, SmallWritesOverPageBoundery)
 
     FileWriter f(cm);
     ByteStringView data("Test0");
-    for (int i = 0; i < 1000; i++)
+    const int writes = int(PageSize / 4); // a bit more than a page
+    for (int i = 0; i < writes; i++)
         f.write(data.data(), data.end());
 
     FileDescriptor fd = f.close();
     ASSERT_EQ(fd.m_first , fd.m_last);
-    ASSERT_EQ(fd.m_fileSize , 1000ULL * data.size());
+    ASSERT_EQ(fd.m_fileSize , writes * data.size());
 
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     ASSERT_EQ(fileTablePage.m_index , fd.m_last);
@@ -146,20 +154,21 @@ TEST(FileWriter, SmallWritesWithAppendOverPageBoundery)
 
     FileWriter f(cm);
     ByteStringView data("Test0");
-    for (int i = 0; i < 1000; i++)
+    const int writes = int(PageSize / 4); // a bit more than a page
+    for (int i = 0; i < writes; i++)
         f.write(data.data(), data.end());
 
     FileDescriptor fd = f.close();
     ASSERT_EQ(fd.m_first , fd.m_last);
-    ASSERT_EQ(fd.m_fileSize , 1000ULL * data.size());
+    ASSERT_EQ(fd.m_fileSize , writes * data.size());
 
     f.openAppend(fd);
-    for (int i = 0; i < 1000; i++)
+    for (int i = 0; i < writes; i++)
         f.write(data.data(), data.end());
 
     fd = f.close();
     ASSERT_EQ(fd.m_first , fd.m_last);
-    ASSERT_EQ(fd.m_fileSize , 2000ULL * data.size());
+    ASSERT_EQ(fd.m_fileSize , 2 * writes * data.size());
 
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     ASSERT_EQ(fileTablePage.m_index , fd.m_last);
@@ -173,7 +182,7 @@ TEST(FileWriter, SmallWritesWithAppendOverPageBoundery)
 
 TEST(FileWriter, PageSizeWrites)
 {
-    std::string str(4096, 'X');
+    std::string str(PageSize, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -193,7 +202,7 @@ TEST(FileWriter, PageSizeWrites)
 
 TEST(FileWriter, OverPageSizeWrites)
 {
-    std::string str(4097, 'X');
+    std::string str(PageSize + 1, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -213,7 +222,7 @@ TEST(FileWriter, OverPageSizeWrites)
 
 TEST(FileWriter, UnderPageSizeWrites)
 {
-    std::string str(4095, 'X');
+    std::string str(PageSize - 1, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -233,7 +242,7 @@ TEST(FileWriter, UnderPageSizeWrites)
 
 TEST(FileWriter, LargePageSizeWrites)
 {
-    std::string str(8192, 'X');
+    std::string str(2 * PageSize, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -268,7 +277,7 @@ TEST(FileWriter, LargeSizeWrites)
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     IntervalSequence is;
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.front() , Interval(0, uint32_t(10 * str.size() / 4096 + 1)));
+    ASSERT_EQ(is.front() , Interval(0, uint32_t(10 * str.size() / PageSize + 1)));
 }
 
 TEST(FileWriter, LargeSizeWritesMultiFiles)
@@ -294,22 +303,23 @@ TEST(FileWriter, LargeSizeWritesMultiFiles)
     auto fileTablePage2 = tcm.loadPage<FileTable>(fd2.m_last);
     IntervalSequence is;
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.front() , Interval(0, uint32_t(str.size() / 4096 + 1)));
+    ASSERT_EQ(is.front() , Interval(0, uint32_t(str.size() / PageSize + 1)));
 
     IntervalSequence is2;
     fileTablePage2.m_page->insertInto(is2);
-    ASSERT_EQ(is2.totalLength() , 10 * str.size() / 4096 + 1);
+    ASSERT_EQ(is2.totalLength() , 10 * str.size() / PageSize + 1);
 }
 
 TEST(FileWriter, FillPageTable)
 {
-    std::string str(4096, 'X');
+    std::string str(PageSize, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
     FileWriter f(cm);
     FileWriter f2(cm);
-    for (int i = 0; i < 2000; i++)
+    const size_t writes = 2 * IntervalsPerFileTable - 42; // two file tables each
+    for (size_t i = 0; i < writes; i++)
     {
         f.write((const uint8_t*) str.c_str(), (const uint8_t*) str.c_str() + str.size());
         f2.write((const uint8_t*) str.c_str(), (const uint8_t*) str.c_str() + str.size());
@@ -317,10 +327,10 @@ TEST(FileWriter, FillPageTable)
 
     FileDescriptor fd = f.close();
     FileDescriptor fd2 = f2.close();
-    ASSERT_EQ(fd.m_fileSize , 2000ULL * str.size());
+    ASSERT_EQ(fd.m_fileSize , writes * str.size());
     ASSERT_NE(fd.m_first , fd.m_last);
 
-    ASSERT_EQ(fd2.m_fileSize , 2000ULL * str.size());
+    ASSERT_EQ(fd2.m_fileSize , writes * str.size());
     ASSERT_NE(fd2.m_first , fd2.m_last);
 
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_first);
@@ -328,13 +338,13 @@ TEST(FileWriter, FillPageTable)
     fileTablePage.m_page->insertInto(is);
     fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.size() , 2000);
+    ASSERT_EQ(is.size() , writes);
 
     fileTablePage = tcm.loadPage<FileTable>(fd2.m_first);
     fileTablePage.m_page->insertInto(is);
     fileTablePage = tcm.loadPage<FileTable>(fd2.m_last);
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.size() , 4000);
+    ASSERT_EQ(is.size() , 2 * writes);
 }
 
 TEST(FileReader, ReadNullFile)
@@ -375,12 +385,12 @@ FileDescriptor writeFragmentedFile(const std::vector<uint8_t>& v, std::shared_pt
 {
     FileWriter fr(cacheManager);
     FileWriter fr2(cacheManager);
-    size_t s = (v.size() / 4096) * 4096;
+    size_t s = (v.size() / PageSize) * PageSize;
     auto it = v.begin();
-    for (auto it = v.begin(); it < (v.begin() + s); it += 4096)
+    for (auto it = v.begin(); it < (v.begin() + s); it += PageSize)
     {
-        fr.writeIterator(it, it + 4096);
-        fr2.writeIterator(it, it + 4096);
+        fr.writeIterator(it, it + PageSize);
+        fr2.writeIterator(it, it + PageSize);
     }
 
     fr.writeIterator(v.begin() + s, v.end());
@@ -540,7 +550,7 @@ TEST(FileReader, ReadBigFile)
 
 TEST(FileReader, ReadFragmentedFile)
 {
-    std::vector<uint8_t> v = makeVector(2200 * 4097); // => 3 filetable pages
+    std::vector<uint8_t> v = makeVector((2 * IntervalsPerFileTable + 158) * (PageSize + 1)); // => 3 filetable pages
     auto cacheManager = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     FileDescriptor fd = writeFragmentedFile(v, cacheManager);
     {
@@ -583,7 +593,7 @@ TEST(FileReader, ReadFragmentedFile)
 
 TEST(FileReader, visitAllFileTables)
 {
-    std::vector<uint8_t> v = makeVector(2200 * 4097); // => 3 filetable pages
+    std::vector<uint8_t> v = makeVector((2 * IntervalsPerFileTable + 158) * (PageSize + 1)); // => 3 filetable pages
     auto cacheManager = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     FileDescriptor fd = writeFragmentedFile(v, cacheManager);
 
@@ -599,7 +609,7 @@ TEST(FileReader, visitAllFileTables)
 
 TEST(FileReader, visitAllFileTablesInterruptsOnReturnFalse)
 {
-    std::vector<uint8_t> v = makeVector(2200 * 4097); // => 3 filetable pages
+    std::vector<uint8_t> v = makeVector((2 * IntervalsPerFileTable + 158) * (PageSize + 1)); // => 3 filetable pages
     auto cacheManager = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     FileDescriptor fd = writeFragmentedFile(v, cacheManager);
 
@@ -612,3 +622,114 @@ TEST(FileReader, visitAllFileTablesInterruptsOnReturnFalse)
 
     ASSERT_EQ(i, 2);
 }
+
+TEST(FileReader, compressedFileReadsBackWhatWasWritten)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    std::vector<uint8_t> data(3 * CompressedChunkSize + 1234);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t((i / 100) % 7);
+
+    FileWriter fw(cm);
+    fw.openCompressed(CompressedFile {});
+    fw.write(data.data(), data.data() + 1000);
+    fw.write(data.data() + 1000, data.data() + data.size());
+    ASSERT_EQ(fw.size(), data.size());
+    auto file = fw.closeCompressed();
+    ASSERT_EQ(file.m_fileSize, data.size());
+    ASSERT_LT(file.m_descriptor.m_fileSize, data.size() / 10);
+
+    FileReader fr(cm);
+    fr.openCompressed(file);
+    ASSERT_EQ(fr.size(), data.size());
+    std::vector<uint8_t> readBack(data.size() + 10);
+    auto end = fr.read(readBack.data(), readBack.data() + 100);
+    end = fr.read(end, readBack.data() + readBack.size());
+    ASSERT_EQ(end, readBack.data() + data.size());
+    ASSERT_EQ(fr.bytesLeft(), 0U);
+    readBack.resize(data.size());
+    ASSERT_EQ(readBack, data);
+}
+
+TEST(FileReader, incompressibleChunksAreStoredAsIs)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    std::vector<uint8_t> data(CompressedChunkSize + 10);
+    std::mt19937 rng(42);
+    std::generate(data.begin(), data.end(), [&] { return uint8_t(rng()); });
+
+    FileWriter fw(cm);
+    fw.openCompressed(CompressedFile {});
+    fw.write(data.data(), data.data() + data.size());
+    auto file = fw.closeCompressed();
+    ASSERT_EQ(file.m_descriptor.m_fileSize, data.size() + 2 * sizeof(ChunkHeader));
+
+    fw.openCompressed(file);
+    fw.write(data.data(), data.data() + 10);
+    file = fw.closeCompressed();
+    ASSERT_EQ(file.m_fileSize, data.size() + 10);
+
+    FileReader fr(cm);
+    fr.openCompressed(file);
+    std::vector<uint8_t> readBack(file.m_fileSize);
+    fr.read(readBack.data(), readBack.data() + readBack.size());
+    ASSERT_TRUE(std::equal(data.begin(), data.end(), readBack.begin()));
+    ASSERT_TRUE(std::equal(data.begin(), data.begin() + 10, readBack.begin() + data.size()));
+}
+
+TEST(FileWriter, appendingContinuesPageChecksums)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    std::vector<uint8_t> data(3 * PageSize + 100);
+    std::iota(data.begin(), data.end(), uint8_t(0));
+
+    FileWriter fw(cm);
+    fw.enablePageChecksums({});
+    fw.write(data.data(), data.data() + data.size());
+    fw.close();
+    auto checksums = fw.takePageChecksums();
+
+    fw.openAppend(FileDescriptor());
+    fw.enablePageChecksums({});
+    fw.write(data.data(), data.data() + PageSize + 50);
+    auto fd = fw.close();
+    auto firstChecksums = fw.takePageChecksums();
+    fw.openAppend(fd);
+    fw.enablePageChecksums(*firstChecksums);
+    fw.write(data.data() + PageSize + 50, data.data() + data.size());
+    fw.close();
+
+    ASSERT_EQ(checksums->size(), 4U);
+    ASSERT_EQ(fw.takePageChecksums(), checksums);
+}
+
+TEST(FileReader, corruptDataPageFailsChecksumVerification)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    std::vector<uint8_t> data(3 * PageSize + 100, 'x');
+
+    FileWriter fw(cm);
+    fw.enablePageChecksums({});
+    fw.write(data.data(), data.data() + data.size());
+    auto fd = fw.close();
+    auto checksums = *fw.takePageChecksums();
+
+    FileReader fr(cm);
+    fr.open(fd);
+    fr.setPageChecksums(checksums);
+    std::vector<uint8_t> readBack(data.size());
+    fr.read(readBack.data(), readBack.data() + 10);
+    fr.read(readBack.data() + 10, readBack.data() + readBack.size());
+    ASSERT_EQ(readBack, data);
+
+    fr.open(fd);
+    PageIndex lastPage = PageIdx::INVALID;
+    for (int i = 0; i < 4; i++)
+        lastPage = fr.nextInterval(1).begin();
+    uint8_t garbage = 'y';
+    cm->getFileInterface()->writePage(lastPage, 17, &garbage, &garbage + 1);
+    fr.open(fd);
+    fr.setPageChecksums(checksums);
+    ASSERT_NO_THROW(fr.read(readBack.data(), readBack.data() + 3 * PageSize));
+    ASSERT_THROW(fr.read(readBack.data(), readBack.data() + 1), std::runtime_error);
+}
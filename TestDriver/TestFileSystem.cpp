@@ -6,6 +6,12 @@
 #include "CompoundFs/DirectoryStructure.h"
 #include "CompoundFs/Path.h"
 #include "CompoundFs/FileSystem.h"
+#include "CompoundFs/Composite.h"
+#include "CompoundFs/WrappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
 
 using namespace TxFs;
 
@@ -87,6 +93,420 @@ TEST(FileSystem, readAfterAppendAfterWrite)
     ASSERT_EQ(2 * size, fs.read(*readHandle, buf, sizeof(buf)));
 }
 
+TEST(FileSystem, smallFilesAreStoredInline)
+{
+    auto fs = makeFileSystem();
+    createFile("folder/file.file", fs);
+    auto value = fs.find("folder/file.file").value();
+    ASSERT_EQ(value.getType(), TreeValue::Type::InlineFile);
+    ASSERT_EQ(value.get<InlineFile>().m_data, "test");
+    ASSERT_EQ(fs.fileSize("folder/file.file"), 4U);
+
+    fs.commit();
+    uint8_t buf[10];
+    auto readHandle = fs.readFile("folder/file.file").value();
+    ASSERT_EQ(fs.fileSize(readHandle), 4U);
+    ASSERT_EQ(fs.read(readHandle, buf, sizeof(buf)), 4U);
+    ASSERT_EQ(ByteStringView(buf, 4), ByteStringView("test"));
+}
+
+TEST(FileSystem, growingInlineFileIsPromotedToPages)
+{
+    auto fs = makeFileSystem();
+    std::string data;
+    for (int i = 0; i < 100; i++)
+    {
+        auto handle = fs.appendFile("folder/file.file").value();
+        auto chunk = std::to_string(i) + ",";
+        fs.write(handle, chunk.data(), chunk.size());
+        fs.close(handle);
+        data += chunk;
+    }
+    ASSERT_GT(data.size(), TreeValue::maxVariableSize());
+    ASSERT_EQ(fs.find("folder/file.file").value().getType(), TreeValue::Type::File);
+    ASSERT_EQ(fs.fileSize("folder/file.file"), data.size());
+
+    std::string readBack(data.size(), ' ');
+    auto readHandle = fs.readFile("folder/file.file").value();
+    ASSERT_EQ(fs.read(readHandle, readBack.data(), readBack.size()), data.size());
+    ASSERT_EQ(readBack, data);
+}
+
+TEST(FileSystem, compressedFilesAreReadAndAppendedTransparently)
+{
+    auto fs = makeFileSystem();
+    std::string data;
+    for (int i = 0; data.size() < 3 * CompressedChunkSize; i++)
+        data += "line " + std::to_string(i % 1000) + " of a very repetitive log file\n";
+
+    auto handle = fs.createFile("folder/file.log", Compression::Lz4).value();
+    fs.write(handle, data.data(), data.size() / 2);
+    fs.close(handle);
+    handle = fs.appendFile("folder/file.log").value();
+    fs.write(handle, data.data() + data.size() / 2, data.size() - data.size() / 2);
+    fs.commit();
+
+    auto value = fs.find("folder/file.log").value();
+    ASSERT_EQ(value.getType(), TreeValue::Type::CompressedFile);
+    ASSERT_LT(value.get<CompressedFile>().m_descriptor.m_fileSize, data.size() / 4);
+    ASSERT_EQ(fs.fileSize("folder/file.log"), data.size());
+
+    std::string readBack(data.size(), ' ');
+    auto readHandle = fs.readFile("folder/file.log").value();
+    ASSERT_EQ(fs.fileSize(readHandle), data.size());
+    ASSERT_EQ(fs.read(readHandle, readBack.data(), readBack.size()), data.size());
+    ASSERT_EQ(readBack, data);
+    fs.close(readHandle);
+
+    ASSERT_EQ(fs.remove("folder/file.log"), 1U);
+    fs.commit();
+    ASSERT_FALSE(fs.readFile("folder/file.log"));
+}
+
+TEST(FileSystem, scrubFindsCorruptDataPages)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.enablePageChecksums(true);
+
+    std::string data(5 * PageSize, 'a');
+    for (auto name: { "folder/a.dat", "folder/b.dat", "c.dat" })
+    {
+        auto handle = fs.createFile(name).value();
+        fs.write(handle, data.data(), data.size());
+        fs.close(handle);
+    }
+    auto handle = fs.appendFile("c.dat").value();
+    fs.write(handle, data.data(), 100);
+    fs.commit();
+
+    auto result = fs.scrub();
+    ASSERT_EQ(result.m_checkedFiles, 3U);
+    ASSERT_EQ(result.m_checkedPages, 16U);
+    ASSERT_TRUE(result.m_corruptFiles.empty());
+
+    FileReader reader(cm);
+    reader.open(fs.find("folder/b.dat").value().get<FileDescriptor>());
+    uint8_t garbage = 'b';
+    cm->getFileInterface()->writePage(reader.nextInterval(1).begin(), 0, &garbage, &garbage + 1);
+
+    result = fs.scrub();
+    ASSERT_EQ(result.m_corruptFiles.size(), 1U);
+    ASSERT_EQ(result.m_corruptFiles[0].second, "b.dat");
+
+    auto readHandle = fs.readFile("folder/b.dat").value();
+    ASSERT_THROW(fs.read(readHandle, data.data(), data.size()), std::runtime_error);
+    fs.close(readHandle);
+
+    fs.remove("folder/b.dat");
+    fs.commit();
+    result = fs.scrub();
+    ASSERT_EQ(result.m_checkedFiles, 2U);
+    ASSERT_TRUE(result.m_corruptFiles.empty());
+}
+
+TEST(FileSystem, deduplicationStoresIdenticalChunksOnce)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.enableDeduplication(true);
+
+    std::string data(4 * DedupChunkSize + 100, ' ');
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = char(i * 7 + i / DedupChunkSize);
+    auto writeFile = [&](Path path) {
+        auto handle = fs.createFile(path).value();
+        fs.write(handle, data.data(), data.size());
+        fs.close(handle);
+        fs.commit();
+    };
+    auto readFile = [&](Path path) {
+        std::string readBack(data.size(), ' ');
+        auto handle = fs.readFile(path).value();
+        fs.read(handle, readBack.data(), readBack.size());
+        fs.close(handle);
+        return readBack;
+    };
+
+    writeFile("a.dat");
+    auto size = cm->getFileInterface()->fileSizeInPages();
+    writeFile("b.dat");
+    writeFile("folder/c.dat");
+    ASSERT_LT(cm->getFileInterface()->fileSizeInPages() - size, DedupChunkPages);
+
+    fs.remove("a.dat");
+    fs.remove("b.dat");
+    fs.commit();
+    ASSERT_EQ(readFile("folder/c.dat"), data);
+
+    // the last reference frees the chunks for the next file
+    fs.remove("folder/c.dat");
+    fs.commit();
+    size = cm->getFileInterface()->fileSizeInPages();
+    std::reverse(data.begin(), data.end());
+    writeFile("d.dat");
+    ASSERT_LT(cm->getFileInterface()->fileSizeInPages() - size, DedupChunkPages);
+    ASSERT_EQ(readFile("d.dat"), data);
+}
+
+TEST(FileSystem, clonesSharePagesUntilAppendedTo)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    std::string data(64 * PageSize + 100, ' ');
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = char(i * 13);
+    auto readFile = [&](Path path) {
+        std::string readBack(size_t(fs.fileSize(path).value()), ' ');
+        auto handle = fs.readFile(path).value();
+        fs.read(handle, readBack.data(), readBack.size());
+        fs.close(handle);
+        return readBack;
+    };
+
+    auto handle = fs.createFile("folder/a.dat").value();
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.addAttribute("folder/attribute", 42.0);
+    fs.commit();
+    auto size = cm->getFileInterface()->fileSizeInPages();
+
+    ASSERT_EQ(fs.clone("folder/a.dat", "b.dat"), 1U);
+    ASSERT_EQ(fs.clone("folder", "folder/copy"), 3U);
+    fs.commit();
+    ASSERT_LT(cm->getFileInterface()->fileSizeInPages() - size, 16U);
+    ASSERT_EQ(fs.getAttribute("folder/copy/attribute"), TreeValue(42.0));
+    ASSERT_FALSE(fs.find("folder/copy/copy"));
+
+    handle = fs.appendFile("b.dat").value();
+    fs.write(handle, "xyz", 3);
+    fs.close(handle);
+    fs.remove("folder/a.dat");
+    fs.commit();
+    ASSERT_EQ(readFile("b.dat"), data + "xyz");
+    ASSERT_EQ(readFile("folder/copy/a.dat"), data);
+
+    // once the last clone is gone the pages are reused
+    fs.remove("b.dat");
+    fs.remove("folder");
+    fs.commit();
+    size = cm->getFileInterface()->fileSizeInPages();
+    handle = fs.createFile("c.dat").value();
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.commit();
+    ASSERT_EQ(cm->getFileInterface()->fileSizeInPages(), size);
+}
+
+TEST(FileSystem, cloneIntoANestedSubFolderOfTheSource)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.addAttribute("a/attribute", 42.0);
+    fs.addAttribute("a/b/attribute", 43.0);
+
+    ASSERT_EQ(fs.clone("a", "a/b/c"), 4U); // a/b/c, a/b/c/attribute, a/b/c/b and a/b/c/b/attribute
+    ASSERT_EQ(fs.getAttribute("a/b/c/attribute"), TreeValue(42.0));
+    ASSERT_EQ(fs.getAttribute("a/b/c/b/attribute"), TreeValue(43.0));
+    ASSERT_FALSE(fs.find("a/b/c/b/c"));
+}
+
+TEST(FileSystem, replicationStreamReproducesTheFile)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>(), 16);
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.commit();
+    auto readAll = [](const FileInterface* file) {
+        std::vector<uint8_t> pages(file->fileSizeInPages() * PageSize);
+        file->readPages(Interval(0, PageIndex(file->fileSizeInPages())), pages.data());
+        return pages;
+    };
+
+    auto replica = std::make_unique<MemoryFile>();
+    auto pages = readAll(cm->getFileInterface());
+    replica->writePages(replica->newInterval(pages.size() / PageSize), pages.data());
+
+    std::vector<uint8_t> stream;
+    fs.enableReplication([&](const uint8_t* begin, const uint8_t* end) { stream.insert(stream.end(), begin, end); });
+    auto commit = [&] {
+        fs.commit();
+        FileSystem::applyReplicationStream(*replica, stream.data(), stream.data() + stream.size());
+        stream.clear();
+        ASSERT_EQ(readAll(replica.get()), readAll(cm->getFileInterface()));
+    };
+
+    std::string data(5 * PageSize + 10, 'x');
+    for (int i = 0; i < 200; i++)
+        fs.addAttribute(Path("folder/attribute" + std::to_string(i)), double(i));
+    auto handle = fs.createFile("folder/a.dat").value();
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    commit();
+
+    handle = fs.appendFile("folder/a.dat").value();
+    fs.write(handle, data.data(), 100);
+    fs.close(handle);
+    for (int i = 0; i < 200; i += 2)
+        fs.remove(Path("folder/attribute" + std::to_string(i)));
+    commit();
+
+    createFile("b.dat", fs);
+    fs.rollback();
+    createFile("c.dat", fs);
+    commit();
+
+    auto bytes = reinterpret_cast<const uint8_t*>(data.data());
+    ASSERT_THROW(FileSystem::applyReplicationStream(*replica, bytes, bytes + 10), std::runtime_error);
+
+    auto replicaFs = FileSystem(FileSystem::Startup { std::make_shared<CacheManager>(std::move(replica)), 1, 0 });
+    replicaFs.init();
+    ASSERT_EQ(replicaFs.fileSize("folder/a.dat"), data.size() + 100);
+    ASSERT_EQ(replicaFs.fileSize("c.dat"), 4);
+    ASSERT_FALSE(replicaFs.find("b.dat"));
+}
+
+TEST(FileSystem, backupCopiesOnlyPagesInUse)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.enablePageChecksums(true);
+    std::string data(40 * PageSize + 10, 'x');
+    for (auto name: { "folder/a.dat", "folder/b.dat", "folder/c.dat" })
+    {
+        auto handle = fs.createFile(name).value();
+        fs.write(handle, data.data(), data.size());
+        fs.close(handle);
+    }
+    createFile("folder/inline", fs);
+    fs.commit();
+    fs.remove("folder/b.dat");
+    fs.commit();
+
+    auto backup = std::make_unique<MemoryFile>();
+    auto copied = fs.backupTo(*backup);
+    ASSERT_EQ(backup->fileSizeInPages(), cm->getFileInterface()->fileSizeInPages());
+    ASSERT_LT(copied + 40, backup->fileSizeInPages());
+
+    auto backupFs = FileSystem(FileSystem::Startup { std::make_shared<CacheManager>(std::move(backup)), 1, 0 });
+    backupFs.init();
+    ASSERT_EQ(backupFs.scrub().m_corruptFiles.size(), 0U);
+    ASSERT_EQ(backupFs.scrub().m_checkedFiles, 2U);
+    ASSERT_FALSE(backupFs.find("folder/b.dat"));
+    ASSERT_EQ(backupFs.fileSize("folder/inline"), 4);
+
+    // the backup is a regular composite
+    backupFs.remove("folder/a.dat");
+    createFile("folder/d.dat", backupFs);
+    backupFs.commit();
+    ASSERT_EQ(backupFs.fileSize("folder/c.dat"), data.size());
+}
+
+TEST(FileSystem, backupLeavesOutPagesOfAnOpenTransaction)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    auto writer = Composite::open<WrappedFile>(file);
+    createFile("committed.dat", writer);
+    writer.commit();
+    auto committedSize = file->fileSizeInPages();
+
+    // the writer's transaction grows the file but stays open
+    std::string data(40 * PageSize, 'x');
+    auto handle = writer.createFile("uncommitted.dat").value();
+    writer.write(handle, data.data(), data.size());
+    writer.close(handle);
+    ASSERT_GT(file->fileSizeInPages(), committedSize + 40);
+
+    auto reader = Composite::openReadOnly<WrappedFile>(file);
+    auto backup = std::make_unique<MemoryFile>();
+    reader.backupTo(*backup);
+    ASSERT_EQ(backup->fileSizeInPages(), committedSize);
+
+    auto backupFs = FileSystem(FileSystem::Startup { std::make_shared<CacheManager>(std::move(backup)), 1, 0 });
+    backupFs.init();
+    ASSERT_EQ(backupFs.fileSize("committed.dat"), 4);
+    ASSERT_FALSE(backupFs.find("uncommitted.dat"));
+}
+
+TEST(FileSystem, statisticsCountCacheAndCommitActivity)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>(), 16);
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    const int files = 5000 * int(PageSize / 4096); // more pages than the cache holds
+    for (int i = 0; i < files; i++)
+        createFile(Path(("folder/file" + std::to_string(i)).c_str()), fs);
+    fs.commit();
+    for (int i = 0; i < files; i += 7)
+        fs.remove(Path(("folder/file" + std::to_string(i)).c_str()));
+    fs.commit();
+
+    const auto& statistics = fs.statistics();
+    ASSERT_EQ(statistics.m_commits, 2U);
+    ASSERT_GT(statistics.m_committedPages, 0U);
+    ASSERT_GT(statistics.m_committedDirtyPages, 0U);
+    ASSERT_EQ(statistics.m_flushes, 3U);
+    ASSERT_GT(statistics.m_cacheHits, 0U);
+    ASSERT_GT(statistics.m_cacheMisses, 0U);
+    ASSERT_GT(statistics.m_evictedNewPages + statistics.m_evictedReadPages + statistics.m_divertedPages, 0U);
+    ASSERT_GT(statistics.m_pagesFromFileGrowth, 0U);
+    ASSERT_GT(statistics.m_longestCommit.count(), 0);
+
+    fs.resetStatistics();
+    ASSERT_EQ(fs.statistics().m_commits, 0U);
+    ASSERT_EQ(fs.statistics().m_cacheHits, 0U);
+}
+
+TEST(FileSystem, warmStartPrefetchesHotPages)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    auto fileName = [](int i) { return "folder/file" + std::to_string(i); };
+    auto lookupMisses = [&](FileSystem& fs) {
+        fs.resetStatistics();
+        for (int i = 0; i < 3000; i++)
+            EXPECT_TRUE(fs.find(Path(fileName(i).c_str())));
+        return fs.statistics().m_cacheMisses;
+    };
+
+    std::string snapshot;
+    {
+        auto fs = Composite::open<WrappedFile>(file);
+        for (int i = 0; i < 3000; i++)
+            createFile(Path(fileName(i).c_str()), fs);
+        fs.commit();
+        fs.trackHotPages(true);
+        lookupMisses(fs);
+        snapshot = fs.warmStartSnapshot();
+    }
+
+    size_t coldMisses = 0;
+    {
+        auto fs = Composite::open<WrappedFile>(file);
+        coldMisses = lookupMisses(fs);
+    }
+
+    auto fs = Composite::open<WrappedFile>(file);
+    ASSERT_GT(fs.warmStart(snapshot), 0U);
+    ASSERT_LT(lookupMisses(fs), coldMisses);
+
+    fs.remove("folder");
+    fs.commit();
+    ASSERT_EQ(fs.warmStart(snapshot), 0U);
+    ASSERT_THROW(fs.warmStart(snapshot.substr(0, snapshot.size() - 1)), std::runtime_error);
+}
+
+TEST(FileSystem, warmStartSnapshotForgetsPagesLoadedBeforeCommit)
+{
+    auto fs = makeFileSystem();
+    for (int i = 0; i < 3000; i++)
+        createFile(Path(("folder/file" + std::to_string(i)).c_str()), fs);
+    fs.commit();
+    fs.trackHotPages(true);
+    for (int i = 0; i < 3000; i++)
+        ASSERT_TRUE(fs.find(Path(("folder/file" + std::to_string(i)).c_str())));
+
+    fs.commit(); // may free the pages loaded so far
+    ASSERT_EQ(fs.warmStart(fs.warmStartSnapshot()), 0U);
+}
+
 TEST(FileSystem, doubleCloseWriteHandleThrows)
 {
     auto fs = makeFileSystem();
@@ -175,6 +595,89 @@ TEST(FileSystem, commitClosesAllFileHandles)
     ASSERT_THROW(fs.close(writeHandle), std::exception);
 }
 
+TEST(FileSystem, commitAsyncIsFinishedByTheNextCall)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    {
+        auto fs = Composite::open<WrappedFile>(file);
+        for (int round = 0; round < 10; round++)
+        {
+            for (int i = 0; i < 100; i++)
+                createFile(Path(("folder" + std::to_string(round) + "/file" + std::to_string(i)).c_str()), fs);
+            fs.commitAsync();
+        }
+        auto moved = std::move(fs);
+        moved.rollback();
+        ASSERT_TRUE(moved.find("folder9/file99"));
+        createFile("lastRound", moved);
+        moved.commitAsync();
+    }
+
+    auto fs = Composite::open<WrappedFile>(file);
+    ASSERT_TRUE(fs.find("folder0/file0"));
+    ASSERT_TRUE(fs.find("folder9/file99"));
+    ASSERT_TRUE(fs.find("lastRound"));
+}
+
+// Holds flushes on other threads, i.e. the commits of commitAsync(), back until they are released
+struct SlowFlushFile : WrappedFile
+{
+    std::thread::id m_owner = std::this_thread::get_id();
+    std::shared_future<void> m_released;
+    std::atomic<bool>* m_timedOut;
+
+    SlowFlushFile(std::shared_ptr<FileInterface> file, std::shared_future<void> released, std::atomic<bool>* timedOut)
+        : WrappedFile(file)
+        , m_released(released)
+        , m_timedOut(timedOut)
+    {}
+
+    void flushFile() override
+    {
+        if (std::this_thread::get_id() != m_owner &&
+            m_released.wait_for(std::chrono::seconds(10)) == std::future_status::timeout)
+            *m_timedOut = true;
+        WrappedFile::flushFile();
+    }
+};
+
+TEST(FileSystem, nextTransactionGoesOnWhileCommitAsyncWrites)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    {
+        auto fs = Composite::open<WrappedFile>(file);
+        for (int i = 0; i < 200; i++)
+            createFile(Path(("before/file" + std::to_string(i)).c_str()), fs);
+        fs.commit();
+    }
+
+    std::promise<void> release;
+    std::atomic<bool> timedOut = false;
+    {
+        auto fs = Composite::open<SlowFlushFile>(CacheBudget::fixed(32 * PageSize), file, release.get_future().share(),
+                                                 &timedOut);
+        fs.remove("before/file0");
+        for (int i = 0; i < 100; i++)
+            createFile(Path(("frozen/file" + std::to_string(i)).c_str()), fs);
+        fs.commitAsync();
+
+        for (int i = 0; i < 20; i++)
+            createFile(Path(("next/file" + std::to_string(i)).c_str()), fs);
+        ASSERT_FALSE(fs.find("before/file0"));
+        ASSERT_TRUE(fs.find("before/file199"));
+        ASSERT_TRUE(fs.find("frozen/file99"));
+        ASSERT_FALSE(timedOut);
+        release.set_value();
+        fs.commit();
+    }
+
+    auto fs = Composite::open<WrappedFile>(file);
+    ASSERT_FALSE(fs.find("before/file0"));
+    ASSERT_TRUE(fs.find("before/file199"));
+    ASSERT_TRUE(fs.find("frozen/file99"));
+    ASSERT_TRUE(fs.find("next/file19"));
+}
+
 TEST(FileSystem, rollbackClosesAllFileHandles)
 {
     auto fs = makeFileSystem();
@@ -256,6 +759,23 @@ TEST(FileSystem, CannotRenameRootFolder)
     ASSERT_FALSE(fs.rename("", "newRoot"));
 }
 
+TEST(FileSystem, statFindsPathsInInputOrder)
+{
+    auto fs = prepareFileSystemWithFiles();
+
+    std::vector<Path> paths { "folder/subFolder/file4.file", "folder/file.file", "folder/missing.file",
+                              "nofolder/file.file", "folder/subFolder", "folder/subFolder/file3.file" };
+    auto cursors = fs.stat(paths);
+
+    ASSERT_EQ(cursors.size(), paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        ASSERT_EQ(cursors[i], fs.find(paths[i]));
+    ASSERT_EQ(cursors[0].key().m_relativePath, "file4.file");
+    ASSERT_FALSE(cursors[2]);
+    ASSERT_FALSE(cursors[3]);
+    ASSERT_EQ(cursors[4].value().getType(), TreeValue::Type::Folder);
+}
+
 class FileSystemTester : public ::testing::Test
 {
 public:
@@ -330,6 +850,46 @@ TEST_F(FileSystemTester, commitedDeletedSpaceGetsReused)
     ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), compositSize);
 }
 
+TEST_F(FileSystemTester, longAttributesSurviveCommitAndRemoveFreesTheirSpace)
+{
+    std::string longString(3 * PageSize, 'x');
+    ASSERT_TRUE(m_fileSystem.addAttribute("test/long", longString));
+    m_fileSystem.commit();
+    ASSERT_EQ(m_fileSystem.getAttribute("test/long")->get<std::string>(), longString);
+
+    ASSERT_EQ(m_fileSystem.remove("test/long"), 1);
+    m_fileSystem.commit();
+    auto compositSize = m_cacheManager->getFileInterface()->fileSizeInPages();
+    ASSERT_TRUE(m_fileSystem.addAttribute("test/long2", longString));
+    ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), compositSize);
+    ASSERT_EQ(m_fileSystem.find("test/long2").value(), TreeValue(longString));
+}
+
+TEST_F(FileSystemTester, longNamesSurviveCommitAndRemoveFreesTheirSpace)
+{
+    std::string folder(PageSize, 'f');
+    std::string file(3 * PageSize, 'x');
+    std::string pathName = folder + "/" + file;
+    Path path(pathName);
+    createFile(path, m_fileSystem);
+    m_fileSystem.commit();
+
+    auto cursor = m_fileSystem.find(path);
+    ASSERT_EQ(cursor.key().m_relativePath, file);
+    ASSERT_EQ(m_fileSystem.stat({ path })[0], cursor);
+    auto handle = m_fileSystem.readFile(path);
+    ASSERT_TRUE(handle);
+    m_fileSystem.close(*handle);
+    std::string otherName = folder + "/" + file.substr(1);
+    ASSERT_FALSE(m_fileSystem.readFile(Path(otherName)));
+
+    ASSERT_EQ(m_fileSystem.remove(Path(folder)), 2);
+    m_fileSystem.commit();
+    auto compositSize = m_cacheManager->getFileInterface()->fileSizeInPages();
+    createFile(path, m_fileSystem);
+    ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), compositSize);
+}
+
 TEST_F(FileSystemTester, treeSpaceGetsReused)
 {
     m_fileSystem.rollback();
@@ -6,6 +6,8 @@
 #include "CompoundFs/DirectoryStructure.h"
 #include "CompoundFs/Path.h"
 #include "CompoundFs/FileSystemHelper.h"
+#include "CompoundFs/PosixFile.h"
+#include "CompoundFs/TempFile.h"
 #include <string>
 
 using namespace std::string_literals;
@@ -93,3 +95,137 @@ TEST(FileSystemHelper, manyItemsFolderToFolder2)
 
     ASSERT_EQ(copy(fs, "folder", "folder2"), 101);
 }
+
+TEST(FileSystemHelper, copyBetweenFileSystemsKeepsStoredPages)
+{
+    std::string data;
+    for (int i = 0; data.size() < 2 * CompressedChunkSize; i++)
+        data += "record " + std::to_string(i) + "\n";
+
+    auto copyFiles = [&](std::unique_ptr<FileInterface> sourceFile, std::unique_ptr<FileInterface> destFile) {
+        auto sourceFs = FileSystem(FileSystem::initialize(std::make_shared<CacheManager>(std::move(sourceFile))));
+        auto destFs = FileSystem(FileSystem::initialize(std::make_shared<CacheManager>(std::move(destFile))));
+        sourceFs.enablePageChecksums(true);
+        for (auto compression: { Compression::None, Compression::Lz4 })
+        {
+            auto handle = sourceFs.createFile(compression == Compression::None ? "folder/plain" : "folder/lz4",
+                                              compression).value();
+            sourceFs.write(handle, data.data(), data.size());
+            sourceFs.close(handle);
+        }
+        createFile("folder/inline", sourceFs);
+        sourceFs.commit();
+
+        ASSERT_EQ(copy(sourceFs, "folder", destFs, "copy"), 4);
+        destFs.commit();
+        ASSERT_EQ(destFs.find("copy/lz4").value().getType(), TreeValue::Type::CompressedFile);
+        ASSERT_EQ(destFs.scrub().m_checkedFiles, 2);
+        for (auto name: { "copy/plain", "copy/lz4" })
+        {
+            std::string readBack(data.size(), ' ');
+            auto handle = destFs.readFile(name).value();
+            ASSERT_EQ(destFs.read(handle, readBack.data(), readBack.size()), data.size());
+            ASSERT_EQ(readBack, data);
+            destFs.close(handle);
+        }
+        ASSERT_EQ(destFs.fileSize("copy/inline"), 4);
+    };
+
+    copyFiles(std::make_unique<MemoryFile>(), std::make_unique<MemoryFile>());
+    copyFiles(std::make_unique<TempFile<PosixFile>>(), std::make_unique<TempFile<PosixFile>>());
+}
+
+TEST(FileSystemHelper, copyWithinAFileSystemSharesThePages)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    std::string data(64 * PageSize, ' ');
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = char(i * 13);
+    auto handle = fs.createFile("folder/a.dat").value();
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.commit();
+    auto size = cm->getFileInterface()->fileSizeInPages();
+
+    ASSERT_EQ(copy(fs, "folder", "copy"), 2);
+    ASSERT_EQ(copy(fs, "folder/a.dat", "b.dat"), 1);
+    fs.commit();
+    ASSERT_LT(cm->getFileInterface()->fileSizeInPages() - size, 16U);
+
+    std::string readBack(data.size(), ' ');
+    auto readHandle = fs.readFile("copy/a.dat").value();
+    ASSERT_EQ(fs.read(readHandle, readBack.data(), readBack.size()), data.size());
+    fs.close(readHandle);
+    ASSERT_EQ(readBack, data);
+}
+
+TEST(FileSystemHelper, diffReportsChangesBetweenCommits)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    for (auto name: { "folder/changed", "folder/removed", "folder/same", "folder/sub/file" })
+        createFile(name, fs);
+    auto handle = *fs.createFile("folder/big");
+    std::string data(3 * PageSize, 'x');
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.commit();
+
+    // a copy of the committed composite serves as the old version
+    auto file = cm->getFileInterface();
+    std::vector<uint8_t> pages(file->fileSizeInPages() * PageSize);
+    Interval all(0, PageIndex(file->fileSizeInPages()));
+    file->readPages(all, pages.data());
+    auto snapshot = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    snapshot->getFileInterface()->newInterval(all.length());
+    snapshot->getFileInterface()->writePages(all, pages.data());
+    FileSystem oldFs(FileSystem::Startup { snapshot, 1, 0 });
+    oldFs.init();
+
+    fs.remove("folder/removed");
+    fs.remove("folder/sub/file");
+    createFile("folder/added", fs);
+    createFile("folder/sub/new", fs);
+    handle = *fs.appendFile("folder/changed");
+    fs.write(handle, data.data(), 1);
+    fs.close(handle);
+    fs.commit();
+
+    std::vector<std::pair<DiffType, std::string>> differences;
+    auto numDifferences = diff(oldFs, fs, "folder", [&](const DiffEntry& entry) {
+        differences.emplace_back(entry.m_type, entry.m_path);
+    });
+    ASSERT_EQ(numDifferences, 5);
+    std::vector<std::pair<DiffType, std::string>> expected { { DiffType::Added, "added" },
+                                                             { DiffType::Changed, "changed" },
+                                                             { DiffType::Removed, "removed" },
+                                                             { DiffType::Removed, "sub/file" },
+                                                             { DiffType::Added, "sub/new" } };
+    ASSERT_EQ(differences, expected);
+    ASSERT_EQ(diff(fs, fs, "", [](const DiffEntry&) {}), 0);
+}
+
+TEST(FileSystemHelper, diffMatchesLongNamesSharingTheirSortedPart)
+{
+    // long names that only differ after the sorted part, each composite keeps them in the order they were added in
+    std::string prefix = "folder/" + std::string(DirectoryKey::maxSize(), 'p');
+    std::string a = prefix + "a";
+    std::string b = prefix + "b";
+    std::string c = prefix + "c";
+    auto oldFs = FileSystem(FileSystem::initialize(std::make_shared<CacheManager>(std::make_unique<MemoryFile>())));
+    oldFs.addAttribute(Path(a), "a");
+    oldFs.addAttribute(Path(b), "b");
+    oldFs.addAttribute(Path(c), "c");
+    auto newFs = FileSystem(FileSystem::initialize(std::make_shared<CacheManager>(std::make_unique<MemoryFile>())));
+    newFs.addAttribute(Path(c), "c");
+    newFs.addAttribute(Path(b), "changed");
+    newFs.addAttribute(Path(a), "a");
+
+    std::vector<std::pair<DiffType, std::string>> differences;
+    auto numDifferences = diff(oldFs, newFs, "folder", [&](const DiffEntry& entry) {
+        differences.emplace_back(entry.m_type, entry.m_path);
+    });
+    ASSERT_EQ(numDifferences, 1);
+    ASSERT_EQ(differences.front(), std::make_pair(DiffType::Changed, b.substr(std::string("folder/").size())));
+}
@@ -341,6 +341,33 @@ TEST(FsCompareVisitor, ComplexFsIsNotEqual)
     ASSERT_EQ(fscv2.result(), FsCompareVisitor::Result::NotEqual);
 }
 
+TEST(FsCompareVisitor, manyFilesAreComparedInBatches)
+{
+    auto fs = makeFileSystem();
+    for (int i = 0; i < 1500; i++)
+    {
+        auto name = "folder/" + std::to_string(i) + ".file";
+        createFile(name.c_str(), fs, std::string(size_t(i % 7) * 3000, char('a' + i % 26)));
+    }
+
+    auto fs2 = makeFileSystem();
+    ASSERT_EQ(copy(fs, "folder", fs2, "folder"), 1501);
+
+    FsCompareVisitor fscv(fs, fs2, "folder");
+    FileSystemVisitor fsvisitor(fs);
+    fsvisitor.visit("folder", fscv);
+    ASSERT_EQ(fscv.result(), FsCompareVisitor::Result::Equal);
+
+    auto data = std::string(6 * 3000, 'a');
+    data.back() = 'b';
+    fs2.remove("folder/1300.file");
+    createFile("folder/1300.file", fs2, data);
+
+    FsCompareVisitor fscv2(fs, fs2, "folder");
+    fsvisitor.visit("folder", fscv2);
+    ASSERT_EQ(fscv2.result(), FsCompareVisitor::Result::NotEqual);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 TEST(TempFileBuffer, EmptyFileBufferReturnsEmptyOptional)
@@ -12,7 +12,7 @@ using namespace TxFs;
 TEST(FileTable, Empty)
 {
     FileTable ft;
-    ASSERT_EQ(sizeof(ft) , 4096);
+    ASSERT_EQ(sizeof(ft) , PageSize);
 
     IntervalSequence is;
     ft.insertInto(is);
@@ -38,7 +38,7 @@ TEST(FileTable, transferBackAndForth)
 TEST(FileTable, transferNotEnoughSpace)
 {
     IntervalSequence is;
-    for (uint32_t i = 0; i < 1500; i++)
+    for (uint32_t i = 0; i < 1500 * PageSize / 4096; i++)
         is.pushBack(Interval(i * 2, i * 2 + 1));
 
     IntervalSequence is2 = is;
@@ -57,7 +57,7 @@ TEST(FileTable, transferNotEnoughSpace)
 TEST(FileTable, transferNotEnoughSpace2)
 {
     IntervalSequence is;
-    for (uint32_t i = 0; i < 500; i++)
+    for (uint32_t i = 0; i < 500 * PageSize / 4096; i++)
         is.pushBack(Interval(i * 3, i * 3 + 2));
 
     IntervalSequence is2 = is;
@@ -16,6 +16,9 @@ using namespace TxFs;
 namespace 
 {
 
+/// pages of a fragmented file that needs three FileTable pages
+constexpr size_t ThreeFileTables = 2 * ((PageSize - 12) / sizeof(PageIndex)) + 158;
+
 FileDescriptor createFile(std::shared_ptr<CacheManager> cm)
 {
     FileWriter rfw(cm);
@@ -26,7 +29,7 @@ FileDescriptor createFile(std::shared_ptr<CacheManager> cm)
 
 std::vector<FileDescriptor> createFiles(std::shared_ptr<CacheManager> cm, size_t files, size_t pages)
 {
-    std::vector<uint8_t> data(4096, 'Y');
+    std::vector<uint8_t> data(PageSize, 'Y');
     std::vector<FileWriter> writers(files, cm);
     for (size_t i = 0; i < pages; i++)
         for (auto& writer: writers)
@@ -101,7 +104,7 @@ TEST(FreeStore, forEveryDeletedFileThereIsAtLeastAFreePage)
     fsfd = fs.close();
     auto is = readAllFreeStorePages(cm, fsfd.m_first);
     ASSERT_TRUE(is.totalLength() >= 50);
-    ASSERT_TRUE(fsfd.m_fileSize >= 50 * 4096);
+    ASSERT_TRUE(fsfd.m_fileSize >= 50 * PageSize);
     ASSERT_EQ(fsfd.m_first , freeStorePage.m_index);
 }
 
@@ -127,7 +130,7 @@ TEST(FreeStore, smallFilesAreConsolidatedInOnePageTable)
 
     auto is = readAllFreeStorePages(cm, fsfd.m_first);
     ASSERT_EQ(is.size() , 1);
-    ASSERT_EQ(fsfd.m_fileSize , is.totalLength() * 4096ULL);
+    ASSERT_EQ(fsfd.m_fileSize , is.totalLength() * PageSize);
 }
 
 TEST(FreeStore, deleteBigAndSmallFiles)
@@ -140,7 +143,7 @@ TEST(FreeStore, deleteBigAndSmallFiles)
     FreeStore fs(cm, fsfd);
 
     std::vector<FileDescriptor> fileDescriptors = createFiles(cm, 500, 5);
-    for (auto& large: createFiles(cm, 3, 2200))
+    for (auto& large: createFiles(cm, 3, ThreeFileTables))
         fileDescriptors.push_back(large);
 
     std::shuffle(fileDescriptors.begin(), fileDescriptors.end(), std::mt19937(std::random_device()()));
@@ -150,7 +153,7 @@ TEST(FreeStore, deleteBigAndSmallFiles)
 
     fsfd = fs.close();
     auto is = readAllFreeStorePages(cm, fsfd.m_first);
-    ASSERT_EQ(fsfd.m_fileSize, is.totalLength() * 4096ULL);
+    ASSERT_EQ(fsfd.m_fileSize, is.totalLength() * PageSize);
 }
 
 TEST(FreeStore, deleteManyMetaDataPages)
@@ -163,7 +166,7 @@ TEST(FreeStore, deleteManyMetaDataPages)
     FreeStore fs(cm, fsfd);
 
     // create 2 files with non-mergable intervals
-    std::vector<FileDescriptor> fileDescriptors = createFiles(cm, 2, 2200);
+    std::vector<FileDescriptor> fileDescriptors = createFiles(cm, 2, ThreeFileTables);
 
     // feed one file to the FreeStore - not including the FileTable MetaData pages
     std::set<PageIndex> pages;
@@ -207,7 +210,7 @@ TEST(FreeStore, DivertedPagesDoNotGetUsedAsFileTables)
     struct TestPage
     {
         uint32_t m_value;
-        char m_filler[4096 - 8];
+        char m_filler[PageSize - 8];
         uint32_t m_checkSum;
     };
     std::vector<FileDescriptor> fileDescriptors;
@@ -360,7 +363,7 @@ TEST(FreeStore, deleteBigAndSmallFilesAndAllocateUntilEmpty)
         FreeStore fs(cm, fsfd);
 
         std::vector<FileDescriptor> fileDescriptors = createFiles(cm, 1500, 1);
-        for (auto& large: createFiles(cm, 3, 2200))
+        for (auto& large: createFiles(cm, 3, ThreeFileTables))
             fileDescriptors.push_back(large);
 
         std::shuffle(fileDescriptors.begin(), fileDescriptors.end(), std::mt19937(std::random_device()()));
@@ -3,8 +3,13 @@
 #include <gtest/gtest.h>
 #include "CompoundFs/LockProtocol.h"
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace TxFs;
 
@@ -97,3 +102,118 @@ TEST(LockProtocol, commitAccessIsBlockedByReadAccess)
 //    //rlock = slp.readAccess();
 //    t.join();
 //}
+
+TEST(LockProtocol, lockStatisticsRecordContendedWaits)
+{
+    SimpleLockProtocoll slp;
+    LockStatistics statistics;
+    setLockTracer(&statistics);
+
+    auto rlock = slp.readAccess();
+    auto wlock = slp.writeAccess();
+    std::thread writer([&] { auto lock = slp.writeAccess(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    wlock.release();
+    writer.join();
+    setLockTracer(nullptr);
+
+    auto writers = statistics.counters(LockKind::Writer, LockMode::Exclusive);
+    ASSERT_EQ(writers.m_acquisitions, 2U);
+    ASSERT_EQ(writers.m_contended, 1U);
+    ASSERT_GT(writers.m_longestWait.count(), 0);
+    ASSERT_EQ(writers.m_histogram[LockStatistics::HistogramBuckets - 1], 0U);
+
+    auto readers = statistics.counters(LockKind::Shared, LockMode::Shared);
+    ASSERT_EQ(readers.m_acquisitions, 1U);
+    ASSERT_EQ(readers.m_contended, 0U);
+    ASSERT_EQ(statistics.counters(LockKind::Gate, LockMode::Shared).m_acquisitions, 1U);
+}
+
+TEST(LockProtocol, chromeTraceWriterWritesContendedWaits)
+{
+    std::ostringstream out;
+    {
+        SimpleLockProtocoll slp;
+        ChromeTraceWriter trace(out);
+        setLockTracer(&trace);
+        auto rlock = slp.readAccess();
+        std::thread committer([&] { auto commitLock = slp.commitAccess(slp.writeAccess()); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        rlock.release();
+        committer.join();
+        setLockTracer(nullptr);
+    }
+
+    auto trace = out.str();
+    ASSERT_EQ(trace.front(), '[');
+    ASSERT_NE(trace.find("\"name\":\"shared exclusive\""), std::string::npos);
+    ASSERT_EQ(trace.find("\"name\":\"gate"), std::string::npos);
+    ASSERT_NE(trace.find("\"holderMode\":\"shared\""), std::string::npos);
+    ASSERT_EQ(trace.find("]\n"), trace.size() - 2);
+}
+
+TEST(LockProtocol, removingTheTracerWaitsForItsCalls)
+{
+    struct SlowTracer : LockTracer
+    {
+        std::atomic<bool> m_called = false;
+        std::atomic<bool> m_returned = false;
+
+        void lockAcquired(const LockWait&) override
+        {
+            m_called = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            m_returned = true;
+        }
+    };
+
+    auto tracer = std::make_unique<SlowTracer>();
+    SimpleLockProtocoll slp;
+    setLockTracer(tracer.get());
+    std::thread writer([&] { auto lock = slp.writeAccess(); });
+    while (!tracer->m_called)
+        std::this_thread::yield();
+    setLockTracer(nullptr);
+    ASSERT_TRUE(tracer->m_returned);
+    tracer.reset(); // no call may be left that uses it
+    writer.join();
+}
+
+TEST(LockProtocol, contendedWaitsNameTheHolder)
+{
+    struct WaitRecorder : LockTracer
+    {
+        std::mutex m_mutex;
+        std::vector<LockWait> m_waits;
+
+        void lockAcquired(const LockWait& wait) override
+        {
+            std::lock_guard lock(m_mutex);
+            if (wait.m_contended)
+                m_waits.push_back(wait);
+        }
+    } recorder;
+
+    SimpleLockProtocoll slp;
+    setLockTracer(&recorder);
+    auto rlock = slp.readAccess();
+    auto wlock = slp.writeAccess();
+    std::thread committer([&] { auto commitLock = slp.commitAccess(slp.writeAccess()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    wlock.release(); // the committer waits for the writer lock ...
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    rlock.release(); // ... and then for the reader to finish
+    committer.join();
+    setLockTracer(nullptr);
+
+    ASSERT_EQ(recorder.m_waits.size(), 2U);
+    const auto& writerWait = recorder.m_waits[0];
+    ASSERT_EQ(writerWait.m_kind, LockKind::Writer);
+    ASSERT_EQ(writerWait.m_holder->m_thread, std::this_thread::get_id());
+    ASSERT_EQ(writerWait.m_holder->m_mode, LockMode::Exclusive);
+
+    const auto& sharedWait = recorder.m_waits[1];
+    ASSERT_EQ(sharedWait.m_kind, LockKind::Shared);
+    ASSERT_EQ(sharedWait.m_holder->m_thread, std::this_thread::get_id());
+    ASSERT_EQ(sharedWait.m_holder->m_mode, LockMode::Shared);
+}
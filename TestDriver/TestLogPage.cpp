@@ -8,7 +8,7 @@ using namespace TxFs;
 TEST(LogPage, size)
 {
     LogPage log(0);
-    ASSERT_EQ(sizeof(log) , 4096);
+    ASSERT_EQ(sizeof(log) , PageSize);
 }
 
 TEST(LogPage, checkSignature)
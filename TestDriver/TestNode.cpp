@@ -13,8 +13,8 @@ TEST(Node, hasPageSize)
     Leaf l;
     InnerNode n;
 
-    ASSERT_EQ(sizeof(l) , 4096);
-    ASSERT_EQ(sizeof(n) , 4096);
+    ASSERT_EQ(sizeof(l) , PageSize);
+    ASSERT_EQ(sizeof(n) , PageSize);
 }
 
 TEST(Leaf, insert)
@@ -8,6 +8,7 @@
 #include <random>
 #include <gtest/gtest.h>
 #include "CompoundFs/PageAllocator.h"
+#include "CompoundFs/Node.h"
 
 using namespace TxFs;
 
@@ -105,6 +106,29 @@ TEST(PageAllocator, allocAfterTrim)
     ASSERT_EQ(stat.first , 1 && stat.second == 0);
 }
 
+TEST(PageAllocator, hugePageBlocksAreTrimmedAsAWhole)
+{
+    for (auto hugePages: { HugePages::Transparent, HugePages::Explicit })
+    {
+        PageAllocator alloc(16, hugePages);
+        constexpr size_t pagesPerBlock = PageAllocator::HugePageSize / PageSize;
+        {
+            std::vector<std::shared_ptr<uint8_t>> pages;
+            for (size_t i = 0; i < 3 * pagesPerBlock; i++)
+            {
+                pages.push_back(alloc.allocate());
+                *pages.back() = uint8_t(i);
+            }
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(pages.front().get()) % PageAllocator::HugePageSize, 0U);
+            ASSERT_EQ(*pages[pagesPerBlock + 1], uint8_t(pagesPerBlock + 1));
+        }
+
+        auto stat = alloc.trim();
+        ASSERT_EQ(stat.first, 1U);
+        ASSERT_EQ(stat.second, 0U);
+    }
+}
+
 TEST(PageAllocator, defaultCtorTrimIsNoOp)
 {
     PageAllocator alloc;
@@ -39,7 +39,9 @@ struct TreeValueTester : ::testing::Test
             Version { 1, 1, std::numeric_limits<uint32_t>::max() }, 
             std::numeric_limits<double>::max(),
             std::numeric_limits<uint64_t>::max(),
-            std::string("test"));
+            std::string("test"),
+            InlineFile { "inline" },
+            CompressedFile { FileDescriptor(3, 4, 5), std::numeric_limits<uint64_t>::max() });
         return std::get<T>(values);
     }
 
@@ -52,7 +54,8 @@ struct TreeValueTester : ::testing::Test
 
 };
 
-using TreeValueTypes = ::testing::Types<FileDescriptor, Folder, Version, double, uint64_t, std::string>;
+using TreeValueTypes = ::testing::Types<FileDescriptor, Folder, Version, double, uint64_t, std::string, InlineFile,
+                                        CompressedFile>;
 TYPED_TEST_SUITE(TreeValueTester, TreeValueTypes);
 
 TYPED_TEST(TreeValueTester, streamInOfStreamOutIsEqual)
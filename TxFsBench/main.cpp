@@ -0,0 +1,399 @@
+
+// TxFsBench runs repeatable CompoundFs scenarios on a MemoryFile and on a PosixFile and writes the results as JSON.
+// Usage: TxFsBench [--quick] [results.json]
+
+#include "CompoundFs/Composite.h"
+#include "CompoundFs/MemoryFile.h"
+#include "CompoundFs/PosixFile.h"
+#include "CompoundFs/RollbackHandler.h"
+#include "CompoundFs/TempFile.h"
+#include "CompoundFs/WrappedFile.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace TxFs;
+
+namespace
+{
+
+struct Config
+{
+    size_t m_smallFiles = 20000;
+    size_t m_filesPerCommit = 100;
+    size_t m_largeFileSize = 256 << 20;
+    size_t m_lookups = 200000;
+    size_t m_churnRounds = 20;
+    size_t m_churnFiles = 1000;
+    size_t m_readers = 4;
+    std::chrono::milliseconds m_concurrentDuration { 2000 };
+
+    static Config quick()
+    {
+        Config config;
+        config.m_smallFiles = 2000;
+        config.m_largeFileSize = 16 << 20;
+        config.m_lookups = 20000;
+        config.m_churnRounds = 4;
+        config.m_churnFiles = 200;
+        config.m_concurrentDuration = std::chrono::milliseconds(200);
+        return config;
+    }
+};
+
+struct Result
+{
+    std::string m_scenario;
+    std::string m_file;
+    uint64_t m_operations = 0;
+    uint64_t m_bytes = 0;
+    double m_seconds = 0;
+    size_t m_filePages = 0;
+};
+
+class Stopwatch
+{
+    std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+public:
+    double seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+};
+
+std::string smallFileName(size_t i)
+{
+    return "small/" + std::to_string(i % 100) + "/" + std::to_string(i) + ".dat";
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// The scenarios. Each works on its own composite and returns its measurements.
+
+class Scenarios
+{
+    const Config& m_config;
+    std::string m_fileName;
+    std::vector<Result> m_results;
+    std::shared_ptr<CacheManager> m_cacheManager;
+
+public:
+    Scenarios(const Config& config, std::string fileName)
+        : m_config(config)
+        , m_fileName(std::move(fileName))
+    {
+    }
+
+    void runAll(std::unique_ptr<FileInterface> file)
+    {
+        m_cacheManager = std::make_shared<CacheManager>(std::move(file));
+        FileSystem fs(FileSystem::initialize(m_cacheManager));
+        fs.commit();
+        createSmallFiles(fs);
+        lookupRandomPaths(fs);
+        listDirectories(fs);
+        writeAndReadLargeFile(fs);
+        churnFiles(fs);
+    }
+
+    const std::vector<Result>& results() const { return m_results; }
+
+private:
+    Result& newResult(const char* scenario)
+    {
+        m_results.push_back(Result { scenario, m_fileName });
+        m_results.back().m_filePages = m_cacheManager->getFileInterface()->fileSizeInPages();
+        return m_results.back();
+    }
+
+    void createSmallFiles(FileSystem& fs)
+    {
+        std::string data(100, 'x');
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < m_config.m_smallFiles; i++)
+        {
+            auto handle = fs.createFile(Path(smallFileName(i))).value();
+            fs.write(handle, data.data(), data.size());
+            fs.close(handle);
+            if ((i + 1) % m_config.m_filesPerCommit == 0)
+                fs.commit();
+        }
+        fs.commit();
+
+        auto& result = newResult("smallFileCreateAndCommit");
+        result.m_seconds = stopwatch.seconds();
+        result.m_operations = m_config.m_smallFiles;
+        result.m_bytes = m_config.m_smallFiles * data.size();
+    }
+
+    void lookupRandomPaths(FileSystem& fs)
+    {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<size_t> fileIndex(0, m_config.m_smallFiles - 1);
+        size_t found = 0;
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < m_config.m_lookups; i++)
+            found += bool(fs.find(Path(smallFileName(fileIndex(random)))));
+
+        auto& result = newResult("randomPathLookup");
+        result.m_seconds = stopwatch.seconds();
+        result.m_operations = found;
+    }
+
+    void listDirectories(FileSystem& fs)
+    {
+        size_t entries = 0;
+        Stopwatch stopwatch;
+        for (size_t folder = 0; folder < 100; folder++)
+        {
+            auto dir = "small/" + std::to_string(folder);
+            auto subFolder = fs.subFolder(Path(dir)).value();
+            for (auto cursor = fs.begin(Path(subFolder, "")); cursor; cursor = fs.next(cursor))
+                entries++;
+        }
+
+        auto& result = newResult("directoryListing");
+        result.m_seconds = stopwatch.seconds();
+        result.m_operations = entries;
+    }
+
+    void writeAndReadLargeFile(FileSystem& fs)
+    {
+        std::vector<uint8_t> block(1 << 20);
+        for (size_t i = 0; i < block.size(); i++)
+            block[i] = uint8_t(i * 13);
+
+        Stopwatch writeStopwatch;
+        auto handle = fs.createFile("large.dat").value();
+        for (size_t written = 0; written < m_config.m_largeFileSize; written += block.size())
+            fs.write(handle, block.data(), block.size());
+        fs.close(handle);
+        fs.commit();
+        auto& writeResult = newResult("largeSequentialWrite");
+        writeResult.m_seconds = writeStopwatch.seconds();
+        writeResult.m_operations = 1;
+        writeResult.m_bytes = m_config.m_largeFileSize;
+
+        Stopwatch readStopwatch;
+        auto readHandle = fs.readFile("large.dat").value();
+        uint64_t read = 0;
+        while (auto size = fs.read(readHandle, block.data(), block.size()))
+            read += size;
+        fs.close(readHandle);
+        auto& readResult = newResult("largeSequentialRead");
+        readResult.m_seconds = readStopwatch.seconds();
+        readResult.m_operations = 1;
+        readResult.m_bytes = read;
+    }
+
+    // creates and deletes files in rounds: the file must stop growing once the FreeStore holds enough pages
+    void churnFiles(FileSystem& fs)
+    {
+        std::string data(10000, 'y');
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < m_config.m_churnRounds; round++)
+        {
+            for (size_t i = 0; i < m_config.m_churnFiles; i++)
+            {
+                auto handle = fs.createFile(Path("churn/" + std::to_string(i))).value();
+                fs.write(handle, data.data(), data.size());
+                fs.close(handle);
+            }
+            fs.commit();
+            fs.remove("churn");
+            fs.commit();
+        }
+
+        auto& result = newResult("deleteChurn");
+        result.m_seconds = stopwatch.seconds();
+        result.m_operations = m_config.m_churnRounds * m_config.m_churnFiles;
+        result.m_bytes = result.m_operations * data.size();
+    }
+};
+
+/// One writer appends and commits while readers open the composite read-only and read the file, as separate
+/// processes would. Needs a real file as every FileSystem locks the file for itself.
+std::vector<Result> readWhileWriting(const Config& config)
+{
+    auto path = Private::createTempFileName();
+    std::string data(4096, 'z');
+    {
+        auto fs = Composite::open<PosixFile>(path, OpenMode::CreateAlways);
+        auto handle = fs.createFile("shared.dat").value();
+        fs.write(handle, data.data(), data.size());
+        fs.close(handle);
+        fs.commit();
+    }
+
+    std::atomic<bool> stop = false;
+    std::atomic<uint64_t> reads = 0;
+    std::atomic<uint64_t> bytesRead = 0;
+    auto reader = [&] {
+        std::vector<char> buffer(1 << 20);
+        while (!stop)
+        {
+            auto fs = Composite::openReadOnly<PosixFile>(path, OpenMode::ReadOnly);
+            auto handle = fs.readFile("shared.dat").value();
+            uint64_t size = 0;
+            while (auto read = fs.read(handle, buffer.data(), buffer.size()))
+                size += read;
+            bytesRead += size;
+            reads++;
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < config.m_readers; i++)
+        readers.emplace_back(reader);
+
+    uint64_t commits = 0;
+    Stopwatch stopwatch;
+    {
+        auto fs = Composite::open<PosixFile>(path, OpenMode::Open);
+        while (stopwatch.seconds() * 1000 < config.m_concurrentDuration.count())
+        {
+            auto handle = fs.appendFile("shared.dat").value();
+            fs.write(handle, data.data(), data.size());
+            fs.close(handle);
+            fs.commit();
+            commits++;
+        }
+    }
+    auto seconds = stopwatch.seconds();
+    stop = true;
+    for (auto& r: readers)
+        r.join();
+
+    std::error_code errorCode;
+    auto filePages = size_t(std::filesystem::file_size(path, errorCode) / PageSize);
+    std::filesystem::remove(path, errorCode);
+    return { Result { "concurrentWriterCommits", "PosixFile", commits, commits * data.size(), seconds, filePages },
+             Result { "concurrentReaderReads", "PosixFile", reads, bytesRead, seconds, filePages } };
+}
+
+/// Fails a commit right before the file is cut back: the original pages are already overwritten and the log is
+/// complete, so reopening has to restore every logged page.
+struct CrashBeforeTruncateFile : WrappedFile
+{
+    struct Exception : std::runtime_error
+    {
+        Exception()
+            : std::runtime_error("CrashBeforeTruncateFile: commit interrupted")
+        {}
+    };
+
+    CrashBeforeTruncateFile(std::shared_ptr<FileInterface> file)
+        : WrappedFile(std::move(file))
+    {}
+
+    void truncate(size_t numberOfPages) override
+    {
+        if (fileSizeInPages() != numberOfPages)
+            throw Exception();
+        WrappedFile::truncate(numberOfPages);
+    }
+};
+
+/// Removes the small files in one commit that crashes on a MemoryFile and measures how long reopening the composite
+/// takes. Operations are the restored pages.
+Result crashRecovery(const Config& config)
+{
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    {
+        auto fs = Composite::open<WrappedFile>(file);
+        std::string data(100, 'x');
+        for (size_t i = 0; i < config.m_smallFiles; i++)
+        {
+            auto handle = fs.createFile(Path(smallFileName(i))).value();
+            fs.write(handle, data.data(), data.size());
+            fs.close(handle);
+        }
+        fs.commit();
+    }
+    {
+        auto fs = Composite::open<CrashBeforeTruncateFile>(file);
+        for (size_t folder = 0; folder < 100; folder++)
+            fs.remove(Path(("small/" + std::to_string(folder)).c_str()));
+        try
+        {
+            fs.commit();
+        }
+        catch (const CrashBeforeTruncateFile::Exception&)
+        {
+        }
+    }
+
+    auto filePages = file->fileSizeInPages();
+    uint64_t restoredPages = CacheManager(std::make_unique<WrappedFile>(file)).getRollbackHandler().readLogs().size();
+    Stopwatch stopwatch;
+    auto fs = Composite::open<WrappedFile>(file);
+    return Result { "crashRecovery", "MemoryFile", restoredPages, restoredPages * PageSize, stopwatch.seconds(), filePages };
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results)
+{
+    out << "{\n  \"pageSize\": " << PageSize << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& r = results[i];
+        out << "    { \"scenario\": \"" << r.m_scenario << "\", \"file\": \"" << r.m_file
+            << "\", \"operations\": " << r.m_operations << ", \"bytes\": " << r.m_bytes
+            << ", \"seconds\": " << r.m_seconds
+            << ", \"operationsPerSecond\": " << (r.m_seconds > 0 ? double(r.m_operations) / r.m_seconds : 0)
+            << ", \"bytesPerSecond\": " << (r.m_seconds > 0 ? double(r.m_bytes) / r.m_seconds : 0)
+            << ", \"filePages\": " << r.m_filePages << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    Config config;
+    const char* outputPath = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+            config = Config::quick();
+        else
+            outputPath = argv[i];
+    }
+
+    try
+    {
+        std::vector<Result> results;
+        Scenarios memoryFile(config, "MemoryFile");
+        memoryFile.runAll(std::make_unique<MemoryFile>());
+        results = memoryFile.results();
+
+        Scenarios posixFile(config, "PosixFile");
+        posixFile.runAll(std::make_unique<TempFile<PosixFile>>());
+        results.insert(results.end(), posixFile.results().begin(), posixFile.results().end());
+
+        auto concurrent = readWhileWriting(config);
+        results.insert(results.end(), concurrent.begin(), concurrent.end());
+        results.push_back(crashRecovery(config));
+
+        if (!outputPath)
+            writeJson(std::cout, results);
+        else
+        {
+            std::ofstream out(outputPath);
+            writeJson(out, results);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "TxFsBench: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
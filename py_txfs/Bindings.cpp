@@ -33,6 +33,12 @@ std::string valueToString(const TreeValue& tv)
     case TreeValue::Type::File:
         ss << tv.get<FileDescriptor>().m_fileSize;
         break;
+    case TreeValue::Type::InlineFile:
+        ss << tv.get<InlineFile>().m_data.size();
+        break;
+    case TreeValue::Type::CompressedFile:
+        ss << tv.get<CompressedFile>().m_fileSize;
+        break;
     case TreeValue::Type::Int32:
         ss << tv.get<uint32_t>();
         break;
@@ -78,6 +84,8 @@ auto convertToVariant(const TreeValue& tv)
     return tv.visit(Overloaded {
         [](const auto& val) -> PyVariant { return val; }, 
         [](FileDescriptor fd) -> PyVariant { return fd.m_fileSize; },
+        [](const InlineFile& file) -> PyVariant { return uint64_t(file.m_data.size()); },
+        [](const CompressedFile& file) -> PyVariant { return file.m_fileSize; },
         [](TreeValue::Unknown u) -> PyVariant { return "Unknown"; },
         [](Version v) -> PyVariant { return py::make_tuple(v.m_major, v.m_minor, v.m_patch); } });
 }
@@ -113,7 +121,7 @@ void importFiles(std::string_view source, FileSystem& fs, std::string_view desti
             fs.createPath(Path(dest));
         else if (e.is_regular_file())
         {
-            buffer.resize(BufferPages * 4096ULL);
+            buffer.resize(BufferPages * PageSize);
             auto wh = fs.createFile(Path(dest));
             PosixFile rf(e, OpenMode::ReadOnly);
             auto fileSizeInPages = (PageIndex) rf.fileSizeInPages();
@@ -158,6 +166,8 @@ PYBIND11_MODULE(py_txfs, m)
 
     py::enum_<TreeValue::Type>(m, "TreeValueType")
         .value("FILE", TreeValue::Type::File)
+        .value("INLINE_FILE", TreeValue::Type::InlineFile)
+        .value("COMPRESSED_FILE", TreeValue::Type::CompressedFile)
         .value("FOLDER", TreeValue::Type::Folder)
         .value("DOUBLE", TreeValue::Type::Double)
         .value("STRING", TreeValue::Type::String)